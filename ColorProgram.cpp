@@ -2,12 +2,14 @@
 
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
+#include "gl_debug.hpp"
 
-Load< ColorProgram > color_program(LoadTagEarly);
-
-ColorProgram::ColorProgram() {
-	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
-	program = gl_compile_program(
+//submitted before any program is looked up, so the driver can compile all programs at once:
+static GLuint submitted_program = 0;
+static Load< void > submit_program(LoadTagShaders, [](){
+	//Compile vertex and fragment shaders using the convenient 'gl_submit_program' helper function:
+	submitted_program = gl_submit_program(
 		//vertex shader:
 		"#version 330\n"
 		"uniform mat4 OBJECT_TO_CLIP;\n"
@@ -29,6 +31,15 @@ ColorProgram::ColorProgram() {
 	);
 	//As you can see above, adjacent strings in C/C++ are concatenated.
 	// this is very useful for writing long shader programs inline.
+});
+
+Load< ColorProgram > color_program(LoadTagEarly);
+
+ColorProgram::ColorProgram() {
+	//wait for all submitted programs to compile and link (throws on errors):
+	gl_finish_programs();
+	program = submitted_program;
+	gl_label(GL_PROGRAM, program, "ColorProgram");
 
 	//look up the locations of vertex attributes:
 	Position_vec4 = glGetAttribLocation(program, "Position");
@@ -39,7 +50,7 @@ ColorProgram::ColorProgram() {
 }
 
 ColorProgram::~ColorProgram() {
-	glDeleteProgram(program);
+	gl_delete_program(program);
 	program = 0;
 }
 
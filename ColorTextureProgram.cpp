@@ -2,12 +2,14 @@
 
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
+#include "gl_debug.hpp"
 
-Load< ColorTextureProgram > color_texture_program(LoadTagEarly);
-
-ColorTextureProgram::ColorTextureProgram() {
-	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
-	program = gl_compile_program(
+//submitted before any program is looked up, so the driver can compile all programs at once:
+static GLuint submitted_program = 0;
+static Load< void > submit_program(LoadTagShaders, [](){
+	//Compile vertex and fragment shaders using the convenient 'gl_submit_program' helper function:
+	submitted_program = gl_submit_program(
 		//vertex shader:
 		"#version 330\n"
 		"uniform mat4 OBJECT_TO_CLIP;\n"
@@ -34,6 +36,15 @@ ColorTextureProgram::ColorTextureProgram() {
 	);
 	//As you can see above, adjacent strings in C/C++ are concatenated.
 	// this is very useful for writing long shader programs inline.
+});
+
+Load< ColorTextureProgram > color_texture_program(LoadTagEarly);
+
+ColorTextureProgram::ColorTextureProgram() {
+	//wait for all submitted programs to compile and link (throws on errors):
+	gl_finish_programs();
+	program = submitted_program;
+	gl_label(GL_PROGRAM, program, "ColorTextureProgram");
 
 	//look up the locations of vertex attributes:
 	Position_vec4 = glGetAttribLocation(program, "Position");
@@ -45,15 +56,15 @@ ColorTextureProgram::ColorTextureProgram() {
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
 
 	//set TEX to always refer to texture binding zero:
-	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
+	gl_use_program(program); //bind program -- glUniform* calls refer to this program now
 
 	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
 
-	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
+	gl_use_program(0); //unbind program -- glUniform* calls refer to ??? now
 }
 
 ColorTextureProgram::~ColorTextureProgram() {
-	glDeleteProgram(program);
+	gl_delete_program(program);
 	program = 0;
 }
 
@@ -0,0 +1,142 @@
+#include "Convolver.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+	typedef std::complex< float > Complex;
+
+	//radix-2 FFT tables for Convolver::FFTSize, built at startup:
+	struct FFTTables {
+		static constexpr uint32_t const Size = Convolver::FFTSize;
+		static_assert((Size & (Size - 1)) == 0, "FFT size is a power of two");
+		std::array< uint32_t, Size > bit_reverse;
+		std::array< Complex, Size / 2 > twiddle; //exp(-2 pi i k / Size)
+
+		FFTTables() {
+			uint32_t bits = 0;
+			while ((1U << bits) < Size) ++bits;
+			for (uint32_t i = 0; i < Size; ++i) {
+				uint32_t r = 0;
+				for (uint32_t b = 0; b < bits; ++b) {
+					if (i & (1U << b)) r |= 1U << (bits - 1 - b);
+				}
+				bit_reverse[i] = r;
+			}
+			constexpr double const Pi = 3.14159265358979323846;
+			for (uint32_t k = 0; k < Size / 2; ++k) {
+				double ang = -2.0 * Pi * double(k) / double(Size);
+				twiddle[k] = Complex(float(std::cos(ang)), float(std::sin(ang)));
+			}
+		}
+	};
+	FFTTables const fft_tables;
+
+	//n.b. written out (rather than using std::complex's operator*) to skip its inf/nan handling:
+	inline Complex multiply(Complex a, Complex b) {
+		return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+	}
+
+	//in-place, unscaled FFT of FFTSize values (inverse computes the conjugate transform):
+	void fft(Complex* data, bool inverse) {
+		constexpr uint32_t const Size = FFTTables::Size;
+		for (uint32_t i = 0; i < Size; ++i) {
+			uint32_t r = fft_tables.bit_reverse[i];
+			if (i < r) std::swap(data[i], data[r]);
+		}
+		for (uint32_t half = 1; half < Size; half *= 2) {
+			uint32_t stride = Size / (2 * half); //twiddle index step at this level
+			for (uint32_t k = 0; k < half; ++k) {
+				Complex w = fft_tables.twiddle[k * stride];
+				if (inverse) w = std::conj(w);
+				for (uint32_t start = k; start < Size; start += 2 * half) {
+					Complex a = data[start];
+					Complex b = multiply(data[start + half], w);
+					data[start] = Complex(a.real() + b.real(), a.imag() + b.imag());
+					data[start + half] = Complex(a.real() - b.real(), a.imag() - b.imag());
+				}
+			}
+		}
+	}
+}
+
+Convolver::Convolver(std::vector< float > const& left, std::vector< float > const& right) {
+	uint32_t length = uint32_t(std::max(left.size(), right.size()));
+	partitions = std::max(1U, (length + Partition - 1) / Partition);
+
+	//spectrum of each (zero-padded) piece of each ear's response:
+	filter.resize(size_t(partitions) * 2 * Bins);
+	for (uint32_t p = 0; p < partitions; ++p) {
+		for (uint32_t ear = 0; ear < 2; ++ear) {
+			std::vector< float > const& response = (ear == 0 ? left : right);
+			scratch.fill(Complex(0.0f, 0.0f));
+			for (uint32_t t = 0; t < Partition; ++t) {
+				size_t i = size_t(p) * Partition + t;
+				if (i < response.size()) scratch[t] = Complex(response[i], 0.0f);
+			}
+			fft(scratch.data(), false);
+			for (uint32_t k = 0; k < Bins; ++k) {
+				filter[(size_t(p) * 2 + ear) * Bins + k] = scratch[k] * (1.0f / float(FFTSize));
+			}
+		}
+	}
+
+	history.resize(size_t(partitions) * Bins);
+	reset();
+}
+
+void Convolver::reset() {
+	std::fill(history.begin(), history.end(), Complex(0.0f, 0.0f));
+	input.fill(0.0f);
+	newest = 0;
+}
+
+void Convolver::process(float const* in, StereoFrame* out, uint32_t count) {
+	assert(count % Partition == 0);
+
+	for (uint32_t at = 0; at < count; at += Partition) {
+		//slide input along by one piece and transform the last two pieces:
+		std::copy(input.begin() + Partition, input.end(), input.begin());
+		std::copy(in + at, in + at + Partition, input.begin() + Partition);
+		for (uint32_t t = 0; t < FFTSize; ++t) {
+			scratch[t] = Complex(input[t], 0.0f);
+		}
+		fft(scratch.data(), false);
+
+		//remember the spectrum (only the non-redundant half, since input is real):
+		newest = (newest + partitions - 1) % partitions;
+		std::copy(scratch.begin(), scratch.begin() + Bins, history.begin() + size_t(newest) * Bins);
+
+		//multiply-add every piece of the response with the input spectrum from that many pieces ago:
+		left_sum.fill(Complex(0.0f, 0.0f));
+		right_sum.fill(Complex(0.0f, 0.0f));
+		for (uint32_t p = 0; p < partitions; ++p) {
+			Complex const* x = &history[size_t((newest + p) % partitions) * Bins];
+			Complex const* h_left = &filter[(size_t(p) * 2 + 0) * Bins];
+			Complex const* h_right = &filter[(size_t(p) * 2 + 1) * Bins];
+			for (uint32_t k = 0; k < Bins; ++k) {
+				left_sum[k] += multiply(x[k], h_left[k]);
+				right_sum[k] += multiply(x[k], h_right[k]);
+			}
+		}
+
+		//both outputs are real, so transform back together as left + i * right:
+		// (the upper half of each spectrum is the conjugate mirror of the lower half)
+		Complex const i(0.0f, 1.0f);
+		for (uint32_t k = 0; k < Bins; ++k) {
+			scratch[k] = left_sum[k] + multiply(i, right_sum[k]);
+		}
+		for (uint32_t k = Bins; k < FFTSize; ++k) {
+			scratch[k] = std::conj(left_sum[FFTSize - k]) + multiply(i, std::conj(right_sum[FFTSize - k]));
+		}
+		fft(scratch.data(), true);
+
+		//overlap-save: only the last piece of the result is free of wrap-around:
+		StereoFrame* dst = out + at;
+		for (uint32_t t = 0; t < Partition; ++t) {
+			dst[t].l += scratch[Partition + t].real();
+			dst[t].r += scratch[Partition + t].imag();
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "mix_kernels.hpp"
+
+#include <array>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+//Convolver: convolve a mono signal with a stereo impulse response (e.g., one ear pair of an HRTF).
+// Uses uniformly partitioned FFT convolution (overlap-save): the response is split into Partition-sample
+// pieces whose spectra are precomputed, and each Partition samples of input cost one forward FFT,
+// one inverse FFT, and one spectrum multiply-add per piece -- so cost per sample depends only on the
+// response length (never on the caller's block size), and no latency is added.
+
+struct Convolver {
+	static constexpr uint32_t const Partition = 128; //samples per piece (process() works in multiples of this)
+	static constexpr uint32_t const FFTSize = 2 * Partition;
+	static constexpr uint32_t const Bins = Partition + 1; //non-redundant bins of a real signal's spectrum
+
+	//precompute spectra for left/right responses (padded to the longer one); allocates:
+	Convolver(std::vector< float > const& left, std::vector< float > const& right);
+
+	//convolve 'count' samples from 'in' and add the (stereo) result to 'out':
+	// 'count' must be a multiple of Partition. Doesn't allocate.
+	void process(float const* in, StereoFrame* out, uint32_t count);
+
+	//forget all past input:
+	void reset();
+
+	//number of Partition-sample pieces the response was split into:
+	uint32_t partitions = 0;
+
+	//internals:
+	std::vector< std::complex< float > > filter; //[piece][ear][bin] (pre-scaled by 1/FFTSize)
+	std::vector< std::complex< float > > history; //spectra of recent input, newest at 'newest': [piece][bin]
+	uint32_t newest = 0;
+	std::array< float, FFTSize > input; //[previous Partition samples | current Partition samples]
+	std::array< std::complex< float >, FFTSize > scratch;
+	std::array< std::complex< float >, Bins > left_sum;
+	std::array< std::complex< float >, Bins > right_sum;
+};
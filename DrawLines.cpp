@@ -1,23 +1,282 @@
 #include "DrawLines.hpp"
 #include "PathFont.hpp"
 #include "ColorProgram.hpp"
+#include "LineInstanceProgram.hpp"
 
 #include "gl_errors.hpp"
+#include "gl_extensions.hpp"
+#include "gl_state.hpp"
+#include "gl_debug.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-//All DrawLines instances share a vertex array object and vertex buffer, initialized at load time:
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <unordered_map>
+
+//All DrawLines instances share two streaming buffers, initialized at load time: one for line vertices
+// and one for shape instances (boxes, axes, and glyphs). Each is used as a ring: data is appended after
+// the previous upload, and a fence after each draw marks when that part of the ring may be overwritten.
+// This avoids re-allocating (orphaning) the buffers on every upload.
+//
+//If GL_ARB_buffer_storage (core in GL 4.4) is available the rings are persistently mapped once at startup;
+// otherwise each upload maps just the range it writes (unsynchronized, since the fences already guard it).
+//
+//The shapes that instances refer to (every PathFont glyph, a tofu for missing glyphs, a box, and axes)
+// are uploaded once, to a buffer texture that line_instance_program reads.
+
+//(not in GL.hpp, since it only covers GL 3.3:)
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRY *BufferStorageFn)(GLenum target, GLsizeiptr size, void const *data, GLbitfield flags);
+static BufferStorageFn buffer_storage = nullptr; //nullptr if not supported
+
+//draw not yet known to be complete, with the byte range of a ring that it reads:
+struct RingFence {
+	GLsync sync;
+	size_t begin, end;
+};
+
+struct StreamRing {
+	GLuint buffer = 0;
+	size_t size = 0; //bytes
+	size_t head = 0; //next byte to write (always a multiple of RingAlignment)
+	uint8_t *mapping = nullptr; //persistent mapping of the whole ring (if buffer_storage)
+	std::deque< RingFence > fences; //oldest first
+};
+static constexpr size_t const RingAlignment = 16;
 
 //n.b. declared static so they don't conflict with similarly named global variables elsewhere:
-static GLuint vertex_buffer = 0;
+static StreamRing vertex_ring;
+static StreamRing instance_ring;
 static GLuint vertex_buffer_for_color_program = 0;
+static GLuint instance_buffer_for_line_instance_program = 0;
+
+//shapes, as [first vertex, vertex count] in shape_vertices:
+struct ShapeVertex {
+	glm::vec3 Position;
+	glm::u8vec4 Color; //multiplies the instance's color
+};
+static_assert(sizeof(ShapeVertex) == 16, "ShapeVertex is one RGBA32UI texel");
+static std::vector< ShapeVertex > shape_vertices;
+static std::vector< glm::uvec2 > shapes; //glyphs (by index in PathFont::font), then:
+static uint32_t tofu_shape = -1U;
+static uint32_t box_shape = -1U;
+static uint32_t axes_shape = -1U;
+static GLuint shape_buffer = 0;
+static GLuint shape_texture = 0;
+
+//shapes are drawn in size classes (all instances in class c are drawn with 2^c vertices):
+static uint32_t size_class(uint32_t count) {
+	uint32_t c = 0;
+	while ((1U << c) < count) ++c;
+	return c;
+}
+
+//what has been finished since the last flush, all to be drawn with batch_world_to_clip:
+static glm::mat4 batch_world_to_clip;
+static size_t batch_vertices_begin = 0; //byte offset in vertex_ring
+static GLsizei batch_vertex_count = 0;
+static std::vector< std::vector< DrawLines::Instance > > batch_instances; //[size class]
+static uint32_t batch_instance_count = 0;
+static std::vector< DrawLines::Instance > instance_scratch; //(batch_instances, concatenated, for upload)
+
+static DrawLines::Stats stats; //being accumulated for the current frame
+static DrawLines::Stats last_stats; //from the previous frame
+
+//(re-)create a ring's buffer with room for 'size' bytes:
+static void ring_allocate(StreamRing &ring, size_t size) {
+	//the old buffer (if any) stays alive in the driver until draws from it finish, so fences can just be dropped:
+	for (auto const &fence : ring.fences) {
+		glDeleteSync(fence.sync);
+	}
+	ring.fences.clear();
+	if (ring.buffer != 0) {
+		glDeleteBuffers(1, &ring.buffer);
+		ring.buffer = 0;
+		ring.mapping = nullptr;
+	}
+
+	ring.size = size;
+	ring.head = 0;
+
+	glGenBuffers(1, &ring.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, ring.buffer);
+	gl_label(GL_BUFFER, ring.buffer, (&ring == &vertex_ring ? "DrawLines vertex ring" : "DrawLines instance ring"));
+	if (buffer_storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		buffer_storage(GL_ARRAY_BUFFER, GLsizeiptr(ring.size), nullptr, flags);
+		ring.mapping = static_cast< uint8_t * >(glMapBufferRange(GL_ARRAY_BUFFER, 0, GLsizeiptr(ring.size), flags));
+		if (!ring.mapping) {
+			throw std::runtime_error("Failed to persistently map DrawLines stream buffer.");
+		}
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(ring.size), nullptr, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+//can 'bytes' be reserved without wrapping or growing the ring?
+static bool ring_fits(StreamRing const &ring, size_t bytes) {
+	return ring.head + bytes <= ring.size;
+}
+
+//reserve 'bytes' contiguous bytes (waiting for any draws still reading them); returns their offset:
+// n.b. may wrap around or re-allocate the ring, so anything pending in the ring should be drawn first
+static size_t ring_reserve(StreamRing &ring, size_t bytes) {
+	bytes = (bytes + RingAlignment - 1) / RingAlignment * RingAlignment;
+	if (bytes > ring.size) {
+		ring_allocate(ring, std::max(bytes, 2 * ring.size));
+	}
+	if (!ring_fits(ring, bytes)) {
+		ring.head = 0;
+	}
+	size_t begin = ring.head;
+	size_t end = begin + bytes;
+
+	auto overlaps = [&]() {
+		for (auto const &fence : ring.fences) {
+			if (fence.begin < end && begin < fence.end) return true;
+		}
+		return false;
+	};
+	while (!ring.fences.empty() && overlaps()) {
+		//(draws finish in order, so waiting on the oldest first never waits longer than needed)
+		GLenum result;
+		do {
+			result = glClientWaitSync(ring.fences.front().sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+		} while (result == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(ring.fences.front().sync);
+		ring.fences.pop_front();
+	}
+	//also forget fences that have already passed, so the list stays short:
+	while (!ring.fences.empty() && glClientWaitSync(ring.fences.front().sync, 0, 0) != GL_TIMEOUT_EXPIRED) {
+		glDeleteSync(ring.fences.front().sync);
+		ring.fences.pop_front();
+	}
+
+	ring.head = end;
+	return begin;
+}
+
+//copy data to reserved bytes:
+static void ring_write(StreamRing &ring, size_t at, void const *data, size_t bytes) {
+	if (ring.mapping) {
+		std::memcpy(ring.mapping + at, data, bytes);
+	} else {
+		glBindBuffer(GL_ARRAY_BUFFER, ring.buffer);
+		void *dst = glMapBufferRange(GL_ARRAY_BUFFER, GLintptr(at), GLsizeiptr(bytes), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (dst) {
+			std::memcpy(dst, data, bytes);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		} else {
+			//(mapping failed -- fall back to a plain upload)
+			glBufferSubData(GL_ARRAY_BUFFER, GLintptr(at), GLsizeiptr(bytes), data);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	stats.upload_bytes += uint32_t(bytes);
+}
+
+//remember that the draws just issued read [begin,end) of the ring:
+static void ring_fence(StreamRing &ring, size_t begin, size_t end) {
+	RingFence fence;
+	fence.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	fence.begin = begin;
+	fence.end = end;
+	ring.fences.emplace_back(fence);
+}
+
+//append a shape made of (x,y,z) line endpoints, all with the same color:
+static uint32_t add_shape(std::vector< glm::vec3 > const &points, glm::u8vec4 const &color = glm::u8vec4(0xff)) {
+	shapes.emplace_back(uint32_t(shape_vertices.size()), uint32_t(points.size()));
+	for (auto const &pt : points) {
+		shape_vertices.emplace_back(ShapeVertex{pt, color});
+	}
+	return uint32_t(shapes.size()) - 1;
+}
 
 static Load< void > setup_buffers(LoadTagDefault, [](){
 	//you may recognize this init code from DrawSprites.cpp:
 
-	{ //set up vertex buffer:
-		glGenBuffers(1, &vertex_buffer);
-		//for now, buffer will be un-filled.
+	{ //set up stream buffers:
+		if (gl_has_extension("GL_ARB_buffer_storage")) {
+			buffer_storage = (BufferStorageFn)gl_get_proc_address("glBufferStorage");
+		}
+		//room for a few frames of a few tens of thousands of vertices:
+		ring_allocate(vertex_ring, size_t(1) << 22);
+		//...or instances:
+		ring_allocate(instance_ring, size_t(1) << 21);
+	}
+
+	{ //build and upload shapes:
+		PathFont const &font = PathFont::font;
+		for (uint32_t g = 0; g < font.glyphs; ++g) {
+			std::vector< glm::vec3 > points;
+			for (uint32_t c = font.glyph_coord_starts[g]; c + 1 < font.glyph_coord_starts[g+1]; c += 2) {
+				points.emplace_back(font.coords[c], font.coords[c+1], 0.0f);
+			}
+			add_shape(points);
+		}
+		//missing glyphs draw as a tofu:
+		tofu_shape = add_shape({
+			glm::vec3(0.1f, 0.1f, 0.0f), glm::vec3(0.6f, 0.1f, 0.0f),
+			glm::vec3(0.6f, 0.1f, 0.0f), glm::vec3(0.6f, 0.9f, 0.0f),
+			glm::vec3(0.9f, 0.6f, 0.0f), glm::vec3(0.1f, 0.9f, 0.0f),
+			glm::vec3(0.1f, 0.9f, 0.0f), glm::vec3(0.1f, 0.1f, 0.0f)
+		});
+		//[-1,1]^3 cube as three edge sets:
+		{
+			std::vector< glm::vec3 > points;
+			for (uint32_t axis = 0; axis < 3; ++axis) {
+				for (float a : {-1.0f, 1.0f}) {
+					for (float b : {-1.0f, 1.0f}) {
+						glm::vec3 from(0.0f), to(0.0f);
+						from[axis] = -1.0f; to[axis] = 1.0f;
+						from[(axis+1)%3] = to[(axis+1)%3] = b;
+						from[(axis+2)%3] = to[(axis+2)%3] = a;
+						points.emplace_back(from);
+						points.emplace_back(to);
+					}
+				}
+			}
+			box_shape = add_shape(points);
+		}
+		//axes (each direction its own color, so this shape is built by hand):
+		axes_shape = uint32_t(shapes.size());
+		shapes.emplace_back(uint32_t(shape_vertices.size()), 12U);
+		for (uint32_t axis = 0; axis < 3; ++axis) {
+			for (float sign : {1.0f, -1.0f}) {
+				glm::u8vec4 color(0x00, 0x00, 0x00, 0xff);
+				color[axis] = (sign > 0.0f ? 0xff : 0x88);
+				glm::vec3 to(0.0f);
+				to[axis] = sign;
+				shape_vertices.emplace_back(ShapeVertex{glm::vec3(0.0f), color});
+				shape_vertices.emplace_back(ShapeVertex{to, color});
+			}
+		}
+
+		uint32_t largest = 0;
+		for (auto const &shape : shapes) largest = std::max(largest, shape.y);
+		batch_instances.resize(size_class(largest) + 1);
+
+		glGenBuffers(1, &shape_buffer);
+		glBindBuffer(GL_TEXTURE_BUFFER, shape_buffer);
+		glBufferData(GL_TEXTURE_BUFFER, shape_vertices.size() * sizeof(ShapeVertex), shape_vertices.data(), GL_STATIC_DRAW);
+		gl_label(GL_BUFFER, shape_buffer, "DrawLines shapes");
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+		glGenTextures(1, &shape_texture);
+		gl_bind_texture(0, GL_TEXTURE_BUFFER, shape_texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32UI, shape_buffer);
+		gl_label(GL_TEXTURE, shape_texture, "DrawLines shapes");
+		gl_bind_texture(0, GL_TEXTURE_BUFFER, 0);
 	}
 
 	{ //vertex array mapping buffer for color_program:
@@ -25,38 +284,34 @@ static Load< void > setup_buffers(LoadTagDefault, [](){
 		glGenVertexArrays(1, &vertex_buffer_for_color_program);
 
 		//set vertex_buffer_for_color_program as the current vertex array object:
-		glBindVertexArray(vertex_buffer_for_color_program);
-
-		//set vertex_buffer as the source of glVertexAttribPointer() commands:
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-
-		//set up the vertex array object to describe arrays of PongMode::Vertex:
-		glVertexAttribPointer(
-			color_program->Position_vec4, //attribute
-			3, //size
-			GL_FLOAT, //type
-			GL_FALSE, //normalized
-			sizeof(DrawLines::Vertex), //stride
-			(GLbyte *)0 + offsetof(DrawLines::Vertex, Position) //offset
-		);
+		gl_bind_vertex_array(vertex_buffer_for_color_program);
+		gl_label(GL_VERTEX_ARRAY, vertex_buffer_for_color_program, "DrawLines lines");
+
+		//n.b. attributes are pointed at the ring in flush(), since their offsets change every draw
 		glEnableVertexAttribArray(color_program->Position_vec4);
 		//[Note that it is okay to bind a vec3 input to a vec4 attribute -- the w component will be filled with 1.0 automatically]
-
-		glVertexAttribPointer(
-			color_program->Color_vec4, //attribute
-			4, //size
-			GL_UNSIGNED_BYTE, //type
-			GL_TRUE, //normalized
-			sizeof(DrawLines::Vertex), //stride
-			(GLbyte *)0 + offsetof(DrawLines::Vertex, Color) //offset
-		);
 		glEnableVertexAttribArray(color_program->Color_vec4);
 
-		//done referring to vertex_buffer, so unbind it:
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-
 		//done setting up vertex array object, so unbind it:
-		glBindVertexArray(0);
+		gl_bind_vertex_array(0);
+	}
+
+	{ //vertex array for line_instance_program (again, pointed at the ring in flush()):
+		glGenVertexArrays(1, &instance_buffer_for_line_instance_program);
+		gl_bind_vertex_array(instance_buffer_for_line_instance_program);
+		gl_label(GL_VERTEX_ARRAY, instance_buffer_for_line_instance_program, "DrawLines instances");
+		for (GLuint attribute : {
+			line_instance_program->Anchor_vec3,
+			line_instance_program->X_vec3,
+			line_instance_program->Y_vec3,
+			line_instance_program->Z_vec3,
+			line_instance_program->Color_vec4,
+			line_instance_program->Shape_uvec2
+		}) {
+			glEnableVertexAttribArray(attribute);
+			glVertexAttribDivisor(attribute, 1); //one value per instance
+		}
+		gl_bind_vertex_array(0);
 	}
 
 	GL_ERRORS(); //PARANOIA: make sure nothing strange happened during setup
@@ -72,93 +327,252 @@ void DrawLines::draw(glm::vec3 const &a, glm::vec3 const &b, glm::u8vec4 const &
 }
 
 void DrawLines::draw_box(glm::mat4x3 const &mat, glm::u8vec4 const &color) {
-	//draw cube as three edge sets:
-
-	draw(mat * glm::vec4(-1.0f,-1.0f,-1.0f, 1.0f), mat * glm::vec4( 1.0f,-1.0f,-1.0f, 1.0f), color);
-	draw(mat * glm::vec4(-1.0f, 1.0f,-1.0f, 1.0f), mat * glm::vec4( 1.0f, 1.0f,-1.0f, 1.0f), color);
-	draw(mat * glm::vec4(-1.0f,-1.0f, 1.0f, 1.0f), mat * glm::vec4( 1.0f,-1.0f, 1.0f, 1.0f), color);
-	draw(mat * glm::vec4(-1.0f, 1.0f, 1.0f, 1.0f), mat * glm::vec4( 1.0f, 1.0f, 1.0f, 1.0f), color);
+	instances.emplace_back(mat[3], mat[0], mat[1], mat[2], color, shapes[box_shape]);
+}
 
-	draw(mat * glm::vec4(-1.0f,-1.0f,-1.0f, 1.0f), mat * glm::vec4(-1.0f, 1.0f,-1.0f, 1.0f), color);
-	draw(mat * glm::vec4( 1.0f,-1.0f,-1.0f, 1.0f), mat * glm::vec4( 1.0f, 1.0f,-1.0f, 1.0f), color);
-	draw(mat * glm::vec4(-1.0f,-1.0f, 1.0f, 1.0f), mat * glm::vec4(-1.0f, 1.0f, 1.0f, 1.0f), color);
-	draw(mat * glm::vec4( 1.0f,-1.0f, 1.0f, 1.0f), mat * glm::vec4( 1.0f, 1.0f, 1.0f, 1.0f), color);
-	
-	draw(mat * glm::vec4(-1.0f,-1.0f,-1.0f, 1.0f), mat * glm::vec4(-1.0f,-1.0f, 1.0f, 1.0f), color);
-	draw(mat * glm::vec4( 1.0f,-1.0f,-1.0f, 1.0f), mat * glm::vec4( 1.0f,-1.0f, 1.0f, 1.0f), color);
-	draw(mat * glm::vec4(-1.0f, 1.0f,-1.0f, 1.0f), mat * glm::vec4(-1.0f, 1.0f, 1.0f, 1.0f), color);
-	draw(mat * glm::vec4( 1.0f, 1.0f,-1.0f, 1.0f), mat * glm::vec4( 1.0f, 1.0f, 1.0f, 1.0f), color);
+void DrawLines::draw_axes(glm::mat4x3 const &mat, glm::u8vec4 const &color) {
+	instances.emplace_back(mat[3], mat[0], mat[1], mat[2], color, shapes[axes_shape]);
 }
 
-void DrawLines::draw_text(std::string const &text, glm::vec3 const &anchor_in, glm::vec3 const &x, glm::vec3 const &y, glm::u8vec4 const &color, glm::vec3 *anchor_out) {
+//Text layouts are cached by string, as the shapes (glyphs) to draw and their offsets along the text's x axis,
+// so drawing a string that was drawn recently needs no glyph lookups:
+struct TextLayout {
+	std::vector< std::pair< uint32_t, float > > glyphs; //shape, offset (glyphs with no strokes, e.g. ' ', are left out)
+	float advance = 0.0f; //distance along x to the end of the text
+	uint32_t last_used = 0; //frame
+};
+static std::unordered_map< std::string, TextLayout > text_layouts;
+static uint32_t text_frame = 0;
+
+//layouts not used for this many frames are dropped (so changing strings, e.g. scores, don't pile up):
+static constexpr uint32_t const TextLayoutFrames = 120;
+
+static TextLayout const &layout_text(std::string const &text) {
+	auto f = text_layouts.find(text);
+	if (f != text_layouts.end()) {
+		stats.text_hits += 1;
+		f->second.last_used = text_frame;
+		return f->second;
+	}
+	stats.text_misses += 1;
 
-	glm::vec3 anchor = anchor_in;
+	TextLayout &layout = text_layouts[text];
+	layout.last_used = text_frame;
+	float &anchor = layout.advance;
 
 	uint32_t start = 0;
 	while (start < text.size()) {
-		uint32_t end = start;
-		uint32_t glyph = -1U;
-		while (end < text.size()) {
-			end += 1;
-			auto f = PathFont::font.glyph_map.find(text.substr(start, end-start));
-			if (f == PathFont::font.glyph_map.end()) {
-				end -= 1;
-				break;
-			}
-			glyph = f->second;
-		}
+		uint32_t length = 0;
+		uint32_t glyph = PathFont::font.match(text.data() + start, text.size() - start, &length);
+		uint32_t end = start + length;
 		if (glyph == -1U) {
 			assert(start == end);
 			end += 1;
 			//missing! draw a tofu:
-			for (const auto &pt : {
-				glm::vec2(0.1f, 0.1f), glm::vec2(0.6f, 0.1f),
-				glm::vec2(0.6f, 0.1f), glm::vec2(0.6f, 0.9f),
-				glm::vec2(0.9f, 0.6f), glm::vec2(0.1f, 0.9f),
-				glm::vec2(0.1f, 0.9f), glm::vec2(0.1f, 0.1f)
-			}) {
-				attribs.emplace_back(anchor + pt.x * x + pt.y * y, color);
-			}
-			anchor += x * 0.6f;
+			layout.glyphs.emplace_back(tofu_shape, anchor);
+			anchor += 0.6f;
 		} else {
-			for (uint32_t c = PathFont::font.glyph_coord_starts[glyph]; c + 1 < PathFont::font.glyph_coord_starts[glyph+1]; c += 2) {
-				attribs.emplace_back(anchor + x * PathFont::font.coords[c] + y * PathFont::font.coords[c+1], color);
-			}
-			anchor += x * PathFont::font.glyph_widths[glyph];
+			if (shapes[glyph].y != 0) layout.glyphs.emplace_back(glyph, anchor);
+			anchor += PathFont::font.glyph_widths[glyph];
 		}
 		start = end;
 	}
 
-	if (anchor_out) *anchor_out = anchor;
+	return layout;
 }
 
-DrawLines::~DrawLines() {
-	if (attribs.empty()) return;
+void DrawLines::draw_text(std::string const &text, glm::vec3 const &anchor, glm::vec3 const &x, glm::vec3 const &y, glm::u8vec4 const &color, glm::vec3 *anchor_out) {
+	TextLayout const &layout = layout_text(text);
 
-	//based on DrawSprites.cpp :
+	instances.reserve(instances.size() + layout.glyphs.size());
+	for (auto const &glyph : layout.glyphs) {
+		instances.emplace_back(anchor + glyph.second * x, x, y, glm::vec3(0.0f), color, shapes[glyph.first]);
+	}
+
+	if (anchor_out) *anchor_out = anchor + layout.advance * x;
+}
 
-	//upload vertices to vertex_buffer:
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer); //set vertex_buffer as current
-	glBufferData(GL_ARRAY_BUFFER, attribs.size() * sizeof(attribs[0]), attribs.data(), GL_STREAM_DRAW); //upload attribs array
+DrawLines::Stats const &DrawLines::get_stats() {
+	return last_stats;
+}
+
+DrawLines::ResidentText::ResidentText(std::string const &text) {
+	TextLayout const &layout = layout_text(text);
+	advance = layout.advance;
+
+	//expand glyphs to glyph-space coordinates:
+	std::vector< glm::vec2 > coords;
+	for (auto const &glyph : layout.glyphs) {
+		glm::uvec2 shape = shapes[glyph.first];
+		for (uint32_t v = shape.x; v < shape.x + shape.y; ++v) {
+			coords.emplace_back(glyph.second + shape_vertices[v].Position.x, shape_vertices[v].Position.y);
+		}
+	}
+	count = uint32_t(coords.size());
+
+	//upload them:
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, coords.size() * sizeof(coords[0]), coords.data(), GL_STATIC_DRAW);
+
+	//vertex array object reading them as color_program's Position:
+	// (the Color array stays disabled, so the color set in draw() applies to every vertex)
+	glGenVertexArrays(1, &vertex_array);
+	gl_bind_vertex_array(vertex_array);
+	glVertexAttribPointer(
+		color_program->Position_vec4, //attribute
+		2, //size
+		GL_FLOAT, //type
+		GL_FALSE, //normalized
+		sizeof(glm::vec2), //stride
+		(GLbyte *)0 //offset
+	);
+	glEnableVertexAttribArray(color_program->Position_vec4);
+	//[z and w will be filled with 0.0 and 1.0 automatically]
+
+	gl_bind_vertex_array(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	//set color_program as current program:
-	glUseProgram(color_program->program);
+	GL_ERRORS();
+}
 
-	//upload OBJECT_TO_CLIP to the proper uniform location:
-	glUniformMatrix4fv(color_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip));
+DrawLines::ResidentText::~ResidentText() {
+	gl_delete_vertex_arrays(1, &vertex_array);
+	glDeleteBuffers(1, &buffer);
+}
 
-	//use the mapping vertex_buffer_for_color_program to fetch vertex data:
-	glBindVertexArray(vertex_buffer_for_color_program);
+void DrawLines::ResidentText::draw(glm::mat4 const &world_to_clip, glm::vec3 const &anchor, glm::vec3 const &x, glm::vec3 const &y, glm::u8vec4 const &color, glm::vec3 *anchor_out) const {
+	if (count != 0) {
+		//keep draw order with lines that have already been finished:
+		DrawLines::flush();
+
+		//glyph space to world space:
+		glm::mat4 glyph_to_world(
+			glm::vec4(x, 0.0f),
+			glm::vec4(y, 0.0f),
+			glm::vec4(0.0f),
+			glm::vec4(anchor, 1.0f)
+		);
 
-	//run the OpenGL pipeline:
-	glDrawArrays(GL_LINES, 0, GLsizei(attribs.size()));
+		gl_use_program(color_program->program);
+		glUniformMatrix4fv(color_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip * glyph_to_world));
+		gl_bind_vertex_array(vertex_array);
+		glVertexAttrib4f(color_program->Color_vec4, color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f);
+		glDrawArrays(GL_LINES, 0, GLsizei(count));
 
-	//reset vertex array to none:
-	glBindVertexArray(0);
+		stats.draws += 1;
+		stats.resident_draws += 1;
+	}
 
-	//reset current program to none:
-	glUseProgram(0);
+	if (anchor_out) *anchor_out = anchor + advance * x;
 }
 
+void DrawLines::flush() {
+	if (batch_vertex_count != 0) {
+		//set color_program as current program:
+		gl_use_program(color_program->program);
+
+		//upload OBJECT_TO_CLIP to the proper uniform location:
+		glUniformMatrix4fv(color_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(batch_world_to_clip));
+
+		//use the mapping vertex_buffer_for_color_program to fetch vertex data, starting at the batch:
+		gl_bind_vertex_array(vertex_buffer_for_color_program);
+		glBindBuffer(GL_ARRAY_BUFFER, vertex_ring.buffer);
+		glVertexAttribPointer(color_program->Position_vec4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLbyte *)0 + batch_vertices_begin + offsetof(Vertex, Position));
+		glVertexAttribPointer(color_program->Color_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLbyte *)0 + batch_vertices_begin + offsetof(Vertex, Color));
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
+		//run the OpenGL pipeline:
+		// (program and vertex array stay bound -- see gl_state.hpp)
+		glDrawArrays(GL_LINES, 0, batch_vertex_count);
+
+		//remember when this part of the ring may be overwritten:
+		ring_fence(vertex_ring, batch_vertices_begin, batch_vertices_begin + size_t(batch_vertex_count) * sizeof(Vertex));
+
+		stats.draws += 1;
+		batch_vertex_count = 0;
+	}
+
+	if (batch_instance_count != 0) {
+		//upload instances, grouped by size class:
+		instance_scratch.clear();
+		for (auto const &group : batch_instances) {
+			instance_scratch.insert(instance_scratch.end(), group.begin(), group.end());
+		}
+		size_t bytes = instance_scratch.size() * sizeof(Instance);
+		size_t at = ring_reserve(instance_ring, bytes);
+		ring_write(instance_ring, at, instance_scratch.data(), bytes);
+
+		gl_use_program(line_instance_program->program);
+		glUniformMatrix4fv(line_instance_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(batch_world_to_clip));
+		gl_bind_texture(0, GL_TEXTURE_BUFFER, shape_texture);
+		gl_bind_vertex_array(instance_buffer_for_line_instance_program);
+		glBindBuffer(GL_ARRAY_BUFFER, instance_ring.buffer);
+
+		//one instanced draw per size class, with enough vertices for the class's largest shape:
+		size_t offset = at;
+		for (uint32_t c = 0; c < batch_instances.size(); ++c) {
+			if (batch_instances[c].empty()) continue;
+			GLbyte *base = (GLbyte *)0 + offset;
+			glVertexAttribPointer(line_instance_program->Anchor_vec3, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), base + offsetof(Instance, Anchor));
+			glVertexAttribPointer(line_instance_program->X_vec3, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), base + offsetof(Instance, X));
+			glVertexAttribPointer(line_instance_program->Y_vec3, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), base + offsetof(Instance, Y));
+			glVertexAttribPointer(line_instance_program->Z_vec3, 3, GL_FLOAT, GL_FALSE, sizeof(Instance), base + offsetof(Instance, Z));
+			glVertexAttribPointer(line_instance_program->Color_vec4, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Instance), base + offsetof(Instance, Color));
+			glVertexAttribIPointer(line_instance_program->Shape_uvec2, 2, GL_UNSIGNED_INT, sizeof(Instance), base + offsetof(Instance, Shape));
+			glDrawArraysInstanced(GL_LINES, 0, GLsizei(1U << c), GLsizei(batch_instances[c].size()));
+			offset += batch_instances[c].size() * sizeof(Instance);
+			batch_instances[c].clear();
+			stats.draws += 1;
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		ring_fence(instance_ring, at, at + bytes);
+
+		batch_instance_count = 0;
+	}
+}
+
+void DrawLines::end_frame() {
+	flush();
+
+	//drop text layouts that haven't been used in a while:
+	for (auto t = text_layouts.begin(); t != text_layouts.end(); /* later */) {
+		if (text_frame - t->second.last_used >= TextLayoutFrames) t = text_layouts.erase(t);
+		else ++t;
+	}
+
+	stats.cached_strings = uint32_t(text_layouts.size());
+	last_stats = stats;
+	stats = Stats();
+	text_frame += 1;
+}
+
+DrawLines::~DrawLines() {
+	if (attribs.empty() && instances.empty()) return;
+
+	//lines with a different transform can't join the current batch:
+	if ((batch_vertex_count != 0 || batch_instance_count != 0) && batch_world_to_clip != world_to_clip) flush();
+
+	if (!attribs.empty()) {
+		size_t bytes = attribs.size() * sizeof(attribs[0]);
+		//the batch's vertices must be contiguous in the ring, so draw them before wrapping around:
+		if (batch_vertex_count != 0 && !ring_fits(vertex_ring, bytes)) flush();
+
+		size_t at = ring_reserve(vertex_ring, bytes);
+		ring_write(vertex_ring, at, attribs.data(), bytes);
+		if (batch_vertex_count == 0) batch_vertices_begin = at;
+		assert(at == batch_vertices_begin + size_t(batch_vertex_count) * sizeof(Vertex));
+		batch_vertex_count += GLsizei(attribs.size());
+		stats.vertices += uint32_t(attribs.size());
+	}
+
+	for (auto const &instance : instances) {
+		batch_instances[size_class(instance.Shape.y)].emplace_back(instance);
+	}
+	batch_instance_count += uint32_t(instances.size());
+	stats.instances += uint32_t(instances.size());
+
+	batch_world_to_clip = world_to_clip;
+}
@@ -24,6 +24,10 @@ struct DrawLines {
 	//draw a wireframe box corresponding to the [-1,1]^3 cube transformed by mat:
 	void draw_box(glm::mat4x3 const &mat, glm::u8vec4 const &color = glm::u8vec4(0xff));
 
+	//draw axes from mat[3] along +/- each of mat's first three columns:
+	// (colored red, green, blue -- darker for the negative directions -- times color)
+	void draw_axes(glm::mat4x3 const &mat, glm::u8vec4 const &color = glm::u8vec4(0xff));
+
 	//draw wireframe text, start at anchor, move in x direction, mat gives x and y directions for text drawing:
 	// (default character box is 1 unit high)
 	void draw_text(std::string const &text,
@@ -34,8 +38,58 @@ struct DrawLines {
 		glm::vec3 *anchor_out = nullptr);
 
 	//Finish drawing (push attribs to GPU):
+	// consecutive DrawLines with the same world_to_clip are merged into one draw, so the actual
+	// draw happens later -- when lines with a different world_to_clip finish, or at flush().
+	//NOTE: a batch doesn't keep the order of the calls that made it: plain lines are drawn first, then
+	// text/boxes/axes grouped by shape size. So overlapping draws in one batch have no defined order;
+	// to layer things (e.g., a drop shadow under text), finish the lower layer's DrawLines and flush() before the next.
 	~DrawLines();
 
+	//Draw any lines that have been finished but not yet drawn:
+	// call this before changing GL state (depth test, blending, framebuffer, ...) that the lines should be drawn with.
+	static void flush();
+
+	//flush(), then do per-frame bookkeeping (stats, dropping old cached text):
+	// main loops call this once per frame, before swapping.
+	static void end_frame();
+
+	//work done by DrawLines, for performance overlays:
+	// (draw_text keeps the layout of recently-drawn strings, so redrawing a string skips glyph lookup)
+	struct Stats {
+		uint32_t draws = 0; //GL draw calls
+		uint32_t vertices = 0; //line vertices uploaded
+		uint32_t instances = 0; //box, axes, and glyph instances uploaded
+		uint32_t upload_bytes = 0; //(for both of the above)
+		uint32_t text_hits = 0; //draw_text calls that used a cached layout
+		uint32_t text_misses = 0; //draw_text calls that had to lay out their string
+		uint32_t resident_draws = 0; //ResidentText draws (these upload nothing)
+		uint32_t cached_strings = 0; //layouts in the cache
+	};
+	//stats for the last completed frame (i.e., as of the last end_frame):
+	static Stats const &get_stats();
+
+	//ResidentText keeps a string's layout in its own GPU buffer, for static strings drawn every frame:
+	// (needs a GL context; drawn immediately, after any lines already waiting to be flushed)
+	struct ResidentText {
+		ResidentText(std::string const &text);
+		~ResidentText();
+		ResidentText(ResidentText const &) = delete;
+		ResidentText &operator=(ResidentText const &) = delete;
+
+		//draw with the same placement as DrawLines::draw_text:
+		void draw(glm::mat4 const &world_to_clip,
+			glm::vec3 const &anchor,
+			glm::vec3 const &x = glm::vec3(1.0f, 0.0f, 0.0f),
+			glm::vec3 const &y = glm::vec3(0.0f, 1.0f, 1.0f),
+			glm::u8vec4 const &color = glm::u8vec4(0xff),
+			glm::vec3 *anchor_out = nullptr) const;
+
+		float advance = 0.0f; //length of text, in character heights
+		uint32_t count = 0; //vertices
+		uint32_t buffer = 0; //(GLuint) glyph-space vertices
+		uint32_t vertex_array = 0; //(GLuint) for color_program
+	};
+
 
 	glm::mat4 world_to_clip;
 	struct Vertex {
@@ -45,4 +99,16 @@ struct DrawLines {
 	};
 	std::vector< Vertex > attribs;
 
+	//boxes, axes, and text glyphs aren't expanded to vertices on the CPU -- each is one instance of a
+	// shape (glyph strokes, unit box, axes) that is kept on the GPU and placed by the vertex shader:
+	struct Instance {
+		Instance(glm::vec3 const &Anchor_, glm::vec3 const &X_, glm::vec3 const &Y_, glm::vec3 const &Z_, glm::u8vec4 const &Color_, glm::uvec2 const &Shape_)
+			: Anchor(Anchor_), X(X_), Y(Y_), Z(Z_), Color(Color_), Shape(Shape_) { }
+		glm::vec3 Anchor; //shape's (0,0,0) goes here...
+		glm::vec3 X, Y, Z; //...and its x, y, z axes go along these
+		glm::u8vec4 Color;
+		glm::uvec2 Shape; //first vertex and vertex count of the shape
+	};
+	std::vector< Instance > instances;
+
 };
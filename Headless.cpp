@@ -0,0 +1,307 @@
+#include "Headless.hpp"
+
+#include "Mode.hpp"
+#include "DrawLines.hpp"
+#include "Profiler.hpp"
+#include "load_save_png.hpp"
+#include "gl_errors.hpp"
+#include "gl_debug.hpp"
+
+#include <SDL.h>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+Headless::Headless(int *argc, char **argv) {
+	int out = 1;
+	for (int a = 1; a < *argc; ++a) {
+		std::string arg = argv[a];
+		auto value = [&]() -> std::string {
+			if (a + 1 >= *argc) throw std::runtime_error("Expected a value after '" + arg + "'.");
+			a += 1;
+			return argv[a];
+		};
+		if (arg == "--headless") {
+			std::string count = value();
+			char *end = nullptr;
+			unsigned long parsed = std::strtoul(count.c_str(), &end, 10);
+			if (count.empty() || *end != '\0' || parsed == 0 || parsed > 0xffffffffUL) {
+				throw std::runtime_error("Expected '--headless <frames>' with frames > 0, got '" + count + "'.");
+			}
+			frames = uint32_t(parsed);
+			enabled = true;
+		} else if (arg == "--size") {
+			std::string wxh = value();
+			unsigned int w = 0, h = 0;
+			char extra = '\0';
+			if (std::sscanf(wxh.c_str(), "%ux%u%c", &w, &h, &extra) != 2 || w == 0 || h == 0 || w > 16384 || h > 16384) {
+				throw std::runtime_error("Expected '--size <w>x<h>', got '" + wxh + "'.");
+			}
+			size = glm::uvec2(w, h);
+			enabled = true;
+		} else if (arg == "--png") {
+			png = value();
+			enabled = true;
+		} else {
+			argv[out++] = argv[a];
+		}
+	}
+	argv[out] = nullptr;
+	*argc = out;
+
+	if (enabled && frames == 0) {
+		throw std::runtime_error("Headless options given without '--headless <frames>'.");
+	}
+}
+
+Headless::~Headless() {
+	if (framebuffer) {
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(1, &color_renderbuffer);
+		glDeleteRenderbuffers(1, &depth_renderbuffer);
+		framebuffer = color_renderbuffer = depth_renderbuffer = 0;
+	}
+#ifdef __linux__
+	if (display) {
+		eglMakeCurrent(EGLDisplay(display), EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context) eglDestroyContext(EGLDisplay(display), EGLContext(context));
+		eglTerminate(EGLDisplay(display));
+	}
+#else
+	if (context) SDL_GL_DeleteContext(SDL_GLContext(context));
+	if (display) SDL_DestroyWindow(static_cast< SDL_Window * >(display));
+#endif
+	display = context = nullptr;
+}
+
+void Headless::create_context() {
+	assert(enabled && !context);
+
+#ifdef __linux__
+	//Use Mesa's surfaceless platform if it is available, since it works without any display server:
+	EGLDisplay egl_display = EGL_NO_DISPLAY;
+	char const *client_extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS); //(nullptr if no client extensions)
+	if (client_extensions && std::strstr(client_extensions, "EGL_MESA_platform_surfaceless")) {
+		auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (get_platform_display) {
+			egl_display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		}
+	}
+	if (egl_display == EGL_NO_DISPLAY) {
+		egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, nullptr, nullptr)) {
+		throw std::runtime_error("Headless: failed to initialize EGL (error " + std::to_string(eglGetError()) + ").");
+	}
+	display = egl_display;
+
+	char const *display_extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+	if (!display_extensions || !std::strstr(display_extensions, "EGL_KHR_surfaceless_context")) {
+		throw std::runtime_error("Headless: EGL does not support EGL_KHR_surfaceless_context.");
+	}
+	if (!eglBindAPI(EGL_OPENGL_API)) {
+		throw std::runtime_error("Headless: EGL does not support desktop OpenGL.");
+	}
+
+	EGLint const config_attribs[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, //(no surface will be made, but some configs must be chosen)
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configs = 0;
+	if (!eglChooseConfig(egl_display, config_attribs, &config, 1, &configs) || configs < 1) {
+		throw std::runtime_error("Headless: no EGL config supports OpenGL.");
+	}
+
+	//Ask for an OpenGL context version 3.3, core profile (as main.cpp does):
+	// (debug builds also ask for a debug context, so the driver reports errors to gl_debug_init's callback)
+	EGLint const context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifndef NDEBUG
+		EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR,
+#endif
+		EGL_NONE
+	};
+	EGLContext egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, context_attribs);
+	if (egl_context == EGL_NO_CONTEXT) {
+		throw std::runtime_error("Headless: failed to create an OpenGL 3.3 core context (error " + std::to_string(eglGetError()) + ").");
+	}
+	context = egl_context;
+	if (!eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl_context)) {
+		throw std::runtime_error("Headless: failed to make the context current (error " + std::to_string(eglGetError()) + ").");
+	}
+#else
+	//no EGL; use a hidden window (which does need a display):
+	SDL_InitSubSystem(SDL_INIT_VIDEO);
+	SDL_GL_ResetAttributes();
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+#ifndef NDEBUG
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+#endif
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+	SDL_Window *window = SDL_CreateWindow("headless", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+	if (!window) {
+		throw std::runtime_error(std::string("Headless: failed to create hidden window: ") + SDL_GetError());
+	}
+	display = window;
+	context = SDL_GL_CreateContext(window);
+	if (!context) {
+		throw std::runtime_error(std::string("Headless: failed to create OpenGL context: ") + SDL_GetError());
+	}
+	SDL_GL_SetSwapInterval(0); //(never swapped, but just in case)
+#endif
+
+	//On windows, load OpenGL entrypoints: (does nothing on other platforms)
+	init_GL();
+
+	//Report OpenGL errors through GL_KHR_debug, if available (see gl_debug.hpp):
+	gl_debug_init();
+
+	std::cout << "Headless: " << glGetString(GL_RENDERER) << " / " << glGetString(GL_VERSION)
+		<< ", " << size.x << "x" << size.y << "." << std::endl;
+
+	//framebuffer to draw into:
+	glGenRenderbuffers(1, &color_renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, size.x, size.y);
+	glGenRenderbuffers(1, &depth_renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, size.x, size.y);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_renderbuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_renderbuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::runtime_error("Headless: offscreen framebuffer is incomplete.");
+	}
+	//(left bound -- modes draw to the currently-bound framebuffer)
+	glViewport(0, 0, size.x, size.y);
+
+	GL_ERRORS();
+}
+
+void Headless::run() {
+	//GPU times arrive a few frames late, so timestamp query pairs are used round-robin:
+	// (timestamps rather than GL_TIME_ELAPSED, since elapsed-time queries can't nest and modes may use their own)
+	std::array< GLuint, 4 > begin_queries, end_queries;
+	glGenQueries(GLsizei(begin_queries.size()), begin_queries.data());
+	glGenQueries(GLsizei(end_queries.size()), end_queries.data());
+
+	std::vector< double > cpu_ms;
+	std::vector< double > gpu_ms;
+	cpu_ms.reserve(frames);
+	gpu_ms.reserve(frames);
+	auto collect = [&](uint32_t frame) {
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(begin_queries[frame % begin_queries.size()], GL_QUERY_RESULT, &begin); //(waits for the result)
+		glGetQueryObjectui64v(end_queries[frame % end_queries.size()], GL_QUERY_RESULT, &end);
+		gpu_ms.emplace_back((end - begin) / 1.0e6);
+	};
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t frame = 0; frame < frames && Mode::current; ++frame) {
+		if (frame >= begin_queries.size()) collect(frame - uint32_t(begin_queries.size()));
+
+		Profiler::begin_frame(); //(so the mode's own profiler scopes are recorded)
+
+		auto before = std::chrono::high_resolution_clock::now();
+		glQueryCounter(begin_queries[frame % begin_queries.size()], GL_TIMESTAMP);
+
+		{
+			Profiler::Scope scope("update");
+			Mode::current->update(1.0f / 60.0f);
+		}
+		if (Mode::current) {
+			Profiler::Scope scope("draw");
+			Mode::current->draw(size);
+		}
+
+		{ //Draw any batched DrawLines (and update DrawLines text stats):
+			Profiler::Scope scope("DrawLines");
+			DrawLines::end_frame();
+		}
+
+		glQueryCounter(end_queries[frame % end_queries.size()], GL_TIMESTAMP);
+		auto after = std::chrono::high_resolution_clock::now();
+		cpu_ms.emplace_back(std::chrono::duration< double >(after - before).count() * 1000.0);
+
+		Profiler::end_frame();
+	}
+	while (gpu_ms.size() < cpu_ms.size()) collect(uint32_t(gpu_ms.size()));
+	auto end = std::chrono::high_resolution_clock::now();
+	glDeleteQueries(GLsizei(begin_queries.size()), begin_queries.data());
+	glDeleteQueries(GLsizei(end_queries.size()), end_queries.data());
+
+	GL_ERRORS();
+
+	std::cout << "frame,cpu_ms,gpu_ms\n";
+	std::cout << std::fixed << std::setprecision(3);
+	for (uint32_t i = 0; i < cpu_ms.size(); ++i) {
+		std::cout << i << ',' << cpu_ms[i] << ',' << gpu_ms[i] << '\n';
+	}
+
+	auto summarize = [](char const *name, std::vector< double > ms) {
+		if (ms.empty()) return;
+		std::sort(ms.begin(), ms.end());
+		double total = 0.0;
+		for (double t : ms) total += t;
+		std::cout << "# " << name << " ms: mean " << total / ms.size()
+			<< ", median " << ms[ms.size() / 2]
+			<< ", 95th percentile " << ms[std::min(ms.size() - 1, ms.size() * 95 / 100)]
+			<< ", max " << ms.back() << "\n";
+	};
+	std::cout << "# " << cpu_ms.size() << " frames at " << size.x << "x" << size.y
+		<< " in " << std::chrono::duration< double >(end - start).count() << " s\n";
+	summarize("cpu", cpu_ms);
+	summarize("gpu", gpu_ms);
+
+	//per-scope averages, from the profiler's (recent) history:
+	Profiler::History const &history = Profiler::get_history();
+	for (uint32_t n = 0; n < history.names.size(); ++n) {
+		double cpu = 0.0, gpu = 0.0;
+		uint32_t count = 0;
+		for (auto const &frame : history.frames) {
+			if (n >= frame.cpu_ms.size() || frame.cpu_ms[n] < 0.0f) continue;
+			cpu += frame.cpu_ms[n];
+			gpu += frame.gpu_ms[n];
+			count += 1;
+		}
+		if (count == 0) continue;
+		std::cout << "# " << std::string(2 * history.depths[n], ' ') << history.names[n] << " ms: cpu " << cpu / count << ", gpu " << gpu / count
+			<< " (mean of the last " << count << " frames)\n";
+	}
+	std::cout.flush();
+
+	if (!png.empty()) {
+		std::cout << "Saving last frame to '" << png << "'." << std::endl;
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		std::vector< glm::u8vec4 > data(size.x * size.y);
+		glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+		for (auto &px : data) {
+			px.a = 0xff;
+		}
+		save_png(png, size, data.data(), LowerLeftOrigin);
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+
+//Headless mode renders a fixed number of frames offscreen -- no window, no vsync -- and reports how long they took.
+// This is for benchmarking on machines without a display or GPU (e.g., CI hosts with Mesa's llvmpipe).
+//
+//game, show-meshes, and show-scene accept these options (anywhere; they are removed before the usual arguments are read):
+//  --headless <frames>   run this many frames, print timings, and exit
+//  --size <w>x<h>        framebuffer size (default 1280x720)
+//  --png <file.png>      save the last frame
+//
+//Timings go to stdout as CSV ("frame,cpu_ms,gpu_ms") followed by a summary (with per-scope times from Profiler.hpp):
+// cpu_ms is the time spent in update + draw (i.e., issuing the frame's GL commands);
+// gpu_ms is the difference of GL_TIMESTAMP queries issued before and after the same commands.
+//Updates use a fixed 1/60s time step, so runs are repeatable.
+
+struct Headless {
+	//removes any headless options from argc/argv; throws on malformed options:
+	Headless(int *argc, char **argv);
+	~Headless();
+	Headless(Headless const &) = delete;
+	Headless &operator=(Headless const &) = delete;
+
+	bool enabled = false; //were any headless options given?
+	uint32_t frames = 0;
+	glm::uvec2 size = glm::uvec2(1280, 720);
+	std::string png; //(empty if not saving)
+
+	//create a GL 3.3 core context with no window, and a framebuffer of 'size' to draw into:
+	// on Linux this uses EGL (preferring Mesa's surfaceless platform, which needs no display server);
+	// elsewhere it uses a hidden SDL window. Throws on failure.
+	void create_context();
+
+	//run Mode::current for 'frames' frames (or until it is set to null), print timings, and save 'png':
+	void run();
+
+	//offscreen framebuffer:
+	GLuint framebuffer = 0;
+	GLuint color_renderbuffer = 0;
+	GLuint depth_renderbuffer = 0;
+
+	//context (an EGLDisplay + EGLContext on Linux, an SDL_Window + SDL_GLContext elsewhere):
+	void *display = nullptr;
+	void *context = nullptr;
+};
@@ -0,0 +1,77 @@
+#include "LineInstanceProgram.hpp"
+
+#include "gl_compile_program.hpp"
+#include "gl_errors.hpp"
+#include "gl_state.hpp"
+#include "gl_debug.hpp"
+
+//submitted before any program is looked up, so the driver can compile all programs at once:
+static GLuint submitted_program = 0;
+static Load< void > submit_program(LoadTagShaders, [](){
+	submitted_program = gl_submit_program(
+		//vertex shader:
+		"#version 330\n"
+		"uniform mat4 OBJECT_TO_CLIP;\n"
+		"uniform usamplerBuffer SHAPES;\n"
+		"in vec3 Anchor;\n"
+		"in vec3 X;\n"
+		"in vec3 Y;\n"
+		"in vec3 Z;\n"
+		"in vec4 Color;\n"
+		"in uvec2 Shape;\n"
+		"out vec4 color;\n"
+		"void main() {\n"
+		"	if (uint(gl_VertexID) >= Shape.y) {\n"
+		"		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n" //(both ends of the line are past the end, so it gets clipped)
+		"		color = vec4(0.0);\n"
+		"		return;\n"
+		"	}\n"
+		"	uvec4 v = texelFetch(SHAPES, int(Shape.x) + gl_VertexID);\n"
+		"	vec3 p = uintBitsToFloat(v.xyz);\n"
+		"	gl_Position = OBJECT_TO_CLIP * vec4(Anchor + p.x * X + p.y * Y + p.z * Z, 1.0);\n"
+		"	vec4 tint = vec4((uvec4(v.w, v.w >> 8, v.w >> 16, v.w >> 24) & 0xffu)) / 255.0;\n"
+		"	color = Color * tint;\n"
+		"}\n"
+	,
+		//fragment shader:
+		"#version 330\n"
+		"in vec4 color;\n"
+		"out vec4 fragColor;\n"
+		"void main() {\n"
+		"	fragColor = color;\n"
+		"}\n"
+	);
+});
+
+Load< LineInstanceProgram > line_instance_program(LoadTagEarly);
+
+LineInstanceProgram::LineInstanceProgram() {
+	//wait for all submitted programs to compile and link (throws on errors):
+	gl_finish_programs();
+	program = submitted_program;
+	gl_label(GL_PROGRAM, program, "LineInstanceProgram");
+
+	//look up the locations of vertex attributes:
+	Anchor_vec3 = glGetAttribLocation(program, "Anchor");
+	X_vec3 = glGetAttribLocation(program, "X");
+	Y_vec3 = glGetAttribLocation(program, "Y");
+	Z_vec3 = glGetAttribLocation(program, "Z");
+	Color_vec4 = glGetAttribLocation(program, "Color");
+	Shape_uvec2 = glGetAttribLocation(program, "Shape");
+
+	//look up the locations of uniforms:
+	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
+	GLuint SHAPES_usamplerBuffer = glGetUniformLocation(program, "SHAPES");
+
+	//set SHAPES to always refer to texture binding zero:
+	gl_use_program(program);
+	glUniform1i(SHAPES_usamplerBuffer, 0);
+	gl_use_program(0);
+
+	GL_ERRORS();
+}
+
+LineInstanceProgram::~LineInstanceProgram() {
+	gl_delete_program(program);
+	program = 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "GL.hpp"
+#include "Load.hpp"
+
+//Shader program that draws instances of line shapes (used by DrawLines for glyphs, boxes, and axes):
+// each instance places a shape (a run of line endpoints in the SHAPES buffer texture) at Anchor, with
+// axes X, Y, Z; draws are issued with enough vertices for the largest shape in the draw, and vertices
+// past the end of an instance's own shape are moved outside the view volume.
+struct LineInstanceProgram {
+	LineInstanceProgram();
+	~LineInstanceProgram();
+
+	GLuint program = 0;
+
+	//Attribute (per-instance variable) locations:
+	GLuint Anchor_vec3 = -1U;
+	GLuint X_vec3 = -1U;
+	GLuint Y_vec3 = -1U;
+	GLuint Z_vec3 = -1U;
+	GLuint Color_vec4 = -1U;
+	GLuint Shape_uvec2 = -1U; //first vertex and vertex count of the shape in SHAPES
+
+	//Uniform (per-invocation variable) locations:
+	GLuint OBJECT_TO_CLIP_mat4 = -1U;
+
+	//Textures:
+	//TEXTURE0 - GL_TEXTURE_BUFFER of GL_RGBA32UI shape vertices: xyz are float bits of the position, w is an RGBA8 color that multiplies the instance's
+};
+
+extern Load< LineInstanceProgram > line_instance_program;
@@ -2,143 +2,227 @@
 
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
+#include "gl_debug.hpp"
+
+#include <array>
+#include <string>
+#include <cassert>
 
 Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
 
-Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> LitColorTextureProgram const * {
-	LitColorTextureProgram *ret = new LitColorTextureProgram();
+//the variant used by lit_color_texture_program is submitted along with all the other programs:
+static Load< void > submit_program(LoadTagShaders, [](){
+	LitColorTextureVariant::submit(LitColorTextureProgram< LitHemi >::Key);
+});
+
+Load< LitColorTextureProgram< LitHemi > > lit_color_texture_program(LoadTagEarly, []() -> LitColorTextureProgram< LitHemi > const * {
+	LitColorTextureProgram< LitHemi > const &ret = LitColorTextureProgram< LitHemi >::get();
 
 	//----- build the pipeline template -----
-	lit_color_texture_program_pipeline.program = ret->program;
-
-	lit_color_texture_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
-	lit_color_texture_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
-	lit_color_texture_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
-
-	/* This will be used later if/when we build a light loop into the Scene:
-	lit_color_texture_program_pipeline.LIGHT_TYPE_int = ret->LIGHT_TYPE_int;
-	lit_color_texture_program_pipeline.LIGHT_LOCATION_vec3 = ret->LIGHT_LOCATION_vec3;
-	lit_color_texture_program_pipeline.LIGHT_DIRECTION_vec3 = ret->LIGHT_DIRECTION_vec3;
-	lit_color_texture_program_pipeline.LIGHT_ENERGY_vec3 = ret->LIGHT_ENERGY_vec3;
-	lit_color_texture_program_pipeline.LIGHT_CUTOFF_float = ret->LIGHT_CUTOFF_float;
-	*/
-
-	//make a 1-pixel white texture to bind by default:
-	GLuint tex;
-	glGenTextures(1, &tex);
-
-	glBindTexture(GL_TEXTURE_2D, tex);
-	std::vector< glm::u8vec4 > tex_data(1, glm::u8vec4(0xff));
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex_data.data());
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-
-	lit_color_texture_program_pipeline.textures[0].texture = tex;
-	lit_color_texture_program_pipeline.textures[0].target = GL_TEXTURE_2D;
-
-	return ret;
+	lit_color_texture_program_pipeline = ret.make_pipeline();
+
+	return &ret;
 });
 
-LitColorTextureProgram::LitColorTextureProgram() {
-	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
-	program = gl_compile_program(
-		//vertex shader:
+//each variant's program (0 if not yet submitted):
+static std::array< GLuint, LitVariantCount > submitted_programs{};
+
+void LitColorTextureVariant::submit(uint32_t key) {
+	assert(key < LitVariantCount);
+	if (submitted_programs[key] != 0) return;
+
+	//the variant's settings, as #defines (which go right after the '#version' line):
+	std::string defines =
 		"#version 330\n"
+		"#define LIGHT_TYPE " + std::to_string(key & 3) + "\n"
+		"#define HAS_TEXTURE " + std::to_string((key >> 2) & LitTexture ? 1 : 0) + "\n"
+		"#define HAS_VERTEX_COLOR " + std::to_string((key >> 2) & LitVertexColor ? 1 : 0) + "\n";
+
+	//Compile vertex and fragment shaders using the convenient 'gl_submit_program' helper function:
+	submitted_programs[key] = gl_submit_program(
+		//vertex shader:
+		defines +
 		"uniform mat4 OBJECT_TO_CLIP;\n"
 		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
 		"uniform mat3 NORMAL_TO_LIGHT;\n"
-		"in vec4 Position;\n"
-		"in vec3 Normal;\n"
-		"in vec4 Color;\n"
-		"in vec2 TexCoord;\n"
+		"layout(location = 0) in vec4 Position;\n"
+		"layout(location = 1) in vec3 Normal;\n"
 		"out vec3 position;\n"
 		"out vec3 normal;\n"
+		"#if HAS_VERTEX_COLOR\n"
+		"layout(location = 2) in vec4 Color;\n"
 		"out vec4 color;\n"
+		"#endif\n"
+		"#if HAS_TEXTURE\n"
+		"layout(location = 3) in vec2 TexCoord;\n"
 		"out vec2 texCoord;\n"
+		"#endif\n"
 		"void main() {\n"
 		"	gl_Position = OBJECT_TO_CLIP * Position;\n"
 		"	position = OBJECT_TO_LIGHT * Position;\n"
 		"	normal = NORMAL_TO_LIGHT * Normal;\n"
+		"#if HAS_VERTEX_COLOR\n"
 		"	color = Color;\n"
+		"#endif\n"
+		"#if HAS_TEXTURE\n"
 		"	texCoord = TexCoord;\n"
+		"#endif\n"
 		"}\n"
 	,
 		//fragment shader:
-		"#version 330\n"
-		"uniform sampler2D TEX;\n"
-		"uniform int LIGHT_TYPE;\n"
+		defines +
+		"uniform vec3 LIGHT_ENERGY;\n"
+		"#if LIGHT_TYPE == 0 || LIGHT_TYPE == 2\n"
 		"uniform vec3 LIGHT_LOCATION;\n"
+		"#endif\n"
+		"#if LIGHT_TYPE != 0\n"
 		"uniform vec3 LIGHT_DIRECTION;\n"
-		"uniform vec3 LIGHT_ENERGY;\n"
+		"#endif\n"
+		"#if LIGHT_TYPE == 2\n"
 		"uniform float LIGHT_CUTOFF;\n"
+		"#endif\n"
 		"in vec3 position;\n"
 		"in vec3 normal;\n"
+		"#if HAS_VERTEX_COLOR\n"
 		"in vec4 color;\n"
+		"#endif\n"
+		"#if HAS_TEXTURE\n"
+		"uniform sampler2D TEX;\n"
 		"in vec2 texCoord;\n"
+		"#endif\n"
 		"out vec4 fragColor;\n"
 		"void main() {\n"
 		"	vec3 n = normalize(normal);\n"
 		"	vec3 e;\n"
-		"	if (LIGHT_TYPE == 0) { //point light \n"
-		"		vec3 l = (LIGHT_LOCATION - position);\n"
-		"		float dis2 = dot(l,l);\n"
-		"		l = normalize(l);\n"
-		"		float nl = max(0.0, dot(n, l)) / max(1.0, dis2);\n"
-		"		e = nl * LIGHT_ENERGY;\n"
-		"	} else if (LIGHT_TYPE == 1) { //hemi light \n"
-		"		e = (dot(n,-LIGHT_DIRECTION) * 0.5 + 0.5) * LIGHT_ENERGY;\n"
-		"	} else if (LIGHT_TYPE == 2) { //spot light \n"
-		"		vec3 l = (LIGHT_LOCATION - position);\n"
-		"		float dis2 = dot(l,l);\n"
-		"		l = normalize(l);\n"
-		"		float nl = max(0.0, dot(n, l)) / max(1.0, dis2);\n"
-		"		float c = dot(l,-LIGHT_DIRECTION);\n"
-		"		nl *= smoothstep(LIGHT_CUTOFF,mix(LIGHT_CUTOFF,1.0,0.1), c);\n"
-		"		e = nl * LIGHT_ENERGY;\n"
-		"	} else { //(LIGHT_TYPE == 3) //directional light \n"
-		"		e = max(0.0, dot(n,-LIGHT_DIRECTION)) * LIGHT_ENERGY;\n"
-		"	}\n"
-		"	vec4 albedo = texture(TEX, texCoord) * color;\n"
+		"#if LIGHT_TYPE == 0 //point light \n"
+		"	vec3 l = (LIGHT_LOCATION - position);\n"
+		"	float dis2 = dot(l,l);\n"
+		"	l = normalize(l);\n"
+		"	float nl = max(0.0, dot(n, l)) / max(1.0, dis2);\n"
+		"	e = nl * LIGHT_ENERGY;\n"
+		"#elif LIGHT_TYPE == 1 //hemi light \n"
+		"	e = (dot(n,-LIGHT_DIRECTION) * 0.5 + 0.5) * LIGHT_ENERGY;\n"
+		"#elif LIGHT_TYPE == 2 //spot light \n"
+		"	vec3 l = (LIGHT_LOCATION - position);\n"
+		"	float dis2 = dot(l,l);\n"
+		"	l = normalize(l);\n"
+		"	float nl = max(0.0, dot(n, l)) / max(1.0, dis2);\n"
+		"	float c = dot(l,-LIGHT_DIRECTION);\n"
+		"	nl *= smoothstep(LIGHT_CUTOFF,mix(LIGHT_CUTOFF,1.0,0.1), c);\n"
+		"	e = nl * LIGHT_ENERGY;\n"
+		"#else //(LIGHT_TYPE == 3) //directional light \n"
+		"	e = max(0.0, dot(n,-LIGHT_DIRECTION)) * LIGHT_ENERGY;\n"
+		"#endif\n"
+		"	vec4 albedo = vec4(1.0);\n"
+		"#if HAS_TEXTURE\n"
+		"	albedo *= texture(TEX, texCoord);\n"
+		"#endif\n"
+		"#if HAS_VERTEX_COLOR\n"
+		"	albedo *= color;\n"
+		"#endif\n"
 		"	fragColor = vec4(e*albedo.rgb, albedo.a);\n"
 		"}\n"
 	);
 	//As you can see above, adjacent strings in C/C++ are concatenated.
 	// this is very useful for writing long shader programs inline.
+}
 
-	//look up the locations of vertex attributes:
-	Position_vec4 = glGetAttribLocation(program, "Position");
-	Normal_vec3 = glGetAttribLocation(program, "Normal");
-	Color_vec4 = glGetAttribLocation(program, "Color");
-	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
+Scene::Drawable::Pipeline LitColorTextureVariant::make_pipeline() const {
+	Scene::Drawable::Pipeline pipeline;
+	pipeline.program = program;
+
+	pipeline.OBJECT_TO_CLIP_mat4 = OBJECT_TO_CLIP_mat4;
+	pipeline.OBJECT_TO_LIGHT_mat4x3 = OBJECT_TO_LIGHT_mat4x3;
+	pipeline.NORMAL_TO_LIGHT_mat3 = NORMAL_TO_LIGHT_mat3;
+
+	//make a 1-pixel white texture to bind by default (shared by all variants):
+	static GLuint tex = [](){
+		GLuint tex;
+		glGenTextures(1, &tex);
+
+		gl_bind_texture(0, GL_TEXTURE_2D, tex);
+		std::vector< glm::u8vec4 > tex_data(1, glm::u8vec4(0xff));
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex_data.data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		gl_bind_texture(0, GL_TEXTURE_2D, 0);
+		return tex;
+	}();
+
+	pipeline.textures[0].texture = tex;
+	pipeline.textures[0].target = GL_TEXTURE_2D;
+
+	return pipeline;
+}
+
+template< LitLight LIGHT, uint32_t FEATURES >
+LitColorTextureProgram< LIGHT, FEATURES >::LitColorTextureProgram() {
+	key = Key;
+	submit(Key); //(does nothing if it was submitted ahead of time)
+
+	//wait for all submitted programs to compile and link (throws on errors):
+	gl_finish_programs();
+	program = submitted_programs[Key];
+	gl_label(GL_PROGRAM, program, "LitColorTextureProgram variant " + std::to_string(Key));
 
 	//look up the locations of uniforms:
 	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
 	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
 	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
 
-	LIGHT_TYPE_int = glGetUniformLocation(program, "LIGHT_TYPE");
-	LIGHT_LOCATION_vec3 = glGetUniformLocation(program, "LIGHT_LOCATION");
-	LIGHT_DIRECTION_vec3 = glGetUniformLocation(program, "LIGHT_DIRECTION");
 	LIGHT_ENERGY_vec3 = glGetUniformLocation(program, "LIGHT_ENERGY");
-	LIGHT_CUTOFF_float = glGetUniformLocation(program, "LIGHT_CUTOFF");
+	//(uniforms the light type doesn't use aren't in the shader, so they stay -1U)
+	if (HasLocation) LIGHT_LOCATION_vec3 = glGetUniformLocation(program, "LIGHT_LOCATION");
+	if (HasDirection) LIGHT_DIRECTION_vec3 = glGetUniformLocation(program, "LIGHT_DIRECTION");
+	if (HasCutoff) LIGHT_CUTOFF_float = glGetUniformLocation(program, "LIGHT_CUTOFF");
 
+	if (FEATURES & LitTexture) {
+		GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
 
-	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
+		//set TEX to always refer to texture binding zero:
+		gl_use_program(program); //bind program -- glUniform* calls refer to this program now
 
-	//set TEX to always refer to texture binding zero:
-	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
+		glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
 
-	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
+		gl_use_program(0); //unbind program -- glUniform* calls refer to ??? now
+	}
+}
 
-	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
+template< LitLight LIGHT, uint32_t FEATURES >
+LitColorTextureProgram< LIGHT, FEATURES > const &LitColorTextureProgram< LIGHT, FEATURES >::get() {
+	static LitColorTextureProgram const *variant = new LitColorTextureProgram();
+	return *variant;
 }
 
-LitColorTextureProgram::~LitColorTextureProgram() {
-	glDeleteProgram(program);
-	program = 0;
+//instantiate every variant, so they can be used from other files and chosen by key:
+#define LIT_VARIANTS(FEATURES) \
+	template struct LitColorTextureProgram< LitPoint, FEATURES >; \
+	template struct LitColorTextureProgram< LitHemi, FEATURES >; \
+	template struct LitColorTextureProgram< LitSpot, FEATURES >; \
+	template struct LitColorTextureProgram< LitDirectional, FEATURES >;
+LIT_VARIANTS(0)
+LIT_VARIANTS(LitTexture)
+LIT_VARIANTS(LitVertexColor)
+LIT_VARIANTS(LitAllFeatures)
+#undef LIT_VARIANTS
+
+template< LitLight LIGHT, uint32_t FEATURES >
+static LitColorTextureVariant const &get_variant() {
+	return LitColorTextureProgram< LIGHT, FEATURES >::get();
 }
 
+LitColorTextureVariant const &LitColorTextureVariant::get(uint32_t key) {
+	//indexed by key:
+	static LitColorTextureVariant const &(* const getters[LitVariantCount])() = {
+		get_variant< LitPoint, 0 >, get_variant< LitHemi, 0 >, get_variant< LitSpot, 0 >, get_variant< LitDirectional, 0 >,
+		get_variant< LitPoint, LitTexture >, get_variant< LitHemi, LitTexture >, get_variant< LitSpot, LitTexture >, get_variant< LitDirectional, LitTexture >,
+		get_variant< LitPoint, LitVertexColor >, get_variant< LitHemi, LitVertexColor >, get_variant< LitSpot, LitVertexColor >, get_variant< LitDirectional, LitVertexColor >,
+		get_variant< LitPoint, LitAllFeatures >, get_variant< LitHemi, LitAllFeatures >, get_variant< LitSpot, LitAllFeatures >, get_variant< LitDirectional, LitAllFeatures >,
+	};
+	static_assert(lit_variant_key(LitDirectional, LitAllFeatures) == LitVariantCount - 1, "getters cover all keys");
+	assert(key < LitVariantCount);
+	return getters[key]();
+}
@@ -4,18 +4,57 @@
 #include "Load.hpp"
 #include "Scene.hpp"
 
-//Shader program that draws transformed, lit, textured vertices tinted with vertex colors:
-struct LitColorTextureProgram {
-	LitColorTextureProgram();
-	~LitColorTextureProgram();
+//Shader program that draws transformed, lit, textured vertices tinted with vertex colors.
+//
+//The light type and the optional features are compiled into the shaders (as #defines) rather than branched
+// on per-fragment, so each combination is a separate program -- a 'variant' -- identified by a key.
+
+//light types:
+enum LitLight : uint32_t {
+	LitPoint = 0,
+	LitHemi = 1,
+	LitSpot = 2,
+	LitDirectional = 3,
+};
+
+//optional features (bits):
+enum LitFeature : uint32_t {
+	LitTexture = 1, //multiply by TEX (TEXTURE0) sampled at TexCoord
+	LitVertexColor = 2, //multiply by Color
+	LitAllFeatures = LitTexture | LitVertexColor,
+};
+
+//variant key (e.g., for choosing a variant at draw time):
+constexpr uint32_t lit_variant_key(LitLight light, uint32_t features) {
+	return uint32_t(light) | (features << 2);
+}
+constexpr uint32_t const LitVariantCount = 16;
 
+//which light uniforms each light type uses:
+constexpr bool lit_light_has_location(LitLight light) {
+	return light == LitPoint || light == LitSpot;
+}
+constexpr bool lit_light_has_direction(LitLight light) {
+	return light != LitPoint;
+}
+constexpr bool lit_light_has_cutoff(LitLight light) {
+	return light == LitSpot;
+}
+
+//The parts of a variant that don't depend on its light type:
+struct LitColorTextureVariant {
+	uint32_t key = 0;
 	GLuint program = 0;
 
 	//Attribute (per-vertex variable) locations:
-	GLuint Position_vec4 = -1U;
-	GLuint Normal_vec3 = -1U;
-	GLuint Color_vec4 = -1U;
-	GLuint TexCoord_vec2 = -1U;
+	// these are fixed by layout qualifiers, so a vao made for one variant works with all of them.
+	// (make vaos with a LitAllFeatures variant, though, so that Color and TexCoord get bound)
+	enum : GLuint {
+		Position_vec4 = 0,
+		Normal_vec3 = 1,
+		Color_vec4 = 2,
+		TexCoord_vec2 = 3,
+	};
 
 	//Uniform (per-invocation variable) locations:
 	GLuint OBJECT_TO_CLIP_mat4 = -1U;
@@ -23,18 +62,48 @@ struct LitColorTextureProgram {
 	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
 
 	//lighting:
-	GLuint LIGHT_TYPE_int = -1U;
-	GLuint LIGHT_LOCATION_vec3 = -1U;
-	GLuint LIGHT_DIRECTION_vec3 = -1U;
+	// a variant's shader only has the uniforms its light type uses (see lit_light_has_*); the rest stay -1U,
+	// which glUniform* ignores -- so code that picks a variant by key can set all of them.
 	GLuint LIGHT_ENERGY_vec3 = -1U;
-	GLuint LIGHT_CUTOFF_float = -1U;
-	
+	GLuint LIGHT_LOCATION_vec3 = -1U; //point and spot lights
+	GLuint LIGHT_DIRECTION_vec3 = -1U; //hemi, spot, and directional lights
+	GLuint LIGHT_CUTOFF_float = -1U; //spot lights (cosine of the cone's half-angle)
+
 	//Textures:
-	//TEXTURE0 - texture that is accessed by TexCoord
+	//TEXTURE0 - texture that is accessed by TexCoord (in variants with LitTexture)
+
+	//For convenient scene-graph setup, copy a pipeline made by this function:
+	// NOTE: has texture bound to 1-pixel white texture -- so it's okay to use with vertex-color-only meshes.
+	Scene::Drawable::Pipeline make_pipeline() const;
+
+	//start compiling a variant, if it hasn't been already:
+	// (call at LoadTagShaders to have it compiled along with the other programs)
+	static void submit(uint32_t key);
+
+	//get a variant by key, compiling it now if it wasn't submitted ahead of time:
+	static LitColorTextureVariant const &get(uint32_t key);
+};
+
+//A variant whose key is known at compile time, so which light uniforms it has is known statically too:
+// (all variants are instantiated in LitColorTextureProgram.cpp)
+template< LitLight LIGHT, uint32_t FEATURES = LitAllFeatures >
+struct LitColorTextureProgram : LitColorTextureVariant {
+	static_assert(FEATURES <= LitAllFeatures, "Unknown LitFeature bits.");
+	static constexpr uint32_t Key = lit_variant_key(LIGHT, FEATURES);
+	static constexpr bool HasLocation = lit_light_has_location(LIGHT);
+	static constexpr bool HasDirection = lit_light_has_direction(LIGHT);
+	static constexpr bool HasCutoff = lit_light_has_cutoff(LIGHT);
+
+	//get the variant, compiling it now if it wasn't submitted ahead of time:
+	// (variants are kept until the program exits)
+	static LitColorTextureProgram const &get();
+
+private:
+	LitColorTextureProgram();
 };
 
-extern Load< LitColorTextureProgram > lit_color_texture_program;
+extern Load< LitColorTextureProgram< LitHemi > > lit_color_texture_program;
 
 //For convenient scene-graph setup, copy this object:
-// NOTE: by default, has texture bound to 1-pixel white texture -- so it's okay to use with vertex-color-only meshes.
+// (lit_color_texture_program->make_pipeline())
 extern Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
@@ -26,6 +26,7 @@
 #include <stdexcept>
 
 enum LoadTag : uint32_t {
+	LoadTagShaders, //(for submitting shader programs; see gl_compile_program.hpp)
 	LoadTagEarly,
 	LoadTagDefault,
 	LoadTagLate,
@@ -1,5 +1,7 @@
 #include "Mesh.hpp"
 #include "read_write_chunk.hpp"
+#include "gl_state.hpp"
+#include "gl_debug.hpp"
 
 #include <glm/glm.hpp>
 
@@ -34,6 +36,7 @@ MeshBuffer::MeshBuffer(std::string const &filename) {
 		//upload data:
 		glBindBuffer(GL_ARRAY_BUFFER, buffer);
 		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
+		gl_label(GL_BUFFER, buffer, filename);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 		total = GLuint(data.size()); //store total for later checks on index
@@ -110,7 +113,7 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	//create a new vertex array object:
 	GLuint vao = 0;
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	gl_bind_vertex_array(vao);
 
 	//Try to bind all attributes in this buffer:
 	std::set< GLuint > bound;
@@ -128,7 +131,7 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	bind_attribute("Color", Color);
 	bind_attribute("TexCoord", TexCoord);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	gl_bind_vertex_array(0);
 
 	//Check that all active attributes were bound:
 	GLint active = 0;
@@ -3,22 +3,30 @@
 
 #include "PathFont.hpp"
 
-#include <iostream>
+#include <cassert>
 
-PathFont::PathFont(uint32_t glyphs_,
-	const float *glyph_widths_,
-	const uint32_t *glyph_char_starts_, const uint8_t *chars_,
-	const uint32_t *glyph_coord_starts_, const float *coords_
-	) : glyphs(glyphs_),
-		glyph_widths(glyph_widths_),
-		glyph_char_starts(glyph_char_starts_), chars(chars_),
-		glyph_coord_starts(glyph_coord_starts_), coords(coords_) {
+uint32_t PathFont::match(char const *text, size_t size, uint32_t *length) const {
+	assert(size > 0);
+	assert(length);
 
-	for (uint32_t i = 0; i < glyphs; ++i) {
-		std::string str(reinterpret_cast< const char * >(chars + glyph_char_starts[i]), reinterpret_cast< const char * >(chars + glyph_char_starts[i+1]));
-		auto res = glyph_map.insert(std::make_pair(str, i));
-		if (!res.second) {
-			std::cerr << "WARNING: ignoring duplicate glyph for '" << str << "'." << std::endl;
+	uint8_t first = uint8_t(text[0]);
+	uint32_t glyph = byte_glyphs[first];
+	*length = (glyph == -1U ? 0 : 1);
+
+	//follow the trie for names longer than one byte:
+	uint32_t node = byte_nodes[first];
+	for (size_t i = 1; node != 0 && i < size; ++i) {
+		uint8_t byte = uint8_t(text[i]);
+		Edge const *edge = edges + node_edge_starts[node];
+		Edge const *end = edges + node_edge_starts[node+1];
+		while (edge != end && edge->byte < byte) ++edge;
+		if (edge == end || edge->byte != byte) break;
+		if (edge->glyph != -1U) {
+			glyph = edge->glyph;
+			*length = uint32_t(i + 1);
 		}
+		node = edge->node;
 	}
+
+	return glyph;
 }
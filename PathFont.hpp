@@ -10,17 +10,32 @@
 
 #include <glm/glm.hpp>
 
-#include <string>
-#include <vector>
-#include <map>
+#include <cstddef>
+#include <cstdint>
 
 struct PathFont {
+	//edge in the glyph-name trie (see below):
+	struct Edge {
+		uint8_t byte; //next byte of the name
+		uint32_t glyph; //glyph whose name ends with this byte, or -1U
+		uint32_t node; //trie node for longer names, or 0 if none
+	};
+
 	//meant to be intitialized with some pointers to constant data:
-	PathFont(uint32_t glyphs,
-		const float *glyph_widths,
-		const uint32_t *glyph_char_starts, const uint8_t *chars,
-		const uint32_t *glyph_coord_starts, const float *coords
-		);
+	// (constexpr so that the default font needs no work at startup)
+	constexpr PathFont(uint32_t glyphs_,
+		const float *glyph_widths_,
+		const uint32_t *glyph_char_starts_, const uint8_t *chars_,
+		const uint32_t *glyph_coord_starts_, const float *coords_,
+		const uint32_t *byte_glyphs_, const uint32_t *byte_nodes_,
+		const uint32_t *node_edge_starts_, const Edge *edges_
+		) : glyphs(glyphs_),
+			glyph_widths(glyph_widths_),
+			glyph_char_starts(glyph_char_starts_), chars(chars_),
+			glyph_coord_starts(glyph_coord_starts_), coords(coords_),
+			byte_glyphs(byte_glyphs_), byte_nodes(byte_nodes_),
+			node_edge_starts(node_edge_starts_), edges(edges_) {
+	}
 	const uint32_t glyphs = 0;
 	const float *glyph_widths = nullptr;
 
@@ -30,10 +45,17 @@ struct PathFont {
 	const uint32_t *glyph_coord_starts = nullptr; //indices into 'coords' table
 	const float *coords = nullptr;
 
-	//computed in constructor:
-	std::map< std::string, uint32_t > glyph_map;
+	//glyph lookup tables (built by make-PathFont-font.py):
+	const uint32_t *byte_glyphs = nullptr; //[256] glyph named by just this byte, or -1U
+	const uint32_t *byte_nodes = nullptr; //[256] trie node for longer names starting with this byte, or 0 if none
+	const uint32_t *node_edge_starts = nullptr; //indices into 'edges' table, per trie node (node 0 is unused)
+	const Edge *edges = nullptr; //sorted by byte within each node
+
+	//find the glyph with the longest name that is a prefix of text[0,size):
+	// returns the glyph (or -1U if none) and sets *length to the bytes it covers (0 if none).
+	// Doesn't allocate; single-byte glyphs take one table lookup.
+	uint32_t match(char const *text, size_t size, uint32_t *length) const;
 
 	//the default font:
 	static PathFont font;
 };
-
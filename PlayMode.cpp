@@ -3,14 +3,18 @@
 #include "LitColorTextureProgram.hpp"
 
 #include "DrawLines.hpp"
+#include "draw_mix_stats.hpp"
+#include "Profiler.hpp"
 #include "Mesh.hpp"
 #include "Load.hpp"
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
 #include "data_path.hpp"
 #include "Sound.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
+#include <iostream>
 #include <random>
 #include <time.h>
 
@@ -39,9 +43,19 @@ Load< Scene > catblob_scene(LoadTagDefault, []() -> Scene const * {
 });
 
 Load< Sound::Sample > bgmusic(LoadTagDefault, []() -> Sound::Sample const* {
-	return new Sound::Sample(data_path("bloodpixelhero__in-game.wav"));
+	//long music track -- stream it rather than keeping the whole thing in memory:
+	return new Sound::Sample(data_path("bloodpixelhero__in-game.wav"), Sound::Sample::Streamed);
 });
 
+//helper: switch a pipeline made for lit_color_texture_program to another variant:
+// (variants share attribute locations, so the pipeline's vao still works)
+static void use_lit_variant(Scene::Drawable::Pipeline &pipeline, LitColorTextureVariant const &variant) {
+	pipeline.program = variant.program;
+	pipeline.OBJECT_TO_CLIP_mat4 = variant.OBJECT_TO_CLIP_mat4;
+	pipeline.OBJECT_TO_LIGHT_mat4x3 = variant.OBJECT_TO_LIGHT_mat4x3;
+	pipeline.NORMAL_TO_LIGHT_mat3 = variant.NORMAL_TO_LIGHT_mat3;
+}
+
 PlayMode::Block PlayMode::new_block(float angle, float depth) {
 	// Look for any dead blocks we can reuse
 	for(Block &block : blocks) {
@@ -69,6 +83,7 @@ PlayMode::Block PlayMode::new_block(float angle, float depth) {
 
 	Scene::Drawable drawable(block.tile);
 	drawable.pipeline = lit_color_texture_program_pipeline;
+	use_lit_variant(drawable.pipeline, *lit_program);
 	drawable.pipeline.vao = catblob_meshes_for_lit_color_texture_program;
 	drawable.pipeline.type = grass_vertex_type;
 	drawable.pipeline.start = grass_vertex_start;
@@ -123,6 +138,22 @@ PlayMode::PlayMode() : scene(*catblob_scene) {
 	//init game states
 	score = 0;
 
+	//draw with the lit program variant for the scene's light type:
+	LitLight light_type = LitHemi;
+	if (!scene.lights.empty()) {
+		light = &scene.lights.front();
+		switch (light->type) {
+			case Scene::Light::Point: light_type = LitPoint; break;
+			case Scene::Light::Hemisphere: light_type = LitHemi; break;
+			case Scene::Light::Spot: light_type = LitSpot; break;
+			case Scene::Light::Directional: light_type = LitDirectional; break;
+		}
+	}
+	lit_program = &LitColorTextureVariant::get(lit_variant_key(light_type, LitAllFeatures));
+	for (auto& drawable : scene.drawables) {
+		use_lit_variant(drawable.pipeline, *lit_program);
+	}
+
 	//get pointers:
 	for (auto& drawable : scene.drawables) {
 		//sadness that switch doesnt work on string
@@ -269,6 +300,19 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 		else if (evt.key.keysym.sym == SDLK_r) {
 			reset();
 		}
+		else if (evt.key.keysym.sym == SDLK_F3) {
+			show_mix_stats = !show_mix_stats;
+			return true;
+		}
+		else if (evt.key.keysym.sym == SDLK_F4) {
+			try {
+				Sound::save_mix_stats_csv("mix-stats.csv", Sound::get_mix_stats());
+				std::cout << "Wrote mixer stats to 'mix-stats.csv'." << std::endl;
+			} catch (std::exception &e) {
+				std::cerr << e.what() << std::endl;
+			}
+			return true;
+		}
 	}
 	else if (evt.type == SDL_KEYUP) {
 		if (evt.key.keysym.sym == SDLK_a || evt.key.keysym.sym == SDLK_LEFT) {
@@ -422,74 +466,110 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 	//update camera aspect ratio for drawable:
 	camera->aspect = float(drawable_size.x) / float(drawable_size.y);
 
-	//set up light type and position for lit_color_texture_program:
-	// TODO: consider using the Light(s) in the scene to do this
-	glUseProgram(lit_color_texture_program->program);
-	glUniform1i(lit_color_texture_program->LIGHT_TYPE_int, 1);
-	glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f,-1.0f)));
-	glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, 1.0f, 0.95f)));
-	glUseProgram(0);
+	{ //set up lighting and clear:
+		Profiler::Scope scope("clear");
+
+		//set up the light for lit_program (light space == world space):
+		// (uniforms its light type doesn't use have location -1U, which glUniform* ignores)
+		glm::vec3 light_location(0.0f);
+		glm::vec3 light_direction(0.0f, 0.0f,-1.0f);
+		glm::vec3 light_energy(1.0f, 1.0f, 0.95f);
+		float light_cutoff = 1.0f;
+		if (light) {
+			glm::mat4x3 light_to_world = light->transform->make_local_to_world();
+			light_location = light_to_world[3];
+			light_direction = -glm::normalize(light_to_world[2]); //(lights point along their -z axis)
+			light_energy = light->energy;
+			light_cutoff = std::cos(0.5f * light->spot_fov);
+		}
+		gl_use_program(lit_program->program);
+		glUniform3fv(lit_program->LIGHT_LOCATION_vec3, 1, glm::value_ptr(light_location));
+		glUniform3fv(lit_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(light_direction));
+		glUniform1f(lit_program->LIGHT_CUTOFF_float, light_cutoff);
+		glUniform3fv(lit_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(light_energy));
 
-	glClearColor(0.71f, 0.95f, 1.0f, 1.0f);
-	glClearDepth(1.0f); //1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glClearColor(0.71f, 0.95f, 1.0f, 1.0f);
+		glClearDepth(1.0f); //1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LESS); //this is the default depth comparison function, but FYI you can change it.
+		gl_enable(GL_DEPTH_TEST, true);
+		gl_depth_func(GL_LESS); //this is the default depth comparison function, but FYI you can change it.
 
-	GL_ERRORS(); //print any errors produced by this setup code
+		GL_ERRORS(); //print any errors produced by this setup code
+	}
 
-	scene.draw(*camera);
+	{ //draw the scene:
+		Profiler::Scope scope("scene");
+		scene.draw(*camera);
+	}
 
 	{ //use DrawLines to overlay some text:
-		glDisable(GL_DEPTH_TEST);
+		Profiler::Scope scope("overlay");
+		gl_enable(GL_DEPTH_TEST, false);
 		float aspect = float(drawable_size.x) / float(drawable_size.y);
-		DrawLines lines(glm::mat4(
+		glm::mat4 screen_to_clip(
 			1.0f / aspect, 0.0f, 0.0f, 0.0f,
 			0.0f, 1.0f, 0.0f, 0.0f,
 			0.0f, 0.0f, 1.0f, 0.0f,
 			0.0f, 0.0f, 0.0f, 1.0f
-		));
+		);
 
 		constexpr float H = 0.09f;
 		constexpr float bigH = 0.8f;
 		constexpr float medH = 0.5f;
 		float ofs = 2.0f / drawable_size.y;
 		if (!game_over) {
-			lines.draw_text("Arrows/A+D to rotate tunnel, Space to jump, Hold Up/W or Down/S to speed or slow down",
+			help_text.draw(screen_to_clip,
 				glm::vec3(-aspect + 0.1f * H, -1.0 + 0.1f * H, 0.0),
 				glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
 				glm::u8vec4(0x00, 0x00, 0x00, 0x00));
-			lines.draw_text("Arrows/A+D to rotate tunnel, Space to jump, Hold Up/W or Down/S to speed or slow down",
+			help_text.draw(screen_to_clip,
 				glm::vec3(-aspect + 0.1f * H + ofs, -1.0 + + 0.1f * H + ofs, 0.0),
 				glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
 				glm::u8vec4(0xff, 0xff, 0xff, 0x00));
-			lines.draw_text("Score: " + std::to_string((int)score),
-				glm::vec3(-aspect + 0.1f * H, 1.0f - 1.1f * H, 0.0),
-				glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
-				glm::u8vec4(0x00, 0x00, 0x00, 0x00));
-			lines.draw_text("Score: " + std::to_string((int)score),
-				glm::vec3(-aspect + 0.1f * H + ofs, 1.0f - 1.1f * H + ofs, 0.0),
-				glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
-				glm::u8vec4(0xff, 0xff, 0xff, 0x00));
 		}
-		else {
-			lines.draw_text("Score: " + std::to_string((int)score),
-				glm::vec3(-aspect + 0.1f * bigH, 1.0f - 1.1f * bigH, 0.0),
-				glm::vec3(bigH, 0.0f, 0.0f), glm::vec3(0.0f, bigH, 0.0f),
-				glm::u8vec4(0x00, 0x00, 0x00, 0x00));
-			lines.draw_text("Score: " + std::to_string((int)score),
-				glm::vec3(-aspect + 0.1f * bigH + ofs, 1.0f - 1.1f * bigH + ofs, 0.0),
-				glm::vec3(bigH, 0.0f, 0.0f), glm::vec3(0.0f, bigH, 0.0f),
-				glm::u8vec4(0xff, 0xff, 0xff, 0x00));
-			lines.draw_text("Press R to restart",
-				glm::vec3(-aspect + 0.1f * medH, -1.0f + 0.1f * medH, 0.0),
-				glm::vec3(medH, 0.0f, 0.0f), glm::vec3(0.0f, medH, 0.0f),
-				glm::u8vec4(0x00, 0x00, 0x00, 0x00));
-			lines.draw_text("Press R to restart",
-				glm::vec3(-aspect + 0.1f * medH + ofs, -1.0f + 0.1f * medH + ofs, 0.0),
-				glm::vec3(medH, 0.0f, 0.0f), glm::vec3(0.0f, medH, 0.0f),
-				glm::u8vec4(0xff, 0xff, 0xff, 0x00));
+
+		//score (and restart prompt), offset by 'shift' -- drawn twice, for a drop shadow:
+		auto draw_status_text = [&](DrawLines &lines, float shift, glm::u8vec4 const &color) {
+			if (!game_over) {
+				lines.draw_text("Score: " + std::to_string((int)score),
+					glm::vec3(-aspect + 0.1f * H + shift, 1.0f - 1.1f * H + shift, 0.0),
+					glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+					color);
+			}
+			else {
+				lines.draw_text("Score: " + std::to_string((int)score),
+					glm::vec3(-aspect + 0.1f * bigH + shift, 1.0f - 1.1f * bigH + shift, 0.0),
+					glm::vec3(bigH, 0.0f, 0.0f), glm::vec3(0.0f, bigH, 0.0f),
+					color);
+				lines.draw_text("Press R to restart",
+					glm::vec3(-aspect + 0.1f * medH + shift, -1.0f + 0.1f * medH + shift, 0.0),
+					glm::vec3(medH, 0.0f, 0.0f), glm::vec3(0.0f, medH, 0.0f),
+					color);
+			}
+		};
+		{ //shadows:
+			DrawLines shadows(screen_to_clip);
+			draw_status_text(shadows, 0.0f, glm::u8vec4(0x00, 0x00, 0x00, 0x00));
+		}
+		//(draw the shadows before the text over them -- DrawLines doesn't keep draw order within a batch)
+		DrawLines::flush();
+
+		DrawLines lines(screen_to_clip);
+		draw_status_text(lines, ofs, glm::u8vec4(0xff, 0xff, 0xff, 0x00));
+
+		if (show_mix_stats) {
+			draw_mix_stats(lines, Sound::get_mix_stats(),
+				glm::vec3(aspect - 1.4f, 0.4f, 0.0f),
+				glm::vec3(1.3f, 0.0f, 0.0f), glm::vec3(0.0f, 0.45f, 0.0f));
+
+			DrawLines::Stats const &line_stats = DrawLines::get_stats();
+			lines.draw_text("lines: " + std::to_string(line_stats.draws) + " draws " + std::to_string(line_stats.vertices) + " verts "
+				+ std::to_string(line_stats.instances) + " inst " + std::to_string(line_stats.upload_bytes / 1024) + "kB, text "
+				+ std::to_string(line_stats.text_hits) + " hits " + std::to_string(line_stats.text_misses) + " misses",
+				glm::vec3(aspect - 1.4f, 0.4f - 0.36f * 0.45f, 0.0f), //(below the mix stats' own text lines)
+				glm::vec3(0.045f, 0.0f, 0.0f), glm::vec3(0.0f, 0.045f, 0.0f),
+				glm::u8vec4(0xff, 0xff, 0x88, 0xff));
 		}
 	}
 }
@@ -2,9 +2,12 @@
 
 #include "Scene.hpp"
 #include "Sound.hpp"
+#include "DrawLines.hpp"
 
 #include <glm/glm.hpp>
 
+struct LitColorTextureVariant;
+
 #include <vector>
 #include <deque>
 #include <array>
@@ -33,9 +36,20 @@ struct PlayMode : Mode {
 		uint8_t pressed = 0;
 	} left, right, up, slow, fast;
 
+	//mixer timing overlay (F3 toggles, F4 saves to 'mix-stats.csv'):
+	bool show_mix_stats = false;
+
+	//instructions (never change, so kept on the GPU):
+	DrawLines::ResidentText help_text{"Arrows/A+D to rotate tunnel, Space to jump, Hold Up/W or Down/S to speed or slow down"};
+
 	//local copy of the game scene (so code can change it during gameplay):
 	Scene scene;
 
+	//the scene's light (nullptr if it has none -- then a fixed hemi light is used):
+	Scene::Light const *light = nullptr;
+	//lit program variant for that light's type, chosen by key (see LitColorTextureProgram.hpp):
+	LitColorTextureVariant const *lit_program = nullptr;
+
 	//game state:
 	float score;
 	float game_over = false;
@@ -0,0 +1,203 @@
+#include "Profiler.hpp"
+
+#include "GL.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <stdexcept>
+
+bool Profiler::show = false;
+
+namespace {
+	//one run of a scope:
+	struct Record {
+		uint32_t name = 0; //index into History::names
+		std::chrono::high_resolution_clock::time_point cpu_begin, cpu_end;
+		GLuint begin_query = 0, end_query = 0; //GL_TIMESTAMP queries
+	};
+
+	//a frame whose GPU times haven't been read back yet:
+	struct PendingFrame {
+		uint64_t number = 0;
+		std::vector< Record > records; //records[0] is the whole frame
+	};
+
+	//frames waiting for query results; if more than this many pile up (e.g., nothing ever swaps),
+	// the oldest is waited for rather than letting the queue grow without bound:
+	constexpr uint32_t MaxPending = 4;
+
+	struct State {
+		Profiler::History history;
+		std::deque< PendingFrame > pending;
+
+		bool in_frame = false;
+		PendingFrame current;
+		uint32_t depth = 0; //number of open scopes (including the frame)
+		uint64_t next_number = 0;
+
+		std::vector< GLuint > free_queries;
+
+		State() {
+			history.names.emplace_back("frame");
+			history.depths.emplace_back(0);
+			history.frames.reserve(Profiler::History::Frames);
+		}
+
+		GLuint get_query() {
+			if (free_queries.empty()) {
+				free_queries.resize(16);
+				glGenQueries(GLsizei(free_queries.size()), free_queries.data());
+			}
+			GLuint query = free_queries.back();
+			free_queries.pop_back();
+			return query;
+		}
+
+		uint32_t open(char const *name) {
+			//find (or add) the name -- a short linear search, since there are only a few scopes:
+			uint32_t n = 0;
+			while (n < history.names.size() && history.names[n] != name) ++n;
+			if (n == history.names.size()) {
+				history.names.emplace_back(name);
+				history.depths.emplace_back(depth);
+			}
+
+			current.records.emplace_back();
+			Record &record = current.records.back();
+			record.name = n;
+			record.begin_query = get_query();
+			glQueryCounter(record.begin_query, GL_TIMESTAMP);
+			record.cpu_begin = std::chrono::high_resolution_clock::now();
+			depth += 1;
+			return uint32_t(current.records.size() - 1);
+		}
+
+		void close(uint32_t index) {
+			assert(index < current.records.size());
+			assert(depth > 0);
+			Record &record = current.records[index];
+			record.cpu_end = std::chrono::high_resolution_clock::now();
+			record.end_query = get_query();
+			glQueryCounter(record.end_query, GL_TIMESTAMP);
+			depth -= 1;
+		}
+
+		//move frames whose queries have finished into the history:
+		void collect() {
+			while (!pending.empty()) {
+				PendingFrame &frame = pending.front();
+
+				//the frame's end timestamp comes after all of its other queries:
+				if (pending.size() <= MaxPending) {
+					GLint available = GL_FALSE;
+					glGetQueryObjectiv(frame.records[0].end_query, GL_QUERY_RESULT_AVAILABLE, &available);
+					if (!available) break;
+				}
+
+				Profiler::Frame done;
+				done.number = frame.number;
+				done.cpu_ms.assign(history.names.size(), -1.0f);
+				done.gpu_ms.assign(history.names.size(), -1.0f);
+				for (Record const &record : frame.records) {
+					GLuint64 begin = 0, end = 0;
+					glGetQueryObjectui64v(record.begin_query, GL_QUERY_RESULT, &begin);
+					glGetQueryObjectui64v(record.end_query, GL_QUERY_RESULT, &end);
+					free_queries.emplace_back(record.begin_query);
+					free_queries.emplace_back(record.end_query);
+
+					float cpu = std::chrono::duration< float, std::milli >(record.cpu_end - record.cpu_begin).count();
+					float gpu = float(end - begin) / 1.0e6f;
+					float &cpu_total = done.cpu_ms[record.name];
+					float &gpu_total = done.gpu_ms[record.name];
+					cpu_total = std::max(cpu_total, 0.0f) + cpu;
+					gpu_total = std::max(gpu_total, 0.0f) + gpu;
+				}
+				pending.pop_front();
+
+				if (history.frames.size() == Profiler::History::Frames) {
+					history.frames.erase(history.frames.begin());
+				}
+				history.frames.emplace_back(std::move(done));
+			}
+		}
+	};
+
+	State &state() {
+		static State state;
+		return state;
+	}
+}
+
+Profiler::Scope::Scope(char const *name) : index(-1U) {
+	State &s = state();
+	if (!s.in_frame) return;
+	index = s.open(name);
+}
+
+Profiler::Scope::~Scope() {
+	if (index == -1U) return;
+	State &s = state();
+	//(if end_frame was called while this scope was open, the scope's record was already closed)
+	if (!s.in_frame) return;
+	s.close(index);
+}
+
+void Profiler::begin_frame() {
+	State &s = state();
+	assert(!s.in_frame && "begin_frame called twice without end_frame");
+
+	s.in_frame = true;
+	s.current.number = s.next_number++;
+	s.current.records.clear();
+	s.depth = 0;
+	uint32_t index = s.open("frame");
+	assert(index == 0);
+	(void)index;
+}
+
+void Profiler::end_frame() {
+	State &s = state();
+	if (!s.in_frame) return;
+
+	//close the frame, and any scopes left open:
+	for (uint32_t r = uint32_t(s.current.records.size()); r > 0; --r) {
+		if (s.current.records[r-1].end_query == 0) s.close(r-1);
+	}
+	s.in_frame = false;
+
+	s.pending.emplace_back(std::move(s.current));
+	s.current = PendingFrame();
+	s.collect();
+}
+
+Profiler::History const &Profiler::get_history() {
+	return state().history;
+}
+
+void Profiler::save_csv(std::string const &filename) {
+	History const &history = get_history();
+
+	std::ofstream csv(filename);
+	csv << "frame";
+	for (auto const &name : history.names) {
+		csv << "," << name << "_cpu_ms," << name << "_gpu_ms";
+	}
+	csv << "\n";
+	for (auto const &frame : history.frames) {
+		csv << frame.number;
+		for (uint32_t n = 0; n < history.names.size(); ++n) {
+			//(empty cells for scopes that didn't run, or hadn't been seen yet, during this frame)
+			csv << ",";
+			if (n < frame.cpu_ms.size() && frame.cpu_ms[n] >= 0.0f) csv << frame.cpu_ms[n];
+			csv << ",";
+			if (n < frame.gpu_ms.size() && frame.gpu_ms[n] >= 0.0f) csv << frame.gpu_ms[n];
+		}
+		csv << "\n";
+	}
+	if (!csv) {
+		throw std::runtime_error("Failed to write frame profile to '" + filename + "'.");
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Frame profiler: times named scopes on the CPU (std::chrono) and on the GPU (GL timer queries).
+//
+//Usage:
+//  Profiler::begin_frame(); //start of the main loop
+//  { Profiler::Scope scope("scene"); scene.draw(camera); } //any number of (possibly nested) scopes
+//  Profiler::end_frame(); //end of the main loop
+//
+//GPU times come from GL_TIMESTAMP queries issued at the start and end of each scope.
+// (timestamps rather than GL_TIME_ELAPSED, because elapsed-time queries can't nest)
+//Query results are read back a few frames later, once they are available, so timing never stalls
+// the pipeline; the most recent frames therefore aren't in the history yet.
+//
+//Profiler functions must be called from the thread that owns the GL context.
+
+namespace Profiler {
+
+//times a scope (from construction to destruction); 'name' should be a string literal:
+// scopes outside of begin_frame() / end_frame() are ignored.
+struct Scope {
+	Scope(char const *name);
+	~Scope();
+	Scope(Scope const &) = delete;
+	Scope &operator=(Scope const &) = delete;
+	uint32_t index; //(of the scope's record within the current frame, or -1U if ignored)
+};
+
+void begin_frame();
+void end_frame();
+
+//timings of one finished frame:
+struct Frame {
+	uint64_t number = 0;
+	//per-scope times, in milliseconds, indexed like 'names' (negative if the scope didn't run that frame);
+	// a scope that runs several times in a frame gets the total.
+	// index 0 is the whole frame (begin_frame to end_frame).
+	std::vector< float > cpu_ms;
+	std::vector< float > gpu_ms;
+};
+
+struct History {
+	//scope names, in the order they were first seen (names[0] is "frame"):
+	std::vector< std::string > names;
+	//nesting depth of each scope when it was first seen (for indenting; 0 for "frame"):
+	std::vector< uint32_t > depths;
+
+	//the most recent finished frames, oldest first:
+	static constexpr uint32_t Frames = 240;
+	std::vector< Frame > frames;
+};
+History const &get_history();
+
+//write the history as CSV: one row per frame, with "<scope>_cpu_ms" and "<scope>_gpu_ms" columns per scope.
+// (throws on failure)
+void save_csv(std::string const &filename);
+
+//whether the overlay (see draw_profiler.hpp) should be shown -- main.cpp toggles this with F1:
+extern bool show;
+
+}
@@ -0,0 +1,214 @@
+#include "Sound.hpp"
+#include "mix_kernels.hpp"
+#include "read_write_chunk.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cassert>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Bank file format (chunks as per read_write_chunk.hpp, in this order):
+// 'str0' -- sample names (chars), zero-padded so that the 'sbd0' data starts at a multiple of 16 bytes into the file
+// 'sbi0' -- index: one IndexEntry per sample
+// 'sbd0' -- encoded sample data (bytes); each sample's data starts at a multiple of 16 bytes into the chunk
+// (so, since mappings are page-aligned, samples are 16-byte aligned in memory)
+
+namespace {
+	struct IndexEntry {
+		uint32_t name_begin, name_end;
+		uint32_t encoding; //a Sound::Sample::Encoding
+		uint32_t length; //in samples
+		uint32_t data_begin, data_end; //in bytes, relative to the start of the 'sbd0' chunk's data
+	};
+	static_assert(sizeof(IndexEntry) == 24, "Index entry should be packed");
+
+	constexpr uint32_t const DataAlignment = 16;
+
+	//bytes of encoded data for 'length' samples:
+	size_t encoded_size(Sound::Sample::Encoding encoding, uint32_t length) {
+		if (encoding == Sound::Sample::Float32) return size_t(length) * sizeof(float);
+		if (encoding == Sound::Sample::Int16) return size_t(length) * sizeof(int16_t);
+		assert(encoding == Sound::Sample::ADPCM4);
+		return size_t((length + ADPCM4_BLOCK_SAMPLES - 1) / ADPCM4_BLOCK_SAMPLES) * ADPCM4_BLOCK_BYTES;
+	}
+
+	//drop a bank's samples and unmap its file:
+	void release(Sound::SampleBank* bank) {
+		bank->samples.clear();
+		if (bank->mapping == nullptr) return;
+#ifdef _WIN32
+		UnmapViewOfFile(bank->mapping);
+		CloseHandle(HANDLE(bank->mapping_handle));
+		CloseHandle(HANDLE(bank->file_handle));
+		bank->mapping_handle = bank->file_handle = nullptr;
+#else
+		munmap(const_cast< void* >(bank->mapping), bank->mapping_size);
+#endif
+		bank->mapping = nullptr;
+		bank->mapping_size = 0;
+	}
+}
+
+Sound::SampleBank::SampleBank(std::string const& filename) {
+	//map the whole file:
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open sample bank '" + filename + "'.");
+	}
+	LARGE_INTEGER size;
+	HANDLE map = nullptr;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0) {
+		map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	}
+	if (map != nullptr) {
+		mapping = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	}
+	if (mapping == nullptr) {
+		if (map != nullptr) CloseHandle(map);
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map sample bank '" + filename + "'.");
+	}
+	mapping_size = size_t(size.QuadPart);
+	file_handle = file;
+	mapping_handle = map;
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open sample bank '" + filename + "'.");
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+		close(fd);
+		throw std::runtime_error("Failed to map sample bank '" + filename + "'.");
+	}
+	void* map = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); //(the mapping keeps the file open)
+	if (map == MAP_FAILED) {
+		throw std::runtime_error("Failed to map sample bank '" + filename + "'.");
+	}
+	//sample data is read by the audio thread, so ask for it to be paged in now rather than on first play:
+	madvise(map, size_t(info.st_size), MADV_WILLNEED);
+	mapping = map;
+	mapping_size = size_t(info.st_size);
+#endif
+
+	try {
+		//walk the chunks in place (same layout as read_chunk, but without copying):
+		uint8_t const* at = static_cast< uint8_t const* >(mapping);
+		uint8_t const* end = at + mapping_size;
+		auto chunk = [&](char const* magic, size_t element_size, uint32_t* count) -> uint8_t const* {
+			char header_magic[4];
+			uint32_t size;
+			if (size_t(end - at) < 8) throw std::runtime_error("Failed to read chunk header");
+			std::memcpy(header_magic, at, 4);
+			std::memcpy(&size, at + 4, 4);
+			if (std::string(header_magic, 4) != magic) throw std::runtime_error("Unexpected magic number in chunk");
+			if (size % element_size != 0) throw std::runtime_error("Size of chunk not divisible by element size");
+			if (size_t(end - at) - 8 < size) throw std::runtime_error("Failed to read chunk data.");
+			uint8_t const* data = at + 8;
+			at = data + size;
+			*count = uint32_t(size / element_size);
+			return data;
+		};
+
+		uint32_t name_count, index_count, data_count;
+		char const* names = reinterpret_cast< char const* >(chunk("str0", 1, &name_count));
+		uint8_t const* index_data = chunk("sbi0", sizeof(IndexEntry), &index_count);
+		uint8_t const* data = chunk("sbd0", 1, &data_count);
+		if (reinterpret_cast< uintptr_t >(data) % 4 != 0) {
+			throw std::runtime_error("sample data is misaligned");
+		}
+
+		for (uint32_t i = 0; i < index_count; ++i) {
+			IndexEntry entry;
+			std::memcpy(&entry, index_data + i * sizeof(IndexEntry), sizeof(IndexEntry));
+			if (!(entry.name_begin <= entry.name_end && entry.name_end <= name_count)) {
+				throw std::runtime_error("index entry has out-of-range name begin/end");
+			}
+			if (entry.encoding > Sample::ADPCM4) {
+				throw std::runtime_error("index entry has unknown encoding");
+			}
+			Sample::Encoding encoding = Sample::Encoding(entry.encoding);
+			if (!(entry.data_begin <= entry.data_end && entry.data_end <= data_count
+				&& entry.data_begin % DataAlignment == 0
+				&& entry.data_end - entry.data_begin == encoded_size(encoding, entry.length))) {
+				throw std::runtime_error("index entry has out-of-range or mis-sized data begin/end");
+			}
+			std::string name(names + entry.name_begin, names + entry.name_end);
+			bool inserted = samples.emplace(name, Sample(encoding, entry.length, data + entry.data_begin)).second;
+			if (!inserted) {
+				std::cerr << "WARNING: sample name '" + name + "' in sample bank '" + filename + "' collides with an existing sample." << std::endl;
+			}
+		}
+
+		if (at != end) {
+			std::cerr << "WARNING: trailing data in sample bank '" << filename << "'" << std::endl;
+		}
+	} catch (std::exception const& e) {
+		release(this);
+		throw std::runtime_error("Failed to read sample bank '" + filename + "': " + e.what());
+	}
+}
+
+Sound::SampleBank::~SampleBank() {
+	release(this);
+}
+
+Sound::Sample const& Sound::SampleBank::lookup(std::string const& name) const {
+	auto f = samples.find(name);
+	if (f == samples.end()) {
+		throw std::runtime_error("Looking up sample '" + name + "' that doesn't exist.");
+	}
+	return f->second;
+}
+
+void Sound::SampleBank::write(std::string const& filename, std::vector< std::pair< std::string, Sample const* > > const& samples) {
+	std::vector< char > names;
+	std::vector< IndexEntry > index;
+	std::vector< uint8_t > data;
+	for (auto const& named : samples) {
+		Sample const& sample = *named.second;
+		if (sample.streamed()) {
+			throw std::runtime_error("Can't put streamed sample '" + named.first + "' in a sample bank.");
+		}
+		IndexEntry entry;
+		entry.name_begin = uint32_t(names.size());
+		names.insert(names.end(), named.first.begin(), named.first.end());
+		entry.name_end = uint32_t(names.size());
+		entry.encoding = sample.encoding;
+		entry.length = sample.length;
+
+		uint8_t const* bytes;
+		if (sample.encoding == Sample::Float32) bytes = reinterpret_cast< uint8_t const* >(sample.float_data());
+		else if (sample.encoding == Sample::Int16) bytes = reinterpret_cast< uint8_t const* >(sample.int16_data());
+		else bytes = sample.adpcm4_data();
+		data.resize((data.size() + DataAlignment - 1) / DataAlignment * DataAlignment, 0);
+		entry.data_begin = uint32_t(data.size());
+		data.insert(data.end(), bytes, bytes + encoded_size(sample.encoding, sample.length));
+		entry.data_end = uint32_t(data.size());
+		index.emplace_back(entry);
+	}
+	//three chunk headers plus the names and index come before the data:
+	size_t before_data = 3 * 8 + names.size() + index.size() * sizeof(IndexEntry);
+	names.resize(names.size() + (DataAlignment - before_data % DataAlignment) % DataAlignment, '\0');
+
+	std::ofstream file(filename, std::ios::binary);
+	write_chunk("str0", names, &file);
+	write_chunk("sbi0", index, &file);
+	write_chunk("sbd0", data, &file);
+	if (!file) {
+		throw std::runtime_error("Failed to write sample bank '" + filename + "'.");
+	}
+}
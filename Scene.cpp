@@ -1,6 +1,7 @@
 #include "Scene.hpp"
 
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
 #include "read_write_chunk.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
@@ -103,10 +104,10 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 
 
 		//Set shader program:
-		glUseProgram(pipeline.program);
+		gl_use_program(pipeline.program);
 
 		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+		gl_bind_vertex_array(pipeline.vao);
 
 		//Configure program uniforms:
 
@@ -138,30 +139,18 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 		if (pipeline.set_uniforms) pipeline.set_uniforms();
 
 		//set up textures:
+		// (program, vertex array, and textures are left bound -- gl_state.hpp skips re-binding them for the next drawable)
 		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
 			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
+				gl_bind_texture(i, pipeline.textures[i].target, pipeline.textures[i].texture);
 			}
 		}
 
 		//draw the object:
 		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
 
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
-			}
-		}
-		glActiveTexture(GL_TEXTURE0);
-
 	}
 
-	glUseProgram(0);
-	glBindVertexArray(0);
-
 	GL_ERRORS();
 }
 
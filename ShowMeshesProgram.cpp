@@ -2,24 +2,16 @@
 
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
+#include "gl_debug.hpp"
 
 Scene::Drawable::Pipeline show_meshes_program_pipeline;
 
-Load< ShowMeshesProgram > show_meshes_program(LoadTagEarly, []() -> ShowMeshesProgram * {
-	auto *ret = new ShowMeshesProgram();
-
-	show_meshes_program_pipeline.program = ret->program;
-
-	show_meshes_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
-	show_meshes_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
-	show_meshes_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
-
-	return ret;
-});
-
-ShowMeshesProgram::ShowMeshesProgram() {
-	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
-	program = gl_compile_program(
+//submitted before any program is looked up, so the driver can compile all programs at once:
+static GLuint submitted_program = 0;
+static Load< void > submit_program(LoadTagShaders, [](){
+	//Compile vertex and fragment shaders using the convenient 'gl_submit_program' helper function:
+	submitted_program = gl_submit_program(
 		//vertex shader:
 		"#version 330\n"
 		"uniform mat4 OBJECT_TO_CLIP;\n"
@@ -72,6 +64,25 @@ ShowMeshesProgram::ShowMeshesProgram() {
 		"	}\n"
 		"}\n"
 	);
+});
+
+Load< ShowMeshesProgram > show_meshes_program(LoadTagEarly, []() -> ShowMeshesProgram * {
+	auto *ret = new ShowMeshesProgram();
+
+	show_meshes_program_pipeline.program = ret->program;
+
+	show_meshes_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
+	show_meshes_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
+	show_meshes_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+
+	return ret;
+});
+
+ShowMeshesProgram::ShowMeshesProgram() {
+	//wait for all submitted programs to compile and link (throws on errors):
+	gl_finish_programs();
+	program = submitted_program;
+	gl_label(GL_PROGRAM, program, "ShowMeshesProgram");
 
 	//look up the locations of vertex attributes:
 	Position_vec4 = glGetAttribLocation(program, "Position");
@@ -88,7 +99,7 @@ ShowMeshesProgram::ShowMeshesProgram() {
 }
 
 ShowMeshesProgram::~ShowMeshesProgram() {
-	glDeleteProgram(program);
+	gl_delete_program(program);
 	program = 0;
 }
 
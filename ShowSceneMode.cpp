@@ -1,5 +1,6 @@
 #include "ShowSceneMode.hpp"
 #include "DrawLines.hpp"
+#include "gl_state.hpp"
 
 #include <iostream>
 
@@ -87,9 +88,9 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 	//--- actual drawing ---
 	glClearColor(0.5f, 0.5f, 0.5f, 0.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
-	glDepthFunc(GL_LEQUAL);
+	gl_enable(GL_BLEND, false);
+	gl_enable(GL_DEPTH_TEST, true);
+	gl_depth_func(GL_LEQUAL);
 
 	scene.draw(*scene_camera);
 
@@ -113,12 +114,12 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 
 			//axis:
 			float len = 0.2f;
-			draw_lines.draw(xf(glm::vec3(0.0f)), xf(glm::vec3(len, 0.0f, 0.0f)), glm::u8vec4(0xff, 0x00, 0x00, 0xff));
-			draw_lines.draw(xf(glm::vec3(0.0f)), xf(glm::vec3(-len, 0.0f, 0.0f)), glm::u8vec4(0x88, 0x00, 0x00, 0xff));
-			draw_lines.draw(xf(glm::vec3(0.0f)), xf(glm::vec3(0.0f, len, 0.0f)), glm::u8vec4(0x00, 0xff, 0x00, 0xff));
-			draw_lines.draw(xf(glm::vec3(0.0f)), xf(glm::vec3(0.0f, -len, 0.0f)), glm::u8vec4(0x00, 0x88, 0x00, 0xff));
-			draw_lines.draw(xf(glm::vec3(0.0f)), xf(glm::vec3(0.0f, 0.0f, len)), glm::u8vec4(0x00, 0x00, 0xff, 0xff));
-			draw_lines.draw(xf(glm::vec3(0.0f)), xf(glm::vec3(0.0f, 0.0f, -len)), glm::u8vec4(0x00, 0x00, 0x88, 0xff));
+			draw_lines.draw_axes(glm::mat4x3(
+				len * xfd(glm::vec3(1.0f, 0.0f, 0.0f)),
+				len * xfd(glm::vec3(0.0f, 1.0f, 0.0f)),
+				len * xfd(glm::vec3(0.0f, 0.0f, 1.0f)),
+				xf(glm::vec3(0.0f))
+			));
 
 			//transform name:
 			draw_lines.draw_text("'" + transform.name + "'",
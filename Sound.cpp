@@ -1,9 +1,19 @@
 #include "Sound.hpp"
 #include "load_wav.hpp"
+#include "mix_kernels.hpp"
+#include "Convolver.hpp"
+#include "read_write_chunk.hpp"
 
 #include <SDL.h>
 
-#include <list>
+#include <array>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
 #include <cassert>
 #include <exception>
 #include <iostream>
@@ -14,13 +24,265 @@ namespace {
 
 	//handy constants:
 	constexpr uint32_t const AUDIO_RATE = 48000; //sampling rate
-	constexpr uint32_t const MIX_SAMPLES = 1024; //number of samples to mix per call of mix_audio callback; n.b. SDL requires this to be a power of two
+	constexpr uint32_t const MAX_MIX_SAMPLES = 1024; //largest block size (mixing buffers are allocated for this many samples)
+	//number of samples to mix per call of mix_audio callback (set by Sound::init; n.b. SDL requires this to be a power of two):
+	uint32_t mix_samples = MAX_MIX_SAMPLES;
+	float ramp_step = float(MAX_MIX_SAMPLES) / float(AUDIO_RATE); //seconds per block; parameter ramps advance this much per mix_audio call
+
+	//streaming constants:
+	constexpr uint32_t const STREAM_PREROLL = AUDIO_RATE / 2; //samples decoded up front for streamed samples (covers stream start-up and loop wrap-around)
+	constexpr uint32_t const STREAM_RING_SIZE = 65536; //lookahead buffer per stream (~1.4 seconds); n.b. must be a power of two
+	constexpr uint32_t const STREAM_CHUNK = 4096; //samples read from disk at a time
+	constexpr uint32_t const MAX_STREAMS = 4; //number of streamed samples that may play at once
 
 	//The audio device:
 	SDL_AudioDeviceID device = 0;
 
-	//list of all currently playing samples:
-	std::list< std::shared_ptr< Sound::PlayingSample > > playing_samples;
+	//Offline mode state (see Sound::init_offline):
+	bool offline = false;
+	std::array< StereoFrame, MAX_MIX_SAMPLES > offline_block; //last block mixed by Sound::render()...
+	uint32_t offline_block_used = MAX_MIX_SAMPLES; //...and how much of it has been handed out
+	uint64_t offline_frames = 0;
+
+	//Scratch space used while mixing voices (one per mixing thread):
+	struct MixScratch {
+		//compressed samples are decoded here, one run at a time:
+		std::array< float, MAX_MIX_SAMPLES > decode;
+		//resampled voices gather source samples here, then resample them into 'resampled' before mixing:
+		// (room for history, a block at the maximum rate, and some zero padding)
+		std::array< float, RESAMPLE_TAPS + uint32_t(MAX_MIX_SAMPLES * RESAMPLE_MAX_RATE) + 1 + RESAMPLE_TAPS > source;
+		std::array< float, MAX_MIX_SAMPLES > resampled;
+	};
+	MixScratch audio_scratch; //(audio thread only)
+
+	//Voice holds the mixer's state for one playing sample:
+	// (only touched by the audio thread once playback has started, or by whoever holds the audio device lock)
+	struct Voice {
+		Sound::Sample const* sample = nullptr; //sample being played
+		uint32_t stream = -1U; //index into 'streams' if sample is streamed
+		uint32_t i = 0; //next data value to read
+		bool loop = false; //should playback loop after data runs out?
+		bool stopping = false; //is playing stopping?
+
+		Sound::Ramp< float > volume = Sound::Ramp< float >(1.0f);
+
+		//2D playback panning control: ('NaN' if sound played in 3D mode)
+		Sound::Ramp< float > pan = Sound::Ramp< float >(std::numeric_limits< float >::quiet_NaN());
+
+		//3D playback panning control: ('NaN' if sound played in 2D mode)
+		Sound::Ramp< glm::vec3 > position = Sound::Ramp< glm::vec3 >(std::numeric_limits< float >::quiet_NaN());
+		Sound::Ramp< float > half_volume_radius = Sound::Ramp< float >(std::numeric_limits< float >::quiet_NaN());
+
+		//playback rate (source samples per output frame):
+		Sound::Ramp< float > rate = Sound::Ramp< float >(1.0f);
+		Sound::Interpolation interpolation = Sound::Polyphase;
+
+		//resampler state -- voices switch to resampling the first time their rate isn't 1:
+		// source samples are read ahead of the play position, so 'i' is RESAMPLE_TAPS / 2 + 1 samples ahead of what is heard.
+		bool resampling = false;
+		double phase = 0.0; //fractional part of the play position
+		uint32_t tail = 0; //silent samples read past the end of a non-looping sample
+		std::array< float, RESAMPLE_TAPS > history; //the last RESAMPLE_TAPS source samples read
+
+		//higher priority voices win when there are more audible voices than the real voice budget:
+		int32_t priority = 0;
+
+		//virtualization: voices that aren't mixed ("virtual") still advance their playback position:
+		enum Mix : uint8_t {
+			MixNew, //hasn't been through mix_audio yet
+			MixReal, //was mixed last block
+			MixVirtual, //was skipped last block
+		} mix = MixNew;
+
+		//scratch values computed at the start of each mix_audio call:
+		StereoFrame start_pan;
+		StereoFrame end_pan;
+		BFormatFrame start_bformat; //(only used if 'ambisonic')
+		BFormatFrame end_bformat;
+		bool ambisonic = false; //mixed into the ambisonic bus this block?
+		float start_rate = 1.0f;
+		float end_rate = 1.0f;
+		float loudness = 0.0f; //max of start/end gains
+		bool real = false; //chosen to be mixed this block?
+		bool mixing = false; //actually mixed this block? (real, or fading out after losing its slot)
+
+		//bumped by the audio thread when the voice finishes, invalidating outstanding PlayingSample handles:
+		std::atomic< uint32_t > generation{0};
+	};
+
+	//Fixed-size pool of voices, allocated in Sound::init():
+	std::vector< Voice > voices;
+
+	//Voices not currently in use:
+	// (game thread only; reserved to voices.size(), so never reallocates)
+	std::vector< uint32_t > free_voices;
+
+	//Voices currently being mixed, in the order they were started:
+	// (audio thread only; sized to voices.size(), so never reallocates)
+	std::vector< uint32_t > active_voices;
+	uint32_t active_voice_count = 0;
+
+	//Scratch list used when choosing which voices to mix:
+	// (audio thread only; sized to voices.size(), so never reallocates)
+	std::vector< uint32_t > audible_voices;
+
+	//Maximum number of voices actually mixed per block; the rest are virtualized:
+	uint32_t max_real_voices = 64;
+
+	//Voices quieter than this (at both ends of a block) are virtualized regardless of the budget:
+	constexpr float const INAUDIBLE_GAIN = 1.0e-4f; //about -80dB
+
+	//First-order ambisonic bus that 3D voices are mixed into (when enabled) before a single decode to stereo:
+	bool ambisonics = false; //(audio thread only)
+	std::array< BFormatFrame, MAX_MIX_SAMPLES > ambisonic_bus;
+
+	//Binaural decode of the ambisonic bus (see Sound::set_hrtf):
+	// the bus is rotated into the listener's frame, then each channel is convolved with a stereo filter that
+	// sums the HRTF's responses as if each were a virtual speaker fed by a (max-rE) decode of that channel.
+	static_assert(MAX_MIX_SAMPLES % Convolver::Partition == 0, "blocks are whole convolution pieces");
+	struct Binaural {
+		std::array< std::unique_ptr< Convolver >, 4 > channels; //W, X (listener right), Y (forward), Z (up)
+		std::array< std::array< float, MAX_MIX_SAMPLES >, 4 > inputs; //(audio thread scratch)
+		//per-channel cost (see Sound::MixStats::convolutions):
+		std::array< std::atomic< uint64_t >, 4 > total_time; //nanoseconds
+		std::array< std::atomic< uint32_t >, 4 > max_time; //nanoseconds
+		std::atomic< uint64_t > blocks;
+	};
+	std::vector< std::unique_ptr< Binaural > > binaurals; //every HRTF loaded since init (game thread only; freed at shutdown)
+	Binaural* binaural = nullptr; //HRTF used to decode the bus (audio thread only)
+	std::atomic< Binaural* > binaural_stats(nullptr); //...the same, for Sound::get_mix_stats
+
+	//Voices being mixed this block; split into groups that are mixed in parallel:
+	// (audio thread only; sized to voices.size(), so never reallocates)
+	std::vector< uint32_t > mixing_voices;
+
+	//Mix workers each mix one group of voices into their own buffer while the audio thread mixes another:
+	// (the audio thread hands out groups and waits for them within each mix_audio call)
+	constexpr uint32_t const MAX_MIX_WORKERS = 7;
+	constexpr uint32_t const MIN_GROUP_VOICES = 16; //smaller groups aren't worth waking a worker for
+	struct MixWorker {
+		std::thread thread;
+		SDL_sem* start = nullptr; //posted by the audio thread when there is a group to mix (or it's time to quit)
+		std::atomic< bool > done{true}; //set by the worker when its group is mixed
+		bool quit = false;
+		uint32_t first = 0; //group is mixing_voices[first, first + count)
+		uint32_t count = 0;
+		std::array< StereoFrame, MAX_MIX_SAMPLES > buffer; //group's sub-mix
+		std::array< BFormatFrame, MAX_MIX_SAMPLES > bus; //group's ambisonic sub-mix (if ambisonics are enabled)
+		MixScratch scratch;
+	};
+	std::vector< std::unique_ptr< MixWorker > > mix_workers;
+
+	//Timing statistics (see Sound::get_mix_stats):
+	// (written by the audio thread; read -- or reset -- by anyone, so values are only loosely consistent with each other)
+	struct {
+		std::array< std::atomic< uint32_t >, Sound::MixStats::TimingBins > timing_histogram;
+		std::atomic< uint64_t > callbacks;
+		std::atomic< uint64_t > total_time; //nanoseconds
+		std::atomic< uint32_t > max_time; //nanoseconds
+		std::atomic< uint64_t > total_voices;
+		std::atomic< uint32_t > peak_voices;
+		std::atomic< uint32_t > underruns;
+		std::atomic< uint32_t > max_gap; //microseconds
+		std::atomic< uint32_t > plays;
+		std::atomic< uint64_t > total_play_latency; //microseconds
+		std::atomic< uint32_t > max_play_latency; //microseconds
+		std::atomic< uint32_t > output_latency; //microseconds
+	} mix_stats; //n.b. zero-initialized, since it has static storage duration
+	std::chrono::steady_clock::time_point last_callback; //start of the previous mix_audio call (audio thread only)
+	bool have_last_callback = false;
+
+	//Voice counts from the most recent mix_audio call (written by the audio thread):
+	std::atomic< uint32_t > real_voice_count(0);
+	std::atomic< uint32_t > virtual_voice_count(0);
+
+	//Voices finished by the mixer, waiting for the game thread to move them back to free_voices:
+	// (single-producer [audio thread] / single-consumer [game thread] ring; can't overflow since every voice is in it at most once)
+	std::vector< uint32_t > finished_voices; //n.b. size is a power of two >= voices.size()
+	std::atomic< uint32_t > finished_write(0);
+	std::atomic< uint32_t > finished_read(0);
+
+	//A Stream feeds the part of a streamed sample past STREAM_PREROLL to a voice:
+	// the stream thread reads the sample from disk (wrapping back to STREAM_PREROLL if looping)
+	// into 'ring', and the audio thread consumes it in the same order.
+	struct Stream {
+		//lifecycle: Free -(game thread)-> Starting -(stream thread)-> Streaming -(audio thread)-> Finished -(stream thread)-> Free
+		enum State : uint8_t {
+			Free,
+			Starting,
+			Streaming,
+			Finished,
+		};
+		std::atomic< uint8_t > state{Free};
+
+		//set by the game thread before the stream starts:
+		Sound::Sample const* sample = nullptr;
+		bool loop = false;
+
+		//single-producer [stream thread] / single-consumer [audio thread] ring of samples:
+		std::vector< float > ring; //n.b. size is STREAM_RING_SIZE, allocated in Sound::init()
+		std::atomic< uint64_t > written{0};
+		std::atomic< uint64_t > consumed{0};
+
+		//set by the stream thread if the file can't be opened or read; nothing more will be written to 'ring',
+		// so the voice finishes once it has played what's there:
+		std::atomic< bool > failed{false};
+
+		//stream thread only:
+		std::ifstream file;
+		uint32_t file_position = 0; //next sample to read from file
+		bool end_of_data = false;
+		std::vector< uint8_t > raw; //read buffer
+	};
+	std::array< Stream, MAX_STREAMS > streams;
+
+	//The stream thread keeps the streams' rings full:
+	std::thread stream_thread;
+	std::mutex stream_mutex;
+	std::condition_variable stream_cv; //notified when a stream starts or the thread should quit
+	bool stream_thread_quit = false; //protected by stream_mutex
+
+	//Commands queued by the game thread for mix_audio to apply at the start of its next block:
+	struct Command {
+		enum Type : uint8_t {
+			Play, //start mixing 'voice'
+			SetVolume, //set 'voice' volume to 'value'
+			SetPan, //set 'voice' pan to 'value'
+			SetPosition, //set 'voice' position to 'vec_a'
+			SetHalfVolumeRadius, //set 'voice' half volume radius to 'value'
+			SetPriority, //set 'voice' priority to 'priority'
+			SetRate, //set 'voice' playback rate to 'value'
+			SetInterpolation, //set 'voice' interpolation to 'interpolation'
+			Stop, //fade out 'voice'
+			StopAll, //fade out every playing voice
+			SetGlobalVolume, //set Sound::volume to 'value'
+			SetListener, //set Sound::listener position to 'vec_a', right to 'vec_b'
+			SetMaxRealVoices, //set max_real_voices to 'count'
+			SetAmbisonics, //enable the ambisonic bus if 'count' is nonzero
+			SetHRTF, //decode the ambisonic bus with 'binaural' (or in stereo if null)
+		} type = Play;
+		uint32_t voice = -1U; //target voice for per-voice commands...
+		uint32_t generation = 0; //...ignored unless the voice still has this generation
+		glm::vec3 vec_a = glm::vec3(0.0f);
+		glm::vec3 vec_b = glm::vec3(0.0f);
+		float value = 0.0f;
+		float ramp = 0.0f;
+		int32_t priority = 0;
+		uint32_t count = 0;
+		Sound::Interpolation interpolation = Sound::Polyphase;
+		Binaural* binaural = nullptr;
+		//when a Play command was issued (for latency stats; frames are used in offline mode):
+		std::chrono::steady_clock::time_point issued;
+		uint64_t issued_frame = 0;
+	};
+
+	//single-producer / single-consumer ring of commands:
+	// - game thread writes slots and advances command_write
+	// - audio thread applies slots and advances command_read
+	constexpr uint32_t const COMMAND_QUEUE_SIZE = 4096; //n.b. must be a power of two
+	std::array< Command, COMMAND_QUEUE_SIZE > command_queue;
+	std::atomic< uint32_t > command_write(0);
+	std::atomic< uint32_t > command_read(0);
 
 }
 
@@ -35,23 +297,132 @@ Sound::Listener Sound::listener;
 //This audio-mixing callback is defined below:
 void mix_audio(void*, Uint8* buffer_, int len);
 
+//Command queue helpers are defined below:
+static void push_command(Command const& command);
+static void drain_commands(std::chrono::steady_clock::time_point now);
+
+//Stream helpers are defined below:
+static void service_stream(Stream& stream);
+static void stream_thread_main();
+
+//Mix worker helpers are defined below:
+static void start_mix_workers(uint32_t count);
+static void stop_mix_workers();
+
 //------------------------ public-facing --------------------------------
 
-Sound::Sample::Sample(std::string const& filename) {
-	if (filename.size() >= 4 && filename.substr(filename.size() - 4) == ".wav") {
-		load_wav(filename, &data);
+//helper: re-encode a sample's (float) data in a more compact format:
+static void encode_sample(Sound::Sample* sample_, Sound::Sample::Encoding encoding) {
+	assert(sample_);
+	auto& sample = *sample_;
+	sample.resident = uint32_t(sample.data.size());
+	sample.encoding = encoding;
+	if (encoding == Sound::Sample::Int16) {
+		encode_int16(sample.data.data(), sample.resident, &sample.data_int16);
+	}
+	else if (encoding == Sound::Sample::ADPCM4) {
+		encode_adpcm4(sample.data.data(), sample.resident, &sample.data_adpcm4);
 	}
 	else {
+		assert(encoding == Sound::Sample::Float32);
+		return;
+	}
+	std::vector< float >().swap(sample.data); //release float data
+}
+
+Sound::Sample::Sample(std::string const& filename, Storage storage, Encoding encoding_) {
+	if (!(filename.size() >= 4 && filename.substr(filename.size() - 4) == ".wav")) {
 		throw std::runtime_error("Sample '" + filename + "' doesn't end in either \".wav\" -- unsure how to load.");
 	}
+
+	if (storage == Streamed) {
+		WavInfo info;
+		if (!load_wav_info(filename, &info) || info.rate != AUDIO_RATE) {
+			std::cout << "WAV file '" + filename + "' isn't " + std::to_string(AUDIO_RATE) + " Hz PCM; can't stream, so loading all of it." << std::endl;
+		}
+		else if (info.frames > STREAM_PREROLL) {
+			//decode the first part of the file; the rest will be streamed during playback:
+			std::ifstream file(filename, std::ios::binary);
+			std::vector< uint8_t > raw(size_t(STREAM_PREROLL) * info.bytes_per_frame());
+			file.seekg(std::streamoff(info.data_offset));
+			if (!file.read(reinterpret_cast< char* >(raw.data()), raw.size())) {
+				throw std::runtime_error("Failed to read start of WAV file '" + filename + "'.");
+			}
+			data.resize(STREAM_PREROLL);
+			convert_wav_frames(info, raw.data(), STREAM_PREROLL, data.data());
+
+			length = info.frames;
+			stream_filename = filename;
+			stream_info = info;
+			encode_sample(this, encoding_);
+			return;
+		}
+		//(short files just load normally)
+	}
+
+	load_wav(filename, &data);
+	length = uint32_t(data.size());
+	encode_sample(this, encoding_);
+}
+
+Sound::Sample::Sample(std::vector< float > const& data_, Encoding encoding_) : data(data_), length(uint32_t(data_.size())) {
+	encode_sample(this, encoding_);
 }
 
-Sound::Sample::Sample(std::vector< float > const& data_) : data(data_) {
+Sound::Sample::Sample(Encoding encoding_, uint32_t length_, void const* view_) : encoding(encoding_), view(view_), resident(length_), length(length_) {
 }
 
 
 
-void Sound::init() {
+//helper: allocate the voice pool and stream buffers, and set the block size:
+static void init_pool(uint32_t max_voices, uint32_t workers, uint32_t block_samples) {
+	if (block_samples != 128 && block_samples != 256 && block_samples != 512 && block_samples != 1024) {
+		throw std::runtime_error("Sound block size must be 128, 256, 512, or 1024 samples (not " + std::to_string(block_samples) + ").");
+	}
+	static_assert(MAX_MIX_SAMPLES == 1024, "block sizes above fit in mixing buffers");
+	mix_samples = block_samples;
+	ramp_step = float(mix_samples) / float(AUDIO_RATE);
+	Sound::reset_mix_stats();
+	have_last_callback = false;
+
+	//allocate the voice pool up front (even if audio fails to start, play* still needs somewhere to put voices):
+	voices = std::vector< Voice >(max_voices);
+	free_voices.clear();
+	free_voices.reserve(max_voices);
+	for (uint32_t v = max_voices; v > 0; --v) {
+		free_voices.emplace_back(v - 1);
+	}
+	active_voices.assign(max_voices, -1U);
+	active_voice_count = 0;
+	audible_voices.assign(max_voices, -1U);
+	mixing_voices.assign(max_voices, -1U);
+	uint32_t finished_size = 1;
+	while (finished_size < max_voices) finished_size *= 2;
+	finished_voices.assign(finished_size, -1U);
+	finished_write = 0;
+	finished_read = 0;
+
+	//allocate stream buffers:
+	for (auto& stream : streams) {
+		stream.state.store(Stream::Free, std::memory_order_relaxed);
+		if (stream.file.is_open()) stream.file.close();
+		stream.ring.assign(STREAM_RING_SIZE, 0.0f);
+		stream.raw.resize(size_t(STREAM_CHUNK) * 4 * 8); //room for up to 8 channels of 32-bit samples
+	}
+
+	start_mix_workers(workers);
+}
+
+void Sound::init(uint32_t max_voices, uint32_t workers, uint32_t block_samples) {
+	offline = false;
+	init_pool(max_voices, workers, block_samples);
+
+	//start the stream thread:
+	if (!stream_thread.joinable()) {
+		stream_thread_quit = false;
+		stream_thread = std::thread(stream_thread_main);
+	}
+
 	if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
 		std::cerr << "Failed to initialize SDL audio subsytem:\n" << SDL_GetError() << std::endl;
 		std::cerr << "  (Will continue without audio.)\n" << std::endl;
@@ -64,7 +435,7 @@ void Sound::init() {
 	want.freq = AUDIO_RATE;
 	want.format = AUDIO_F32SYS;
 	want.channels = 2;
-	want.samples = MIX_SAMPLES;
+	want.samples = mix_samples;
 	want.callback = mix_audio;
 
 	device = SDL_OpenAudioDevice(nullptr, 0, &want, &have, 0);
@@ -73,12 +444,53 @@ void Sound::init() {
 		std::cerr << "  (Will continue without audio.)\n" << std::endl;
 	}
 	else {
+		//a block mixed by the callback is heard once the device has played out the block before it:
+		// (an estimate -- SDL doesn't report buffering in the OS or driver)
+		mix_stats.output_latency.store(uint32_t(1000000ULL * have.samples / uint32_t(have.freq)), std::memory_order_relaxed);
+
 		//start audio playback:
 		SDL_PauseAudioDevice(device, 0);
 		std::cout << "Audio output initialized." << std::endl;
 	}
 }
 
+void Sound::init_offline(uint32_t max_voices, uint32_t workers, uint32_t block_samples) {
+	offline = true;
+	init_pool(max_voices, workers, block_samples);
+	mix_stats.output_latency.store(0, std::memory_order_relaxed);
+	offline_block_used = mix_samples;
+	offline_frames = 0;
+	//n.b. no stream thread; Sound::render() services streams itself.
+}
+
+void Sound::render(float* out, uint32_t frames) {
+	if (!offline) {
+		throw std::runtime_error("Sound::render() called without Sound::init_offline().");
+	}
+	while (frames > 0) {
+		if (offline_block_used == mix_samples) {
+			//fill stream rings (as the stream thread would) before every block, so streams never fall behind:
+			for (auto& stream : streams) {
+				service_stream(stream);
+			}
+			mix_audio(nullptr, reinterpret_cast< Uint8* >(offline_block.data()), int(mix_samples * sizeof(StereoFrame)));
+			offline_block_used = 0;
+		}
+		uint32_t count = std::min(frames, mix_samples - offline_block_used);
+		for (uint32_t f = 0; f < count; ++f) {
+			out[0] = offline_block[offline_block_used + f].l;
+			out[1] = offline_block[offline_block_used + f].r;
+			out += 2;
+		}
+		offline_block_used += count;
+		offline_frames += count;
+		frames -= count;
+	}
+}
+
+uint64_t Sound::get_rendered_frames() {
+	return offline_frames;
+}
 
 void Sound::shutdown() {
 	if (device != 0) {
@@ -87,6 +499,22 @@ void Sound::shutdown() {
 		SDL_CloseAudioDevice(device);
 		device = 0;
 	}
+
+	if (stream_thread.joinable()) {
+		//stop streaming:
+		{
+			std::unique_lock< std::mutex > lock(stream_mutex);
+			stream_thread_quit = true;
+		}
+		stream_cv.notify_one();
+		stream_thread.join();
+	}
+
+	stop_mix_workers();
+
+	binaural = nullptr;
+	binaural_stats.store(nullptr);
+	binaurals.clear();
 }
 
 
@@ -98,116 +526,521 @@ void Sound::unlock() {
 	if (device) SDL_UnlockAudioDevice(device);
 }
 
-std::shared_ptr< Sound::PlayingSample > Sound::play(Sample const& sample, float volume, float pan) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, volume, pan, false);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
-	return playing_sample;
+//helper: move voices the mixer has finished with back to the free list:
+static void reclaim_finished_voices() {
+	uint32_t read = finished_read.load(std::memory_order_relaxed);
+	uint32_t write = finished_write.load(std::memory_order_acquire);
+	while (read != write) {
+		free_voices.emplace_back(finished_voices[read & (finished_voices.size() - 1)]);
+		read += 1;
+	}
+	finished_read.store(read, std::memory_order_release);
 }
 
-std::shared_ptr< Sound::PlayingSample > Sound::play_3D(Sample const& sample, float volume, glm::vec3 const& position, float half_volume_radius) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, volume, position, half_volume_radius, false);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
+//helper: set up a free voice and tell the mixer to start it:
+static Sound::PlayingSample start_voice(Sound::Sample const& sample, float volume, float pan, glm::vec3 const& position, float half_volume_radius, bool loop) {
+	reclaim_finished_voices();
+	if (free_voices.empty()) {
+		//every voice is busy (or Sound::init() hasn't been called); drop the request:
+		return Sound::PlayingSample();
+	}
+	if (sample.length == 0) return Sound::PlayingSample(); //nothing to play
+
+	uint32_t stream_index = -1U;
+	if (sample.streamed()) {
+		for (uint32_t s = 0; s < MAX_STREAMS; ++s) {
+			if (streams[s].state.load(std::memory_order_acquire) == Stream::Free) {
+				stream_index = s;
+				break;
+			}
+		}
+		if (stream_index == -1U) {
+			//every stream is busy; drop the request:
+			return Sound::PlayingSample();
+		}
+
+		//n.b. neither the stream thread nor the mixer touch a Free stream, so it is safe to set up directly:
+		Stream& stream = streams[stream_index];
+		stream.sample = &sample;
+		stream.loop = loop;
+		stream.written.store(0, std::memory_order_relaxed);
+		stream.consumed.store(0, std::memory_order_relaxed);
+		stream.failed.store(false, std::memory_order_relaxed);
+		stream.state.store(Stream::Starting, std::memory_order_release);
+		stream_cv.notify_one();
+	}
+
+	uint32_t index = free_voices.back();
+	free_voices.pop_back();
+
+	//n.b. the mixer isn't touching this voice, so it is safe to set up directly:
+	Voice& voice = voices[index];
+	voice.sample = &sample;
+	voice.stream = stream_index;
+	voice.i = 0;
+	voice.loop = loop;
+	voice.stopping = false;
+	voice.volume.set(volume, 0.0f);
+	voice.pan.set(pan, 0.0f);
+	voice.position.set(position, 0.0f);
+	voice.half_volume_radius.set(half_volume_radius, 0.0f);
+	voice.rate.set(1.0f, 0.0f);
+	voice.interpolation = Sound::Polyphase;
+	voice.resampling = false;
+	voice.phase = 0.0;
+	voice.tail = 0;
+	voice.priority = 0;
+	voice.mix = Voice::MixNew;
+
+	Sound::PlayingSample playing_sample;
+	playing_sample.voice = index;
+	playing_sample.generation = voice.generation.load(std::memory_order_relaxed);
+
+	Command command;
+	command.type = Command::Play;
+	command.voice = playing_sample.voice;
+	command.generation = playing_sample.generation;
+	command.issued = std::chrono::steady_clock::now();
+	command.issued_frame = offline_frames;
+	push_command(command);
+
 	return playing_sample;
 }
 
-std::shared_ptr< Sound::PlayingSample > Sound::loop(Sample const& sample, float volume, float pan) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, volume, pan, true);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
-	return playing_sample;
+Sound::PlayingSample Sound::play(Sample const& sample, float volume, float pan) {
+	return start_voice(sample, volume, pan, glm::vec3(std::numeric_limits< float >::quiet_NaN()), std::numeric_limits< float >::quiet_NaN(), false);
 }
 
+Sound::PlayingSample Sound::play_3D(Sample const& sample, float volume, glm::vec3 const& position, float half_volume_radius) {
+	return start_voice(sample, volume, std::numeric_limits< float >::quiet_NaN(), position, half_volume_radius, false);
+}
 
+Sound::PlayingSample Sound::loop(Sample const& sample, float volume, float pan) {
+	return start_voice(sample, volume, pan, glm::vec3(std::numeric_limits< float >::quiet_NaN()), std::numeric_limits< float >::quiet_NaN(), true);
+}
 
-std::shared_ptr< Sound::PlayingSample > Sound::loop_3D(Sample const& sample, float volume, glm::vec3 const& position, float half_volume_radius) {
-	std::shared_ptr< Sound::PlayingSample > playing_sample = std::make_shared< Sound::PlayingSample >(sample, volume, position, half_volume_radius, true);
-	lock();
-	playing_samples.emplace_back(playing_sample);
-	unlock();
-	return playing_sample;
+Sound::PlayingSample Sound::loop_3D(Sample const& sample, float volume, glm::vec3 const& position, float half_volume_radius) {
+	return start_voice(sample, volume, std::numeric_limits< float >::quiet_NaN(), position, half_volume_radius, true);
 }
 
 
 void Sound::stop_all_samples() {
-	lock();
-	for (auto& s : playing_samples) {
-		s->stop();
-	}
-	unlock();
+	Command command;
+	command.type = Command::StopAll;
+	command.ramp = 1.0f / 60.0f;
+	push_command(command);
 }
 
 void Sound::set_volume(float new_volume, float ramp) {
-	lock();
-	volume.set(new_volume, ramp);
-	unlock();
+	Command command;
+	command.type = Command::SetGlobalVolume;
+	command.value = new_volume;
+	command.ramp = ramp;
+	push_command(command);
 }
 
 //------------------
 
-void Sound::PlayingSample::set_volume(float new_volume, float ramp) {
-	Sound::lock();
-	if (!stopping) {
-		volume.set(new_volume, ramp);
+//helper: queue a command that targets a single playing sample:
+// (the command carries the handle's generation, so the mixer ignores it if the voice has since been recycled)
+static void push_sample_command(Sound::PlayingSample const& playing_sample, Command::Type type, float value, glm::vec3 const& vec, float ramp) {
+	if (playing_sample.stopped()) return;
+	Command command;
+	command.type = type;
+	command.voice = playing_sample.voice;
+	command.generation = playing_sample.generation;
+	command.value = value;
+	command.vec_a = vec;
+	command.ramp = ramp;
+	push_command(command);
+}
+
+void Sound::PlayingSample::set_volume(float new_volume, float ramp) const {
+	push_sample_command(*this, Command::SetVolume, new_volume, glm::vec3(0.0f), ramp);
+}
+
+void Sound::PlayingSample::set_pan(float new_pan, float ramp) const {
+	push_sample_command(*this, Command::SetPan, new_pan, glm::vec3(0.0f), ramp);
+}
+
+void Sound::PlayingSample::set_position(glm::vec3 const& new_position, float ramp) const {
+	push_sample_command(*this, Command::SetPosition, 0.0f, new_position, ramp);
+}
+
+void Sound::PlayingSample::set_half_volume_radius(float new_radius, float ramp) const {
+	push_sample_command(*this, Command::SetHalfVolumeRadius, new_radius, glm::vec3(0.0f), ramp);
+}
+
+void Sound::PlayingSample::set_rate(float new_rate, float ramp) const {
+	push_sample_command(*this, Command::SetRate, new_rate, glm::vec3(0.0f), ramp);
+}
+
+void Sound::PlayingSample::set_interpolation(Interpolation interpolation) const {
+	if (stopped()) return;
+	Command command;
+	command.type = Command::SetInterpolation;
+	command.voice = voice;
+	command.generation = generation;
+	command.interpolation = interpolation;
+	push_command(command);
+}
+
+void Sound::PlayingSample::set_priority(int32_t new_priority) const {
+	if (stopped()) return;
+	Command command;
+	command.type = Command::SetPriority;
+	command.voice = voice;
+	command.generation = generation;
+	command.priority = new_priority;
+	push_command(command);
+}
+
+void Sound::PlayingSample::stop(float ramp) const {
+	push_sample_command(*this, Command::Stop, 0.0f, glm::vec3(0.0f), ramp);
+}
+
+bool Sound::PlayingSample::stopped() const {
+	if (voice >= voices.size()) return true;
+	return voices[voice].generation.load(std::memory_order_acquire) != generation;
+}
+
+//------------------
+
+void Sound::set_max_real_voices(uint32_t count) {
+	Command command;
+	command.type = Command::SetMaxRealVoices;
+	command.count = count;
+	push_command(command);
+}
+
+void Sound::set_ambisonics(bool enabled) {
+	Command command;
+	command.type = Command::SetAmbisonics;
+	command.count = (enabled ? 1 : 0);
+	push_command(command);
+}
+
+void Sound::set_hrtf(std::string const& filename) {
+	Command command;
+	command.type = Command::SetHRTF;
+	if (filename != "") {
+		//read virtual speaker directions (listener space: x right, y forward, z up) and their left/right responses:
+		std::ifstream file(filename, std::ios::binary);
+		if (!file) throw std::runtime_error("Failed to open HRTF '" + filename + "'.");
+		std::vector< glm::vec3 > directions;
+		std::vector< float > responses;
+		read_chunk(file, "hrd0", &directions);
+		read_chunk(file, "hri0", &responses);
+		if (directions.empty() || responses.empty() || responses.size() % (2 * directions.size()) != 0) {
+			throw std::runtime_error("HRTF '" + filename + "' has " + std::to_string(directions.size()) + " directions but " + std::to_string(responses.size()) + " response samples.");
+		}
+		size_t taps = responses.size() / (2 * directions.size());
+
+		//combine into one stereo filter per ambisonic channel:
+		// (speaker feed = (1 / S) * (sqrt(2) * w + sqrt(3) * dot(direction, xyz)) for S speakers)
+		std::array< std::vector< float >, 4 > left, right;
+		for (uint32_t c = 0; c < 4; ++c) {
+			left[c].assign(taps, 0.0f);
+			right[c].assign(taps, 0.0f);
+		}
+		float scale = 1.0f / float(directions.size());
+		for (size_t d = 0; d < directions.size(); ++d) {
+			glm::vec3 dir = (directions[d] == glm::vec3(0.0f) ? directions[d] : glm::normalize(directions[d]));
+			float weights[4] = {std::sqrt(2.0f) * scale, std::sqrt(3.0f) * scale * dir.x, std::sqrt(3.0f) * scale * dir.y, std::sqrt(3.0f) * scale * dir.z};
+			float const* response = &responses[d * 2 * taps];
+			for (uint32_t c = 0; c < 4; ++c) {
+				for (size_t t = 0; t < taps; ++t) {
+					left[c][t] += weights[c] * response[t];
+					right[c][t] += weights[c] * response[taps + t];
+				}
+			}
+		}
+
+		std::unique_ptr< Binaural > loaded(new Binaural);
+		for (uint32_t c = 0; c < 4; ++c) {
+			loaded->channels[c].reset(new Convolver(left[c], right[c]));
+			loaded->total_time[c].store(0);
+			loaded->max_time[c].store(0);
+		}
+		loaded->blocks.store(0);
+		command.binaural = loaded.get();
+		binaurals.emplace_back(std::move(loaded));
 	}
-	Sound::unlock();
+	push_command(command);
 }
 
-void Sound::PlayingSample::set_pan(float new_pan, float ramp) {
-	if (!(pan.value == pan.value)) return; //ignore if not in '2D' mode
-	Sound::lock();
-	pan.set(new_pan, ramp);
-	Sound::unlock();
+uint32_t Sound::get_real_voice_count() {
+	return real_voice_count.load(std::memory_order_relaxed);
 }
 
-void Sound::PlayingSample::set_position(glm::vec3 const& new_position, float ramp) {
-	if (pan.value == pan.value) return; //ignore if not in '3D' mode
-	Sound::lock();
-	position.set(new_position, ramp);
-	Sound::unlock();
+uint32_t Sound::get_virtual_voice_count() {
+	return virtual_voice_count.load(std::memory_order_relaxed);
 }
 
-void Sound::PlayingSample::set_half_volume_radius(float new_radius, float ramp) {
-	if (pan.value == pan.value) return; //ignore if not in '3D' mode
-	Sound::lock();
-	half_volume_radius.set(new_radius, ramp);
-	Sound::unlock();
+//------------------
+
+float Sound::MixStats::timing_bin_start(uint32_t bin) {
+	if (bin == 0) return 0.0f;
+	return std::pow(2.0f, 0.5f * float(bin));
 }
 
-void Sound::PlayingSample::stop(float ramp) {
-	Sound::lock();
-	if (!(stopping || stopped)) {
-		stopping = true;
-		volume.target = 0.0f;
-		volume.ramp = ramp;
+Sound::MixStats Sound::get_mix_stats() {
+	MixStats stats;
+	for (uint32_t b = 0; b < MixStats::TimingBins; ++b) {
+		stats.timing_histogram[b] = mix_stats.timing_histogram[b].load(std::memory_order_relaxed);
 	}
-	else {
-		volume.ramp = std::min(volume.ramp, ramp);
+	stats.callbacks = mix_stats.callbacks.load(std::memory_order_relaxed);
+	stats.budget = 1.0e6f * float(mix_samples) / float(AUDIO_RATE);
+	if (stats.callbacks) {
+		stats.average_time = 1.0e-3f * float(mix_stats.total_time.load(std::memory_order_relaxed)) / float(stats.callbacks);
+		stats.average_voices = float(mix_stats.total_voices.load(std::memory_order_relaxed)) / float(stats.callbacks);
+	}
+	stats.max_time = 1.0e-3f * float(mix_stats.max_time.load(std::memory_order_relaxed));
+	stats.peak_voices = mix_stats.peak_voices.load(std::memory_order_relaxed);
+	stats.underruns = mix_stats.underruns.load(std::memory_order_relaxed);
+	stats.max_gap = float(mix_stats.max_gap.load(std::memory_order_relaxed));
+	stats.plays = mix_stats.plays.load(std::memory_order_relaxed);
+	if (stats.plays) {
+		stats.average_play_latency = float(mix_stats.total_play_latency.load(std::memory_order_relaxed)) / float(stats.plays);
+	}
+	stats.max_play_latency = float(mix_stats.max_play_latency.load(std::memory_order_relaxed));
+	stats.output_latency = float(mix_stats.output_latency.load(std::memory_order_relaxed));
+	if (Binaural* active = binaural_stats.load(std::memory_order_acquire)) {
+		char const* names[4] = {"hrtf W", "hrtf X", "hrtf Y", "hrtf Z"};
+		uint64_t blocks = active->blocks.load(std::memory_order_relaxed);
+		for (uint32_t c = 0; c < 4; ++c) {
+			MixStats::Convolution convolution;
+			convolution.name = names[c];
+			convolution.partitions = active->channels[c]->partitions;
+			convolution.blocks = blocks;
+			if (blocks) convolution.average_time = 1.0e-3f * float(active->total_time[c].load(std::memory_order_relaxed)) / float(blocks);
+			convolution.max_time = 1.0e-3f * float(active->max_time[c].load(std::memory_order_relaxed));
+			stats.convolutions.emplace_back(convolution);
+		}
+	}
+	return stats;
+}
+
+void Sound::reset_mix_stats() {
+	for (auto& bin : mix_stats.timing_histogram) {
+		bin.store(0, std::memory_order_relaxed);
+	}
+	mix_stats.callbacks.store(0, std::memory_order_relaxed);
+	mix_stats.total_time.store(0, std::memory_order_relaxed);
+	mix_stats.max_time.store(0, std::memory_order_relaxed);
+	mix_stats.total_voices.store(0, std::memory_order_relaxed);
+	mix_stats.peak_voices.store(0, std::memory_order_relaxed);
+	mix_stats.underruns.store(0, std::memory_order_relaxed);
+	mix_stats.max_gap.store(0, std::memory_order_relaxed);
+	mix_stats.plays.store(0, std::memory_order_relaxed);
+	mix_stats.total_play_latency.store(0, std::memory_order_relaxed);
+	mix_stats.max_play_latency.store(0, std::memory_order_relaxed);
+	if (Binaural* active = binaural_stats.load(std::memory_order_acquire)) {
+		for (uint32_t c = 0; c < 4; ++c) {
+			active->total_time[c].store(0, std::memory_order_relaxed);
+			active->max_time[c].store(0, std::memory_order_relaxed);
+		}
+		active->blocks.store(0, std::memory_order_relaxed);
+	}
+}
+
+void Sound::save_mix_stats_csv(std::string const& filename, MixStats const& stats) {
+	std::ofstream csv(filename);
+	csv << "stat,value\n";
+	csv << "callbacks," << stats.callbacks << "\n";
+	csv << "budget_us," << stats.budget << "\n";
+	csv << "average_time_us," << stats.average_time << "\n";
+	csv << "max_time_us," << stats.max_time << "\n";
+	csv << "average_voices," << stats.average_voices << "\n";
+	csv << "peak_voices," << stats.peak_voices << "\n";
+	csv << "underruns," << stats.underruns << "\n";
+	csv << "max_gap_us," << stats.max_gap << "\n";
+	csv << "plays," << stats.plays << "\n";
+	csv << "average_play_latency_us," << stats.average_play_latency << "\n";
+	csv << "max_play_latency_us," << stats.max_play_latency << "\n";
+	csv << "output_latency_us," << stats.output_latency << "\n";
+	csv << "\n";
+	if (!stats.convolutions.empty()) {
+		csv << "convolution,partitions,blocks,average_time_us,max_time_us\n";
+		for (auto const& convolution : stats.convolutions) {
+			csv << convolution.name << "," << convolution.partitions << "," << convolution.blocks << "," << convolution.average_time << "," << convolution.max_time << "\n";
+		}
+		csv << "\n";
+	}
+	csv << "time_bin_start_us,callbacks\n";
+	for (uint32_t b = 0; b < MixStats::TimingBins; ++b) {
+		csv << MixStats::timing_bin_start(b) << "," << stats.timing_histogram[b] << "\n";
+	}
+	if (!csv) {
+		throw std::runtime_error("Failed to write mix stats to '" + filename + "'.");
 	}
-	Sound::unlock();
 }
 
 //------------------
 
 void Sound::Listener::set_position_right(glm::vec3 const& new_position, glm::vec3 const& new_right, float ramp) {
-	Sound::lock();
-	position.set(new_position, ramp);
+	Command command;
+	command.type = Command::SetListener;
+	command.vec_a = new_position;
 	//some extra code to make sure right is always a unit vector:
 	if (new_right == glm::vec3(0.0f)) {
-		right.set(glm::vec3(1.0f, 0.0f, 0.0f), ramp);
+		command.vec_b = glm::vec3(1.0f, 0.0f, 0.0f);
 	}
 	else {
-		right.set(glm::normalize(new_right), ramp);
+		command.vec_b = glm::normalize(new_right);
 	}
-	Sound::unlock();
+	command.ramp = ramp;
+	push_command(command);
 }
 
 //------------------------ internals --------------------------------
 
+//helper: start fading out a voice:
+static void stop_voice(Voice& voice, float ramp) {
+	if (!voice.stopping) {
+		voice.stopping = true;
+		voice.volume.target = 0.0f;
+		voice.volume.ramp = ramp;
+	}
+	else {
+		voice.volume.ramp = std::min(voice.volume.ramp, ramp);
+	}
+}
+
+//helper: record the time from a Play command being issued to 'now' (when it was applied -- usually the start of the block that mixes it):
+// (in offline mode, time is counted in rendered frames, so the result is exact and deterministic)
+static void record_play_latency(Command const& command, std::chrono::steady_clock::time_point now) {
+	uint32_t us = 0;
+	if (offline) {
+		us = uint32_t((offline_frames - command.issued_frame) * 1000000ULL / AUDIO_RATE);
+	}
+	else if (now > command.issued) {
+		us = uint32_t(std::chrono::duration_cast< std::chrono::microseconds >(now - command.issued).count());
+	}
+	mix_stats.plays.fetch_add(1, std::memory_order_relaxed);
+	mix_stats.total_play_latency.fetch_add(us, std::memory_order_relaxed);
+	if (us > mix_stats.max_play_latency.load(std::memory_order_relaxed)) {
+		mix_stats.max_play_latency.store(us, std::memory_order_relaxed);
+	}
+}
+
+//helper: apply one queued command to the mixer state:
+// (called by the audio thread, or by the game thread while holding the audio device lock; 'now' is when the commands are being drained)
+static void apply_command(Command const& command, std::chrono::steady_clock::time_point now) {
+	Voice* voice = nullptr;
+	if (command.voice != -1U) {
+		assert(command.voice < voices.size());
+		voice = &voices[command.voice];
+		//the voice finished (and was recycled) after this command was queued:
+		if (voice->generation.load(std::memory_order_relaxed) != command.generation) return;
+	}
+
+	switch (command.type) {
+	case Command::Play:
+		assert(active_voice_count < active_voices.size());
+		active_voices[active_voice_count++] = command.voice;
+		record_play_latency(command, now);
+		break;
+	case Command::SetVolume:
+		if (!voice->stopping) {
+			voice->volume.set(command.value, command.ramp);
+		}
+		break;
+	case Command::SetPan:
+		if (!(voice->pan.value == voice->pan.value)) break; //ignore if not in '2D' mode
+		voice->pan.set(command.value, command.ramp);
+		break;
+	case Command::SetPosition:
+		if (voice->pan.value == voice->pan.value) break; //ignore if not in '3D' mode
+		voice->position.set(command.vec_a, command.ramp);
+		break;
+	case Command::SetHalfVolumeRadius:
+		if (voice->pan.value == voice->pan.value) break; //ignore if not in '3D' mode
+		voice->half_volume_radius.set(command.value, command.ramp);
+		break;
+	case Command::SetPriority:
+		voice->priority = command.priority;
+		break;
+	case Command::SetRate:
+		if (!(command.value == command.value)) break; //ignore NaN
+		voice->rate.set(std::max(0.0f, std::min(RESAMPLE_MAX_RATE, command.value)), command.ramp);
+		break;
+	case Command::SetInterpolation:
+		voice->interpolation = command.interpolation;
+		break;
+	case Command::Stop:
+		stop_voice(*voice, command.ramp);
+		break;
+	case Command::StopAll:
+		for (uint32_t a = 0; a < active_voice_count; ++a) {
+			stop_voice(voices[active_voices[a]], command.ramp);
+		}
+		break;
+	case Command::SetGlobalVolume:
+		Sound::volume.set(command.value, command.ramp);
+		break;
+	case Command::SetListener:
+		Sound::listener.position.set(command.vec_a, command.ramp);
+		Sound::listener.right.set(command.vec_b, command.ramp);
+		break;
+	case Command::SetMaxRealVoices:
+		max_real_voices = command.count;
+		break;
+	case Command::SetAmbisonics:
+		ambisonics = (command.count != 0);
+		break;
+	case Command::SetHRTF:
+		binaural = command.binaural;
+		if (binaural) {
+			for (auto& channel : binaural->channels) {
+				channel->reset();
+			}
+		}
+		binaural_stats.store(binaural, std::memory_order_release);
+		break;
+	}
+}
+
+//helper: apply every command queued so far:
+// (consumer side of the command queue; must not run concurrently with itself)
+static void drain_commands(std::chrono::steady_clock::time_point now) {
+	uint32_t read = command_read.load(std::memory_order_relaxed);
+	uint32_t write = command_write.load(std::memory_order_acquire);
+	while (read != write) {
+		apply_command(command_queue[read % COMMAND_QUEUE_SIZE], now);
+		read += 1;
+		command_read.store(read, std::memory_order_release);
+	}
+}
+
+//helper: add a command to the queue:
+// (producer side of the command queue)
+static void push_command(Command const& command) {
+	uint32_t write = command_write.load(std::memory_order_relaxed);
+	if (write - command_read.load(std::memory_order_acquire) == COMMAND_QUEUE_SIZE) {
+		//queue is full (mixer is stalled or not running); apply pending commands here.
+		// this is safe because the audio callback can't run while the device is locked:
+		Sound::lock();
+		drain_commands(std::chrono::steady_clock::now());
+		Sound::unlock();
+	}
+	command_queue[write % COMMAND_QUEUE_SIZE] = command;
+	command_write.store(write + 1, std::memory_order_release);
+}
+
+//helper: retire a voice that has finished playing:
+// (audio thread; invalidates handles and passes the voice back to the game thread)
+static void finish_voice(uint32_t index) {
+	if (voices[index].stream != -1U) {
+		//let the stream thread close the file and recycle the stream:
+		streams[voices[index].stream].state.store(Stream::Finished, std::memory_order_release);
+	}
+	voices[index].generation.fetch_add(1, std::memory_order_release);
+	uint32_t write = finished_write.load(std::memory_order_relaxed);
+	assert(write - finished_read.load(std::memory_order_acquire) < finished_voices.size());
+	finished_voices[write & (finished_voices.size() - 1)] = index;
+	finished_write.store(write + 1, std::memory_order_release);
+}
 
 //helper: equal-power panning
 inline void compute_pan_weights(float pan, float* left, float* right) {
@@ -253,36 +1086,53 @@ void compute_pan_from_listener_and_position(
 	}
 }
 
-//helper: ramp updates...
-constexpr float const RAMP_STEP = float(MIX_SAMPLES) / float(AUDIO_RATE);
+//helper: first-order ambisonic encoding of a source (direction and distance attenuation as above):
+BFormatFrame compute_bformat_from_listener_and_position(
+	glm::vec3 const& listener_position,
+	glm::vec3 const& source_position,
+	float source_half_radius,
+	float gain
+) {
+	glm::vec3 to = source_position - listener_position;
+	float distance = glm::length(to);
+	if (distance == 0.0f) {
+		//no direction, so only the omnidirectional component:
+		return BFormatFrame{gain * std::sqrt(0.5f), 0.0f, 0.0f, 0.0f};
+	}
+	float att = 1.0f / (1.0f + (distance / source_half_radius));
+	glm::vec3 dir = (gain * att / distance) * to;
+	return BFormatFrame{gain * att * std::sqrt(0.5f), dir.x, dir.y, dir.z};
+}
+
+//helper: ramp updates (by ramp_step seconds)...
 
 //helper: ...for single values:
 void step_value_ramp(Sound::Ramp< float >& ramp) {
-	if (ramp.ramp < RAMP_STEP) {
+	if (ramp.ramp < ramp_step) {
 		ramp.value = ramp.target;
 		ramp.ramp = 0.0f;
 	}
 	else {
-		ramp.value += (RAMP_STEP / ramp.ramp) * (ramp.target - ramp.value);
-		ramp.ramp -= RAMP_STEP;
+		ramp.value += (ramp_step / ramp.ramp) * (ramp.target - ramp.value);
+		ramp.ramp -= ramp_step;
 	}
 }
 
 //helper: ...for 3D positions:
 void step_position_ramp(Sound::Ramp< glm::vec3 >& ramp) {
-	if (ramp.ramp < RAMP_STEP) {
+	if (ramp.ramp < ramp_step) {
 		ramp.value = ramp.target;
 		ramp.ramp = 0.0f;
 	}
 	else {
-		ramp.value = glm::mix(ramp.value, ramp.target, RAMP_STEP / ramp.ramp);
-		ramp.ramp -= RAMP_STEP;
+		ramp.value = glm::mix(ramp.value, ramp.target, ramp_step / ramp.ramp);
+		ramp.ramp -= ramp_step;
 	}
 }
 
 //helper: ...for 3D directions:
 void step_direction_ramp(Sound::Ramp< glm::vec3 >& ramp) {
-	if (ramp.ramp < RAMP_STEP) {
+	if (ramp.ramp < ramp_step) {
 		ramp.value = ramp.target;
 		ramp.ramp = 0.0f;
 	}
@@ -309,28 +1159,470 @@ void step_direction_ramp(Sound::Ramp< glm::vec3 >& ramp) {
 		float angle = std::acos(glm::clamp(glm::dot(ramp.value, ramp.target), -1.0f, 1.0f));
 
 		//figure out new target value by moving angle toward target:
-		angle *= (ramp.ramp - RAMP_STEP) / ramp.ramp;
+		angle *= (ramp.ramp - ramp_step) / ramp.ramp;
 
 		ramp.value = ramp.target * std::cos(angle) + perp * std::sin(angle);
-		ramp.ramp -= RAMP_STEP;
+		ramp.ramp -= ramp_step;
+	}
+}
+
+
+//helper: top up one stream's ring from disk:
+// (stream thread only)
+static void service_stream(Stream& stream) {
+	uint8_t state = stream.state.load(std::memory_order_acquire);
+
+	if (state == Stream::Finished) {
+		//voice is done with the stream; close up and make it available again:
+		if (stream.file.is_open()) stream.file.close();
+		stream.state.store(Stream::Free, std::memory_order_release);
+		return;
+	}
+
+	if (state == Stream::Starting) {
+		//open file and skip the part of the sample that is resident:
+		Sound::Sample const& sample = *stream.sample;
+		if (stream.file.is_open()) stream.file.close();
+		stream.file.clear();
+		stream.file.open(sample.stream_filename, std::ios::binary);
+		if (!stream.file) {
+			std::cerr << "Failed to open '" << sample.stream_filename << "' for streaming." << std::endl;
+		}
+		stream.file_position = sample.resident;
+		stream.file.seekg(std::streamoff(sample.stream_info.data_offset + uint64_t(stream.file_position) * sample.stream_info.bytes_per_frame()));
+		stream.end_of_data = !stream.file;
+		if (stream.end_of_data) stream.failed.store(true, std::memory_order_release);
+		//n.b. compare-exchange in case the voice already finished (if so, the next pass will free the stream):
+		uint8_t expected = Stream::Starting;
+		if (!stream.state.compare_exchange_strong(expected, Stream::Streaming, std::memory_order_acq_rel)) return;
+		state = Stream::Streaming;
+	}
+
+	if (state != Stream::Streaming) return;
+
+	Sound::Sample const& sample = *stream.sample;
+	WavInfo const& info = sample.stream_info;
+	uint32_t const max_chunk = std::min< uint32_t >(STREAM_CHUNK, uint32_t(stream.raw.size() / info.bytes_per_frame()));
+
+	while (!stream.end_of_data) {
+		uint64_t written = stream.written.load(std::memory_order_relaxed);
+		uint64_t space = STREAM_RING_SIZE - (written - stream.consumed.load(std::memory_order_acquire));
+		uint32_t offset = uint32_t(written & (STREAM_RING_SIZE - 1));
+
+		//read up to a chunk, stopping at the end of the ring and the end of the file:
+		uint32_t count = uint32_t(std::min< uint64_t >(space, STREAM_RING_SIZE - offset));
+		count = std::min(count, max_chunk);
+		count = std::min(count, sample.length - stream.file_position);
+		if (count == 0) break; //ring is full
+
+		if (!stream.file.read(reinterpret_cast< char* >(stream.raw.data()), std::streamsize(count) * info.bytes_per_frame())) {
+			std::cerr << "Failed to read from '" << sample.stream_filename << "' while streaming." << std::endl;
+			//play whatever whole frames did get read, then let the voice finish:
+			uint32_t got = uint32_t(stream.file.gcount() / info.bytes_per_frame());
+			convert_wav_frames(info, stream.raw.data(), got, stream.ring.data() + offset);
+			stream.written.store(written + got, std::memory_order_release);
+			stream.file_position += got;
+			stream.end_of_data = true;
+			//n.b. after 'written', so the mixer sees the final count once it sees 'failed':
+			stream.failed.store(true, std::memory_order_release);
+			break;
+		}
+		convert_wav_frames(info, stream.raw.data(), count, stream.ring.data() + offset);
+		stream.written.store(written + count, std::memory_order_release);
+
+		stream.file_position += count;
+		if (stream.file_position == sample.length) {
+			if (stream.loop) {
+				//playback will wrap to the resident data, so continue from just past it:
+				stream.file_position = sample.resident;
+				stream.file.seekg(std::streamoff(info.data_offset + uint64_t(stream.file_position) * info.bytes_per_frame()));
+			}
+			else {
+				stream.end_of_data = true;
+			}
+		}
 	}
 }
 
+//The stream thread -- wakes up periodically (or when a stream starts) to keep stream rings full:
+static void stream_thread_main() {
+	std::unique_lock< std::mutex > lock(stream_mutex);
+	while (!stream_thread_quit) {
+		lock.unlock();
+		for (auto& stream : streams) {
+			service_stream(stream);
+		}
+		lock.lock();
+		//each ring holds over a second of audio, so a short sleep leaves plenty of margin:
+		stream_cv.wait_for(lock, std::chrono::milliseconds(10));
+	}
+	lock.unlock();
+
+	for (auto& stream : streams) {
+		if (stream.file.is_open()) stream.file.close();
+	}
+}
+
+//helper: copy (decoding if needed) resident samples [first, first + count) into 'out':
+static void read_resident(Sound::Sample const& sample, uint32_t first, uint32_t count, float* out) {
+	assert(first + count <= sample.resident);
+	if (sample.encoding == Sound::Sample::Int16) {
+		decode_int16(sample.int16_data() + first, count, out);
+	}
+	else if (sample.encoding == Sound::Sample::ADPCM4) {
+		decode_adpcm4(sample.adpcm4_data(), first, count, out);
+	}
+	else {
+		assert(sample.encoding == Sound::Sample::Float32);
+		std::copy(sample.float_data() + first, sample.float_data() + first + count, out);
+	}
+}
+
+//helper: find the next contiguous run of sample data for a voice:
+// returns a pointer to up to *count values starting at voice.i, and sets *count to the run length.
+// compressed data is decoded into 'scratch' (which must hold *count values); if 'scratch' is null, the
+// run is only measured and the returned pointer must not be used [handy for virtual voices].
+// (*count is set to zero if a stream has fallen behind or failed)
+static float const* voice_run(Voice const& voice, uint32_t* count, float* scratch) {
+	Sound::Sample const& sample = *voice.sample;
+	*count = std::min(*count, sample.length - voice.i);
+	if (voice.i < sample.resident) {
+		*count = std::min(*count, sample.resident - voice.i);
+		if (sample.encoding == Sound::Sample::Float32) {
+			return sample.float_data() + voice.i;
+		}
+		if (scratch == nullptr) return nullptr;
+		read_resident(sample, voice.i, *count, scratch);
+		return scratch;
+	}
+	//past the resident data -- read from stream:
+	assert(voice.stream != -1U);
+	Stream const& stream = streams[voice.stream];
+	uint64_t consumed = stream.consumed.load(std::memory_order_relaxed);
+	uint64_t available = stream.written.load(std::memory_order_acquire) - consumed;
+	uint32_t offset = uint32_t(consumed & (STREAM_RING_SIZE - 1));
+	*count = uint32_t(std::min< uint64_t >(*count, std::min< uint64_t >(available, STREAM_RING_SIZE - offset)));
+	return stream.ring.data() + offset;
+}
+
+//helper: has a streamed voice run out of data for good? (its stream failed, and the voice has used up the ring)
+static bool stream_failed(Voice const& voice) {
+	if (voice.stream == -1U || voice.i < voice.sample->resident) return false;
+	Stream const& stream = streams[voice.stream];
+	//n.b. nothing is written after 'failed' is set, so checking it first means 'written' below is final:
+	if (!stream.failed.load(std::memory_order_acquire)) return false;
+	return stream.written.load(std::memory_order_acquire) == stream.consumed.load(std::memory_order_relaxed);
+}
+
+//helper: move a voice forward after using a run from voice_run:
+static void advance_voice(Voice& voice, uint32_t count) {
+	if (voice.i >= voice.sample->resident) {
+		//give ring space back to the stream thread:
+		Stream& stream = streams[voice.stream];
+		stream.consumed.store(stream.consumed.load(std::memory_order_relaxed) + count, std::memory_order_release);
+	}
+	voice.i += count;
+}
+
+//helper: read the next 'count' source samples for a resampling voice into 'out' (or just skip them if 'out' is null):
+// (reads silence past the end of a non-looping sample, or when a stream has fallen behind)
+static void read_voice(Voice& voice, uint32_t count, float* out) {
+	uint32_t length = voice.sample->length;
+	while (count > 0) {
+		uint32_t run = count;
+		float const* src = nullptr;
+		if (voice.i < length) {
+			src = voice_run(voice, &run, out);
+		}
+		else {
+			run = 0;
+		}
+		if (run == 0) {
+			if (voice.i == length) voice.tail += count;
+			if (out) std::fill(out, out + count, 0.0f);
+			return;
+		}
+		if (out) {
+			if (src != out) std::copy(src, src + run, out);
+			out += run;
+		}
+		count -= run;
+
+		advance_voice(voice, run);
+		if (voice.i == length && voice.loop) {
+			voice.i = 0;
+		}
+	}
+}
+
+//helper: switch a voice over to resampled playback without a gap:
+// (fills history so that the next sample heard is the one at the current position)
+static void start_resampling(Voice& voice) {
+	constexpr uint32_t const Behind = RESAMPLE_TAPS / 2 - 1; //history before the play position...
+	constexpr uint32_t const Ahead = RESAMPLE_TAPS / 2 + 1; //...and at/after it
+	Sound::Sample const& sample = *voice.sample;
+	if (voice.i >= Behind && voice.i <= sample.resident) {
+		read_resident(sample, voice.i - Behind, Behind, voice.history.data());
+	}
+	else {
+		//(start of sample, or already streaming -- just start from silence)
+		std::fill(voice.history.begin(), voice.history.begin() + Behind, 0.0f);
+	}
+	read_voice(voice, Ahead, voice.history.data() + Behind);
+	voice.phase = 0.0;
+	voice.resampling = true;
+}
+
+//Where (and with what gains) one voice is mixed during a block:
+struct MixTarget {
+	StereoFrame* buffer = nullptr; //panned voices are mixed here...
+	BFormatFrame* bus = nullptr; //...ambisonic voices here
+	StereoFrame start_pan, pan_step;
+	BFormatFrame start_bformat, bformat_step;
+};
+
+//helper: mix 'count' samples into frames [first, first + count) of a target:
+static void mix_run(MixTarget const& target, float const* src, uint32_t count, uint32_t first) {
+	if (target.bus) {
+		mix_mono_bformat(target.bus + first, src, count, target.start_bformat, target.bformat_step, first);
+	}
+	else {
+		mix_mono_ramp(target.buffer + first, src, count, target.start_pan, target.pan_step, first);
+	}
+}
+
+//helper: resample one block from a voice and mix it into 'target' (or, if 'target' is null, just advance the voice):
+static void mix_resampled(Voice& voice, MixTarget const* target, MixScratch& scratch) {
+	constexpr uint32_t const Taps = RESAMPLE_TAPS;
+
+	//rate ramps linearly over the block; play position 'pos' is relative to the start of history:
+	float rate = voice.start_rate;
+	float accel = (voice.end_rate - voice.start_rate) / mix_samples;
+	double start = (Taps / 2 - 1) + voice.phase;
+	double end = start + double(rate) * mix_samples + double(accel) * (0.5 * mix_samples * (mix_samples - 1));
+	//read enough to cover the filter at every position in this block (and to leave history for the next):
+	uint32_t count = uint32_t(std::floor(end)) - (Taps / 2 - 1);
+	assert(Taps + count + Taps <= scratch.source.size());
+
+	if (target) {
+		float* src = scratch.source.data();
+		std::copy(voice.history.begin(), voice.history.end(), src);
+		read_voice(voice, count, src + Taps);
+		//n.b. padding guards against rounding in the kernels' position math pushing a read one past the end:
+		std::fill(src + Taps + count, src + Taps + count + Taps, 0.0f);
+
+		if (voice.interpolation == Sound::Linear) {
+			resample_linear(scratch.resampled.data(), src, mix_samples, float(start), rate, accel);
+		}
+		else {
+			float const* filter = resample_filter(std::max(voice.start_rate, voice.end_rate));
+			resample_polyphase(scratch.resampled.data(), src, mix_samples, float(start), rate, accel, filter);
+		}
+		mix_run(*target, scratch.resampled.data(), mix_samples, 0);
+
+		std::copy(src + count, src + count + Taps, voice.history.begin());
+	}
+	else if (count >= Taps) {
+		//skip all but the samples that end up in history:
+		read_voice(voice, count - Taps, nullptr);
+		read_voice(voice, Taps, voice.history.data());
+	}
+	else {
+		std::copy(voice.history.begin() + count, voice.history.end(), voice.history.begin());
+		read_voice(voice, count, voice.history.data() + (Taps - count));
+	}
+
+	voice.phase = end - std::floor(end);
+}
+
+//helper: mix one block of a voice into 'buffer' -- or, for ambisonic voices, 'bus' -- (or, if both are null, just advance it):
+// (uses the gains computed by mix_audio; safe to call for different voices on different threads)
+static void mix_voice(Voice& voice, StereoFrame* buffer, BFormatFrame* bus, MixScratch& scratch) {
+	uint32_t length = voice.sample->length;
+	assert(voice.i < length || voice.resampling);
+
+	//figure out per-sample steps so that gains will move smoothly from start to end:
+	MixTarget target;
+	if (voice.ambisonic) {
+		target.bus = bus;
+		target.start_bformat = voice.start_bformat;
+		target.bformat_step.w = (voice.end_bformat.w - voice.start_bformat.w) / mix_samples;
+		target.bformat_step.x = (voice.end_bformat.x - voice.start_bformat.x) / mix_samples;
+		target.bformat_step.y = (voice.end_bformat.y - voice.start_bformat.y) / mix_samples;
+		target.bformat_step.z = (voice.end_bformat.z - voice.start_bformat.z) / mix_samples;
+	}
+	else {
+		target.buffer = buffer;
+		target.start_pan = voice.start_pan;
+		target.pan_step.l = (voice.end_pan.l - voice.start_pan.l) / mix_samples;
+		target.pan_step.r = (voice.end_pan.r - voice.start_pan.r) / mix_samples;
+	}
+	bool audible = (target.buffer || target.bus);
+
+	if (!voice.resampling && (voice.start_rate != 1.0f || voice.end_rate != 1.0f)) {
+		start_resampling(voice);
+	}
+
+	if (voice.resampling) {
+		mix_resampled(voice, audible ? &target : nullptr, scratch);
+		return;
+	}
+
+	//mix (or, for virtual voices, just skip) in runs that end at the end of the buffer or the end of contiguous sample data:
+	// (virtual voices still walk through runs so streamed samples consume their data in order)
+	for (uint32_t i = 0; i < mix_samples; /* later */) {
+		uint32_t run = mix_samples - i;
+		float const* src = voice_run(voice, &run, audible ? scratch.decode.data() : nullptr);
+		if (run == 0) break; //stream fell behind; rest of this block is silent for this voice
+		if (audible) mix_run(target, src, run, i);
+		i += run;
+
+		//update position in sample:
+		advance_voice(voice, run);
+		if (voice.i == length) {
+			if (voice.loop) {
+				voice.i = 0;
+			}
+			else {
+				break;
+			}
+		}
+	}
+}
+
+//helper: listener's forward and up directions, given right (world +z is up):
+static void listener_frame(glm::vec3 const& right, glm::vec3* forward, glm::vec3* up) {
+	glm::vec3 f = glm::cross(glm::vec3(0.0f, 0.0f, 1.0f), right);
+	if (glm::dot(f, f) < 1.0e-8f) f = glm::vec3(0.0f, 1.0f, 0.0f); //(right points straight up or down)
+	*forward = glm::normalize(f);
+	*up = glm::cross(right, *forward);
+}
+
+//helper: decode ambisonic_bus into 'buffer' using an HRTF, with the listener's right vector moving from 'start_right' to 'end_right':
+static void decode_binaural(Binaural& hrtf, StereoFrame* buffer, glm::vec3 const& start_right, glm::vec3 const& end_right) {
+	//rotate the bus into the listener's frame:
+	glm::vec3 start_forward, start_up, end_forward, end_up;
+	listener_frame(start_right, &start_forward, &start_up);
+	listener_frame(end_right, &end_forward, &end_up);
+	for (uint32_t s = 0; s < mix_samples; ++s) {
+		float amt = float(s) / float(mix_samples);
+		glm::vec3 xyz(ambisonic_bus[s].x, ambisonic_bus[s].y, ambisonic_bus[s].z);
+		hrtf.inputs[0][s] = ambisonic_bus[s].w;
+		hrtf.inputs[1][s] = glm::dot(glm::mix(start_right, end_right, amt), xyz);
+		hrtf.inputs[2][s] = glm::dot(glm::mix(start_forward, end_forward, amt), xyz);
+		hrtf.inputs[3][s] = glm::dot(glm::mix(start_up, end_up, amt), xyz);
+	}
+
+	//convolve each channel (timing each for the stats):
+	for (uint32_t c = 0; c < 4; ++c) {
+		auto before = std::chrono::steady_clock::now();
+		hrtf.channels[c]->process(hrtf.inputs[c].data(), buffer, mix_samples);
+		auto after = std::chrono::steady_clock::now();
+		uint32_t ns = uint32_t(std::chrono::duration_cast< std::chrono::nanoseconds >(after - before).count());
+		hrtf.total_time[c].fetch_add(ns, std::memory_order_relaxed);
+		if (ns > hrtf.max_time[c].load(std::memory_order_relaxed)) hrtf.max_time[c].store(ns, std::memory_order_relaxed);
+	}
+	hrtf.blocks.fetch_add(1, std::memory_order_relaxed);
+}
+
+//Mix workers wait for a group of voices, mix it, and signal the audio thread:
+static void mix_worker_main(MixWorker* worker) {
+	SDL_SetThreadPriority(SDL_THREAD_PRIORITY_TIME_CRITICAL); //(same as SDL's audio thread; may fail without permission, which is fine)
+	while (true) {
+		SDL_SemWait(worker->start);
+		if (worker->quit) break;
+		std::fill(worker->buffer.begin(), worker->buffer.end(), StereoFrame{0.0f, 0.0f});
+		if (ambisonics) std::fill(worker->bus.begin(), worker->bus.end(), BFormatFrame{0.0f, 0.0f, 0.0f, 0.0f});
+		for (uint32_t m = worker->first; m < worker->first + worker->count; ++m) {
+			mix_voice(voices[mixing_voices[m]], worker->buffer.data(), worker->bus.data(), worker->scratch);
+		}
+		worker->done.store(true, std::memory_order_release);
+	}
+}
+
+static void start_mix_workers(uint32_t count) {
+	stop_mix_workers();
+	if (count == -1U) {
+		//leave a core for the game (and one for the audio thread itself):
+		uint32_t cores = std::thread::hardware_concurrency();
+		count = (cores > 2 ? cores - 2 : 0);
+	}
+	count = std::min(count, MAX_MIX_WORKERS);
+	for (uint32_t w = 0; w < count; ++w) {
+		std::unique_ptr< MixWorker > worker(new MixWorker);
+		worker->start = SDL_CreateSemaphore(0);
+		if (!worker->start) {
+			std::cerr << "Failed to create mix worker semaphore (" << SDL_GetError() << "); using " << w << " mix workers." << std::endl;
+			break;
+		}
+		worker->thread = std::thread(mix_worker_main, worker.get());
+		mix_workers.emplace_back(std::move(worker));
+	}
+}
+
+static void stop_mix_workers() {
+	//n.b. only called when mix_audio isn't running, so workers are all idle:
+	for (auto& worker : mix_workers) {
+		worker->quit = true;
+		SDL_SemPost(worker->start);
+		worker->thread.join();
+		SDL_DestroySemaphore(worker->start);
+	}
+	mix_workers.clear();
+}
+
+//helper: add one mix_audio call to the timing statistics:
+static void record_mix_stats(std::chrono::steady_clock::time_point start, uint32_t voice_count) {
+	auto end = std::chrono::steady_clock::now();
+
+	//n.b. only the audio thread writes these, so load + store is fine for the maximums:
+	uint32_t ns = uint32_t(std::min< int64_t >(std::chrono::duration_cast< std::chrono::nanoseconds >(end - start).count(), 0xffffffff));
+	float us = 1.0e-3f * float(ns);
+	uint32_t bin = (us < 1.0f ? 0 : std::min(Sound::MixStats::TimingBins - 1, uint32_t(2.0f * std::log2(us))));
+	mix_stats.timing_histogram[bin].fetch_add(1, std::memory_order_relaxed);
+	mix_stats.callbacks.fetch_add(1, std::memory_order_relaxed);
+	mix_stats.total_time.fetch_add(ns, std::memory_order_relaxed);
+	if (ns > mix_stats.max_time.load(std::memory_order_relaxed)) {
+		mix_stats.max_time.store(ns, std::memory_order_relaxed);
+	}
+	mix_stats.total_voices.fetch_add(voice_count, std::memory_order_relaxed);
+	if (voice_count > mix_stats.peak_voices.load(std::memory_order_relaxed)) {
+		mix_stats.peak_voices.store(voice_count, std::memory_order_relaxed);
+	}
+
+	//a gap between callbacks much longer than the buffer period means the device probably ran dry:
+	// (offline rendering has no deadline, so skip this)
+	if (!offline) {
+		if (have_last_callback) {
+			uint32_t gap = uint32_t(std::chrono::duration_cast< std::chrono::microseconds >(start - last_callback).count());
+			uint32_t period = uint32_t(1000000ULL * mix_samples / AUDIO_RATE);
+			if (gap > period + period / 2) {
+				mix_stats.underruns.fetch_add(1, std::memory_order_relaxed);
+			}
+			if (gap > mix_stats.max_gap.load(std::memory_order_relaxed)) {
+				mix_stats.max_gap.store(gap, std::memory_order_relaxed);
+			}
+		}
+		last_callback = start;
+		have_last_callback = true;
+	}
+}
 
 //The audio callback -- invoked by SDL when it needs more sound to play:
 void mix_audio(void*, Uint8* buffer_, int len) {
 	assert(buffer_); //should always have some audio buffer
 
-	struct LR {
-		float l;
-		float r;
-	};
-	static_assert(sizeof(LR) == 8, "Sample is packed");
-	assert(len == MIX_SAMPLES * sizeof(LR)); //should always have the expected number of samples
+	auto callback_start = std::chrono::steady_clock::now();
+
+	typedef StereoFrame LR;
+	assert(uint32_t(len) == mix_samples * sizeof(LR)); //should always have the expected number of samples
 	LR* buffer = reinterpret_cast<LR*>(buffer_);
 
+	//apply any parameter/lifecycle changes queued by the game thread:
+	drain_commands(callback_start);
+
 	//zero the output buffer:
-	for (uint32_t s = 0; s < MIX_SAMPLES; ++s) {
+	for (uint32_t s = 0; s < mix_samples; ++s) {
 		buffer[s].l = 0.0f;
 		buffer[s].r = 0.0f;
 	}
@@ -348,101 +1640,230 @@ void mix_audio(void*, Uint8* buffer_, int len) {
 	glm::vec3 end_position = Sound::listener.position.value;
 	glm::vec3 end_right = Sound::listener.right.value;
 
-	//add audio from each playing sample into the buffer:
-	for (auto si = playing_samples.begin(); si != playing_samples.end(); /* later */) {
-		Sound::PlayingSample& playing_sample = **si; //much more convenient than writing ** everywhere.
+	//figure out each voice's gains for this block:
+	for (uint32_t a = 0; a < active_voice_count; ++a) {
+		Voice& voice = voices[active_voices[a]];
+
+		//3D voices go through the ambisonic bus (if enabled) instead of being panned:
+		voice.ambisonic = ambisonics && !(voice.pan.value == voice.pan.value);
 
 		//Figure out sample panning/volume at start...
-		LR start_pan;
-		if (!(playing_sample.pan.value == playing_sample.pan.value)) {
+		LR& start_pan = voice.start_pan;
+		if (voice.ambisonic) {
+			voice.start_bformat = compute_bformat_from_listener_and_position(
+				start_position,
+				voice.position.value,
+				voice.half_volume_radius.value,
+				voice.volume.value);
+			start_pan.l = start_pan.r = 0.0f;
+
+			step_position_ramp(voice.position);
+			step_value_ramp(voice.half_volume_radius);
+		}
+		else if (!(voice.pan.value == voice.pan.value)) {
 			//3D panning
 			compute_pan_from_listener_and_position(
 				start_position, start_right,
-				playing_sample.position.value,
-				playing_sample.half_volume_radius.value,
+				voice.position.value,
+				voice.half_volume_radius.value,
 				&start_pan.l, &start_pan.r);
 
-			step_position_ramp(playing_sample.position);
-			step_value_ramp(playing_sample.half_volume_radius);
+			step_position_ramp(voice.position);
+			step_value_ramp(voice.half_volume_radius);
 		}
 		else {
 			//2D panning
-			compute_pan_weights(playing_sample.pan.value, &start_pan.l, &start_pan.r);
+			compute_pan_weights(voice.pan.value, &start_pan.l, &start_pan.r);
 
-			step_value_ramp(playing_sample.pan);
+			step_value_ramp(voice.pan);
 		}
-		start_pan.l *= start_volume * playing_sample.volume.value;
-		start_pan.r *= start_volume * playing_sample.volume.value;
+		start_pan.l *= voice.volume.value;
+		start_pan.r *= voice.volume.value;
 
-		step_value_ramp(playing_sample.volume);
+		step_value_ramp(voice.volume);
 
 		//..and end of the mix period:
-		LR end_pan;
-		if (!(playing_sample.pan.value == playing_sample.pan.value)) {
+		LR& end_pan = voice.end_pan;
+		if (voice.ambisonic) {
+			voice.end_bformat = compute_bformat_from_listener_and_position(
+				end_position,
+				voice.position.value,
+				voice.half_volume_radius.value,
+				voice.volume.value);
+			end_pan.l = end_pan.r = 0.0f;
+		}
+		else if (!(voice.pan.value == voice.pan.value)) {
 			//3D panning
 			compute_pan_from_listener_and_position(
 				end_position, end_right,
-				playing_sample.position.value,
-				playing_sample.half_volume_radius.value,
+				voice.position.value,
+				voice.half_volume_radius.value,
 				&end_pan.l, &end_pan.r);
 		}
 		else {
 			//2D panning
-			compute_pan_weights(playing_sample.pan.value, &end_pan.l, &end_pan.r);
+			compute_pan_weights(voice.pan.value, &end_pan.l, &end_pan.r);
 		}
 
-		end_pan.l *= end_volume * playing_sample.volume.value;
-		end_pan.r *= end_volume * playing_sample.volume.value;
+		end_pan.l *= voice.volume.value;
+		end_pan.r *= voice.volume.value;
 
-		//figure out a step to add at each sample so that pan will move smoothly from start to end:
-		LR pan = start_pan;
-		LR pan_step;
-		pan_step.l = (end_pan.l - start_pan.l) / MIX_SAMPLES;
-		pan_step.r = (end_pan.r - start_pan.r) / MIX_SAMPLES;
+		voice.start_rate = voice.rate.value;
+		step_value_ramp(voice.rate);
+		voice.end_rate = voice.rate.value;
 
-		assert(playing_sample.i < playing_sample.data.size());
-
-		for (uint32_t i = 0; i < MIX_SAMPLES; ++i) {
-			//mix one sample based on current pan values:
-			buffer[i].l += pan.l * playing_sample.data[playing_sample.i];
-			buffer[i].r += pan.r * playing_sample.data[playing_sample.i];
+		//(global volume is applied to the final mix, but still counts toward whether a voice is audible)
+		if (voice.ambisonic) {
+			//(w carries the source's overall gain, scaled by 1/sqrt(2))
+			voice.loudness = std::sqrt(2.0f) * std::max(voice.start_bformat.w, voice.end_bformat.w) * std::max(start_volume, end_volume);
+		}
+		else {
+			voice.loudness = std::max(std::max(start_pan.l, start_pan.r), std::max(end_pan.l, end_pan.r)) * std::max(start_volume, end_volume);
+		}
+		voice.real = false;
+	}
 
-			//update position in sample:
-			playing_sample.i += 1;
-			if (playing_sample.i == playing_sample.data.size()) {
-				if (playing_sample.loop) {
-					playing_sample.i = 0;
-				}
-				else {
-					break;
-				}
+	//pick which voices to mix -- the audible ones, up to the real voice budget, highest priority (then loudest) first:
+	uint32_t audible_count = 0;
+	for (uint32_t a = 0; a < active_voice_count; ++a) {
+		if (voices[active_voices[a]].loudness > INAUDIBLE_GAIN) {
+			audible_voices[audible_count++] = active_voices[a];
+		}
+	}
+	if (audible_count > max_real_voices) {
+		//n.b. nth_element works in place, so this doesn't allocate:
+		std::nth_element(audible_voices.begin(), audible_voices.begin() + max_real_voices, audible_voices.begin() + audible_count,
+			[](uint32_t a, uint32_t b) {
+				if (voices[a].priority != voices[b].priority) return voices[a].priority > voices[b].priority;
+				return voices[a].loudness > voices[b].loudness;
 			}
+		);
+		audible_count = max_real_voices;
+	}
+	for (uint32_t a = 0; a < audible_count; ++a) {
+		voices[audible_voices[a]].real = true;
+	}
 
-			//update pan values:
-			pan.l += pan_step.l;
-			pan.r += pan_step.r;
+	//decide which voices to mix (fading voices in or out as they move between real and virtual):
+	uint32_t mixing_count = 0;
+	for (uint32_t a = 0; a < active_voice_count; ++a) {
+		uint32_t index = active_voices[a];
+		Voice& voice = voices[index];
+		voice.mixing = voice.real;
+		if (voice.real && voice.mix == Voice::MixVirtual) {
+			//promoted back to real: fade in over this block to avoid a click:
+			voice.start_pan.l = voice.start_pan.r = 0.0f;
+			voice.start_bformat = BFormatFrame{0.0f, 0.0f, 0.0f, 0.0f};
 		}
+		else if (!voice.real && voice.mix == Voice::MixReal) {
+			//just virtualized: mix one more block, fading out:
+			voice.end_pan.l = voice.end_pan.r = 0.0f;
+			voice.end_bformat = BFormatFrame{0.0f, 0.0f, 0.0f, 0.0f};
+			voice.mixing = true;
+		}
+		voice.mix = (voice.real ? Voice::MixReal : Voice::MixVirtual);
+		if (voice.mixing) mixing_voices[mixing_count++] = index;
+	}
+	uint32_t real_count = mixing_count;
+
+	//split the mixing voices into groups -- the first for this thread, the rest for (as many as are worth waking) mix workers:
+	uint32_t groups = std::max(1U, std::min(uint32_t(mix_workers.size()) + 1, mixing_count / MIN_GROUP_VOICES));
+	for (uint32_t g = 1; g < groups; ++g) {
+		MixWorker& worker = *mix_workers[g - 1];
+		worker.first = mixing_count * g / groups;
+		worker.count = mixing_count * (g + 1) / groups - worker.first;
+		worker.done.store(false, std::memory_order_relaxed);
+		SDL_SemPost(worker.start);
+	}
+
+	//mix the first group directly into the output:
+	if (ambisonics) std::fill(ambisonic_bus.begin(), ambisonic_bus.end(), BFormatFrame{0.0f, 0.0f, 0.0f, 0.0f});
+	for (uint32_t m = 0; m < mixing_count / groups; ++m) {
+		mix_voice(voices[mixing_voices[m]], buffer, ambisonic_bus.data(), audio_scratch);
+	}
+
+	//advance virtual voices:
+	for (uint32_t a = 0; a < active_voice_count; ++a) {
+		Voice& voice = voices[active_voices[a]];
+		if (!voice.mixing) mix_voice(voice, nullptr, nullptr, audio_scratch);
+	}
+
+	//wait for the other groups and add them in:
+	// (always in worker order, so output doesn't depend on timing)
+	for (uint32_t g = 1; g < groups; ++g) {
+		MixWorker& worker = *mix_workers[g - 1];
+		while (!worker.done.load(std::memory_order_acquire)) {
+			std::this_thread::yield();
+		}
+		for (uint32_t s = 0; s < mix_samples; ++s) {
+			buffer[s].l += worker.buffer[s].l;
+			buffer[s].r += worker.buffer[s].r;
+		}
+		if (ambisonics) {
+			for (uint32_t s = 0; s < mix_samples; ++s) {
+				ambisonic_bus[s].w += worker.bus[s].w;
+				ambisonic_bus[s].x += worker.bus[s].x;
+				ambisonic_bus[s].y += worker.bus[s].y;
+				ambisonic_bus[s].z += worker.bus[s].z;
+			}
+		}
+	}
+
+	//decode the ambisonic bus (once for all 3D voices) binaurally if there's an HRTF...
+	if (ambisonics && binaural) {
+		decode_binaural(*binaural, buffer, start_right, end_right);
+	}
+	//...or otherwise with a pair of virtual cardioid microphones facing the listener's left and right:
+	// (a cardioid facing 'd' picks up 0.5 * (1 + cos(angle to d)), so its weights are (0.5 * sqrt(2), 0.5 * d))
+	else if (ambisonics) {
+		auto cardioid = [](glm::vec3 const& d) {
+			return BFormatFrame{0.5f * std::sqrt(2.0f), 0.5f * d.x, 0.5f * d.y, 0.5f * d.z};
+		};
+		BFormatFrame left_start = cardioid(-start_right), left_end = cardioid(-end_right);
+		BFormatFrame right_start = cardioid(start_right), right_end = cardioid(end_right);
+		auto step = [](BFormatFrame const& a, BFormatFrame const& b) {
+			return BFormatFrame{(b.w - a.w) / mix_samples, (b.x - a.x) / mix_samples, (b.y - a.y) / mix_samples, (b.z - a.z) / mix_samples};
+		};
+		decode_bformat(buffer, ambisonic_bus.data(), mix_samples,
+			left_start, step(left_start, left_end), right_start, step(right_start, right_end));
+	}
+
+	//apply global volume:
+	float volume_step = (end_volume - start_volume) / mix_samples;
+	for (uint32_t s = 0; s < mix_samples; ++s) {
+		float amt = start_volume + s * volume_step;
+		buffer[s].l *= amt;
+		buffer[s].r *= amt;
+	}
 
-		if (playing_sample.i >= playing_sample.data.size()
-			|| (playing_sample.stopping && playing_sample.volume.value == 0.0f)) { //sample has finished
-			playing_sample.stopped = true;
-			//erase from list:
-			auto old = si;
-			++si;
-			playing_samples.erase(old);
+	//retire finished voices:
+	// ('kept' compacts the active list in place, preserving order)
+	uint32_t kept = 0;
+	for (uint32_t a = 0; a < active_voice_count; ++a) {
+		uint32_t index = active_voices[a];
+		Voice& voice = voices[index];
+		if ((voice.i >= voice.sample->length && (!voice.resampling || voice.tail > RESAMPLE_TAPS / 2)) //sample has finished (including resampler lookahead)
+			|| (voice.stopping && voice.volume.value == 0.0f) //sample was stopped
+			|| stream_failed(voice)) { //sample's file couldn't be read
+			finish_voice(index);
 		}
 		else {
-			++si;
+			active_voices[kept++] = index;
 		}
 	}
+	real_voice_count.store(real_count, std::memory_order_relaxed);
+	virtual_voice_count.store(active_voice_count - real_count, std::memory_order_relaxed);
+	uint32_t voice_count = active_voice_count;
+	active_voice_count = kept;
 
 	/*//DEBUG: report output power:
 	float max_power = 0.0f;
-	for (uint32_t s = 0; s < MIX_SAMPLES; ++s) {
+	for (uint32_t s = 0; s < mix_samples; ++s) {
 		max_power = std::max(max_power, (buffer[s].l * buffer[s].l + buffer[s].r * buffer[s].r));
 	}
-	std::cout << "Max Power: " << std::sqrt(max_power) << "; playing samples: " << playing_samples.size() << std::endl; //DEBUG
+	std::cout << "Max Power: " << std::sqrt(max_power) << "; playing voices: " << active_voice_count << std::endl; //DEBUG
 	*/
 
+	record_mix_stats(callback_start, voice_count);
 }
 
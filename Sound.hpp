@@ -1,11 +1,15 @@
 #pragma once
 
+#include "load_wav.hpp"
+
 #include <glm/glm.hpp>
 
-#include <memory>
+#include <array>
+#include <map>
 #include <vector>
 #include <string>
 #include <cmath>
+#include <limits>
 
 //Game audio system. Simplified from f18-base3.
 //Uses 48kHz sampling rate.
@@ -14,15 +18,80 @@ namespace Sound {
 
 	//Sample objects hold mono (one-channel) audio.
 	struct Sample {
+		//How sample data is kept in memory:
+		enum Storage : uint8_t {
+			Resident, //whole sample decoded up front
+			Streamed, //only the first half-second is decoded up front; the rest is read from disk while playing
+		};
+
+		//How resident sample data is encoded in memory:
+		// (compressed encodings are decoded on the fly while mixing)
+		enum Encoding : uint8_t {
+			Float32, //32-bit float; no decoding cost
+			Int16, //16-bit integer; half the memory
+			ADPCM4, //4-bit ADPCM; about 1/7th the memory, some added noise (fine for most effects)
+		};
+
 		//Load from a '.wav' file.
 		//  will warn and convert if sound is not already 48kHz mono:
-		Sample(std::string const& filename);
+		//  (Streamed storage needs a 48kHz PCM or float '.wav'; other files will warn and load as Resident)
+		Sample(std::string const& filename, Storage storage = Resident, Encoding encoding = Float32);
 
 		//Directly supply an audio buffer:
-		Sample(std::vector< float > const& data);
+		Sample(std::vector< float > const& data, Encoding encoding = Float32);
+
+		//View already-encoded 48kHz data held elsewhere (e.g., in a SampleBank's mapping):
+		// 'view' must stay valid and unchanged for as long as the sample exists.
+		Sample(Encoding encoding, uint32_t length, void const* view);
+
+		//sample data is stored as 48kHz, mono, in one of these, depending on encoding:
+		// (for streamed samples, this is just the beginning of the sample)
+		Encoding encoding = Float32;
+		std::vector< float > data; //Float32
+		std::vector< int16_t > data_int16; //Int16
+		std::vector< uint8_t > data_adpcm4; //ADPCM4 (blocks; see mix_kernels.hpp)
+		void const* view = nullptr; //if set, data lives here (in 'encoding' format) instead of in the vectors above
+
+		//resident data in 'encoding' format, wherever it lives:
+		float const* float_data() const { return view ? static_cast< float const* >(view) : data.data(); }
+		int16_t const* int16_data() const { return view ? static_cast< int16_t const* >(view) : data_int16.data(); }
+		uint8_t const* adpcm4_data() const { return view ? static_cast< uint8_t const* >(view) : data_adpcm4.data(); }
+
+		//number of samples held in memory:
+		uint32_t resident = 0;
+
+		//total length of the sample (== resident unless streamed):
+		uint32_t length = 0;
 
-		//sample data is stored as 48kHz, mono, floating-point:
-		std::vector< float > data;
+		//where to find the rest of the data for streamed samples:
+		std::string stream_filename;
+		WavInfo stream_info;
+		bool streamed() const { return length > resident; }
+	};
+
+	//SampleBank holds many resident samples packed in one file, which is memory-mapped when loaded:
+	// its samples are views into the mapping, so loading a bank costs one open and one map no matter how many samples it holds.
+	// (build banks with SampleBank::write, or the pack-samples utility)
+	struct SampleBank {
+		//map a bank file; throws on error:
+		SampleBank(std::string const& filename);
+		//unmaps the file -- none of the bank's samples may still be playing:
+		~SampleBank();
+		SampleBank(SampleBank const&) = delete;
+		SampleBank& operator=(SampleBank const&) = delete;
+
+		//look up a sample by name; throws if it doesn't exist:
+		Sample const& lookup(std::string const& name) const;
+		std::map< std::string, Sample > samples;
+
+		//write named (resident, not streamed) samples to a bank file, in their current encodings; throws on error:
+		static void write(std::string const& filename, std::vector< std::pair< std::string, Sample const* > > const& samples);
+
+		//internals:
+		void const* mapping = nullptr;
+		size_t mapping_size = 0;
+		void* file_handle = nullptr; //(only used on windows)
+		void* mapping_handle = nullptr; //(only used on windows)
 	};
 
 	//Ramp<> manages values that should be smoothly interpolated
@@ -49,60 +118,84 @@ namespace Sound {
 		float ramp = 0.0f;
 	};
 
-	// 'PlayingSample' objects book-keep samples that are currently playing:
+	//Interpolation used when a sample plays at a rate other than 1 (see PlayingSample::set_rate):
+	enum Interpolation : uint8_t {
+		Linear, //cheapest; some aliasing and high-frequency loss (fine for noisy or background sounds)
+		Polyphase, //band-limited 8-tap filter
+	};
+
+	// 'PlayingSample' is a handle to a sample that is (or was) playing:
+	// handles are small and cheap to copy; voice state itself lives in a fixed-size pool inside Sound.cpp.
+	// once playback finishes, the voice is recycled and the handle goes stale -- calls on stale handles are ignored.
 	struct PlayingSample {
-		//change the panning or volume of a playing sample (and do proper locking);
+		//change the panning or volume of a playing sample (queues a command for the mixer; never blocks on it);
 		// value will change over 'ramp' seconds to avoid creating audible artifacts:
-		void set_volume(float new_volume, float ramp = 1.0f / 60.0f);
+		void set_volume(float new_volume, float ramp = 1.0f / 60.0f) const;
 		//set the panning of a sample (use only on samples in "2D" mode; no effect on "3D" samples):
-		void set_pan(float new_pan, float ramp = 1.0f / 60.0f);
+		void set_pan(float new_pan, float ramp = 1.0f / 60.0f) const;
 		//set the position of a sample (use only on samples in "3D" mode; no effect on "2D" samples):
-		void set_position(glm::vec3 const& new_position, float ramp = 1.0f / 60.0f);
+		void set_position(glm::vec3 const& new_position, float ramp = 1.0f / 60.0f) const;
 		//set the half-volume radius (use only on "3D" playing sounds):
-		void set_half_volume_radius(float new_radius, float ramp = 1.0f / 60.0f);
+		void set_half_volume_radius(float new_radius, float ramp = 1.0f / 60.0f) const;
+
+		//set the playback rate (1 == normal; 2 == double speed, an octave up; clamped to [0, 4]):
+		// (for pitch shifts, Doppler, etc; once a sample's rate has changed, it is resampled for the rest of playback)
+		void set_rate(float new_rate, float ramp = 1.0f / 60.0f) const;
+		//choose how the sample is interpolated when not playing at rate 1 (default: Polyphase):
+		void set_interpolation(Interpolation interpolation) const;
+
+		//set the priority used to pick which samples are mixed when there are more audible samples than
+		// the real voice budget (see Sound::set_max_real_voices); higher wins, default is 0:
+		void set_priority(int32_t new_priority) const;
 
 		//'stop' will fade sample out over 'ramp' seconds and then remove it from the active samples:
-		void stop(float ramp = 1.0f / 60.0f);
+		void stop(float ramp = 1.0f / 60.0f) const;
+
+		//was playback stopped (either by running out of sample, or by stop())?
+		// (also true if the sample never started because every voice [or, for streamed samples, every stream] was in use)
+		bool stopped() const;
 
 		//internals:
-		//NOTE: PlayingSample is used in a separate thread; so setting these values directly
-		// may result in bad results. Instead, use the functions above, which perform locking!
-		std::vector< float > const& data; //reference to sample data being played
-		uint32_t i = 0; //next data value to read
-		bool loop = false; //should playback loop after data runs out?
-		bool stopping = false; //is playing stopping?
-		bool stopped = false; //was playback stopped (either by running out of sample, or by stop())?
-
-		Ramp< float > volume = Ramp< float >(1.0f);
-
-		//2D playback panning control: ('NaN' if sound played in 3D mode)
-		Ramp< float > pan = Ramp< float >(std::numeric_limits< float >::quiet_NaN());
-
-		//3D playback panning control: ('NaN' if sound played in 2D mode)
-		Ramp< glm::vec3 > position = Ramp< glm::vec3 >(std::numeric_limits< float >::quiet_NaN());
-		Ramp< float > half_volume_radius = std::numeric_limits< float >::quiet_NaN();
-
-		PlayingSample(Sample const& sample_, float volume_, float pan_, bool loop_)
-			: data(sample_.data), loop(loop_), volume(volume_), pan(pan_) { }
-		PlayingSample(Sample const& sample_, float volume_, glm::vec3 const& position_, float half_volume_radius_, bool loop_)
-			: data(sample_.data), loop(loop_), volume(volume_), position(position_), half_volume_radius(half_volume_radius_) { }
+		uint32_t voice = -1U; //index of voice in the pool
+		uint32_t generation = 0; //voice's generation when playback started; changes when the voice is recycled
 	};
 
 	// ------- global functions -------
 
-	void init(); //call Sound::init() from main.cpp before using any member functions
+	//call Sound::init() from main.cpp before using any member functions:
+	// 'max_voices' is the number of samples that may play at once; the voice pool is allocated here,
+	// so starting or finishing playback never allocates memory. (play* when all voices are in use does nothing.)
+	// 'mix_workers' is the number of extra threads that help mix when many voices are playing
+	// (-1U picks based on the number of cores; 0 mixes everything on the audio thread).
+	// 'block_samples' is the mixer block size (128, 256, 512, or 1024; throws otherwise): new sounds and parameter
+	// changes take effect at block boundaries, so smaller blocks respond faster (128 samples is 2.7ms, 1024 is 21ms),
+	// at the cost of more per-block overhead and less slack before the device runs dry.
+	void init(uint32_t max_voices = 256, uint32_t mix_workers = -1U, uint32_t block_samples = 1024);
 
 	void shutdown(); //call Sound::shutdown() from main.cpp to gracefully(-ish) exit
 
+	//Offline mode (for benchmarks, regression tests, and rendering audio to files):
+	// call Sound::init_offline() instead of Sound::init() -- no audio device is opened, and nothing is mixed
+	// until Sound::render() is called. Streamed samples are read synchronously, so output is deterministic.
+	void init_offline(uint32_t max_voices = 256, uint32_t mix_workers = -1U, uint32_t block_samples = 1024);
+	//mix the next 'frames' frames of 48kHz stereo (interleaved left, right) into 'out' [offline mode only]:
+	// (commands queued by play/set_*/stop take effect at the next mixer block boundary, just like real-time mode)
+	void render(float* out, uint32_t frames);
+	//number of frames rendered since Sound::init_offline():
+	uint64_t get_rendered_frames();
+
+	//NOTE: the play/set_*/stop functions below talk to the mixer through single-producer, single-consumer
+	// queues, so they should all be called from the same (game) thread.
+
 	//Call 'Sound::play' to play a sample once.
 	//  if you hang on to the return value, you can change the panning, volume, or stop playback early.
-	std::shared_ptr< PlayingSample > play(
+	PlayingSample play(
 		Sample const& sample,
 		float volume = 1.0f,
 		float pan = 0.0f //-1.0f == hard left, 1.0f == hard right
 	);
 	//The play_3D version will play a sample in '3D' mode (that is, panning determined by listener position):
-	std::shared_ptr< PlayingSample > play_3D(
+	PlayingSample play_3D(
 		Sample const& sample,
 		float volume,
 		glm::vec3 const& position,
@@ -111,13 +204,13 @@ namespace Sound {
 
 	//Call 'Sound::loop' to play a sample ~forever~.
 	//  if you hang on to the return value, you can change the panning, volume, or stop playback.
-	std::shared_ptr< PlayingSample > loop(
+	PlayingSample loop(
 		Sample const& sample,
 		float volume = 1.0f,
 		float pan = 0.0f //-1.0f == hard left, 1.0f == hard right
 	);
 	//The loop_3D version will loop a sample in '3D' mode (that is, panning determined by listener position):
-	std::shared_ptr< PlayingSample > loop_3D(
+	PlayingSample loop_3D(
 		Sample const& sample,
 		float volume,
 		glm::vec3 const& position,
@@ -137,13 +230,81 @@ namespace Sound {
 	//"panic button" to shut off all currently playing sounds:
 	void stop_all_samples();
 
+	//limit the number of samples actually mixed each block (default: 64):
+	// samples that are inaudible, or that lose out on priority/loudness, are "virtual" --
+	// their playback position keeps advancing, but they aren't mixed until they win a slot again.
+	void set_max_real_voices(uint32_t count);
+
+	//number of samples mixed / virtualized during the most recent mixer block:
+	uint32_t get_real_voice_count();
+	uint32_t get_virtual_voice_count();
+
+	//mix 3D samples through a first-order ambisonic bus (default: off):
+	// each 3D sample is encoded into four B-format channels, and the bus is decoded to stereo once per block.
+	// (2D samples are panned directly either way. With stereo output, encoding four channels per sample costs more than
+	//  panning two; the bus pays off when the decode is expensive. Centered sources come out about 3dB quieter than panned.)
+	void set_ambisonics(bool enabled);
+
+	//decode the ambisonic bus binaurally (for headphones) using head-related impulse responses from a '.hrtf' file,
+	// instead of the stereo decode above; "" goes back to the stereo decode.
+	// Loads (and allocates) on the calling thread, throws on error, and keeps the data until Sound::shutdown.
+	// (world +z is taken to be up; see make-hrtf.py for the file format)
+	void set_hrtf(std::string const& filename);
+
+	//Mixer timing statistics, gathered by the audio callback:
+	struct MixStats {
+		//histogram of time spent in the audio callback, in half-octave bins:
+		// bin b counts callbacks that took [timing_bin_start(b), timing_bin_start(b+1)) microseconds
+		// (the last bin also counts anything slower)
+		static constexpr uint32_t TimingBins = 32;
+		static float timing_bin_start(uint32_t bin);
+		std::array< uint32_t, TimingBins > timing_histogram;
+
+		uint64_t callbacks = 0;
+		float budget = 0.0f; //microseconds of audio produced per callback -- the deadline
+		float average_time = 0.0f; //microseconds spent per callback
+		float max_time = 0.0f;
+
+		//playing (real + virtual) voices per callback:
+		float average_voices = 0.0f;
+		uint32_t peak_voices = 0;
+
+		//callbacks that started more than 1.5x the buffer period after the previous one (likely underruns):
+		// (not counted in offline mode)
+		uint32_t underruns = 0;
+		float max_gap = 0.0f; //microseconds between callbacks
+
+		//latency from Sound::play* to the start of the block that mixes the sample (measured; microseconds):
+		uint32_t plays = 0;
+		float average_play_latency = 0.0f;
+		float max_play_latency = 0.0f;
+		//...plus the time until that block is heard (estimated from the device's buffer size, not counting
+		// any OS or driver buffering; 0 in offline mode). End-to-end latency is about play latency + output latency.
+		float output_latency = 0.0f;
+
+		//cost of each convolved stream (the binaural decode's four channels, when an HRTF is in use):
+		struct Convolution {
+			std::string name;
+			uint32_t partitions = 0; //pieces the impulse response is split into
+			uint64_t blocks = 0; //blocks convolved
+			float average_time = 0.0f; //microseconds per block
+			float max_time = 0.0f;
+		};
+		std::vector< Convolution > convolutions;
+	};
+	//read stats gathered since init (or the last reset); safe to call from any thread:
+	MixStats get_mix_stats();
+	void reset_mix_stats();
+	//write stats to a '.csv' file (summary values, convolution costs, then the histogram); throws on error:
+	void save_mix_stats_csv(std::string const& filename, MixStats const& stats);
+
 	//set global volume:
 	void set_volume(float new_volume, float ramp = 1.0f / 60.0f);
 	extern Ramp< float > volume;
 
 	//the audio callback doesn't run between Sound::lock() and Sound::unlock()
-	// the set_*/stop/play/... functions already use these helpers, so you shouldn't need
-	// to call them unless your code is modifying values directly:
+	// the set_*/stop/play/... functions don't need these helpers (they queue commands instead),
+	// so you shouldn't need to call them unless your code is modifying values directly:
 	void lock();
 	void unlock();
 
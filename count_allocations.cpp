@@ -0,0 +1,29 @@
+#include "count_allocations.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+//n.b. these live in their own file so that callers can't inline them (compilers warn about
+// pairing 'free' with 'operator new' when they can see both).
+
+static std::atomic< uint64_t > allocations(0);
+
+uint64_t get_allocation_count() {
+	return allocations.load(std::memory_order_relaxed);
+}
+
+//(replacing the global operator new/delete is allowed; the array forms forward to these)
+void *operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
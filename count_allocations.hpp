@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+//Counts heap allocations, for tools that check code doesn't allocate (e.g., render-audio --stress):
+// count_allocations.cpp replaces the global operator new and delete, so it affects the whole program
+// that links it -- link it into tools only, not the game.
+
+//number of calls to operator new (from any thread) so far:
+uint64_t get_allocation_count();
@@ -3,6 +3,9 @@
 #include <iostream>
 #include <vector>
 #include <sstream>
+#include <memory>
+#include <cstring>
+#include <cstdlib>
 
 #if defined(_WIN32)
 #include <windows.h>
@@ -12,6 +15,7 @@
 #include <io.h>
 #elif defined(__APPLE__)
 #include <mach-o/dyld.h>
+#include <sys/stat.h>
 #elif defined(__linux__)
 #include <unistd.h>
 #include <sys/stat.h>
@@ -62,7 +66,7 @@ std::string data_path(std::string const &suffix) {
 	return path + "/" + suffix;
 }
 
-/* From Rktcr; to be used eventually!
+//From Rktcr: find (and create, if needed) a per-user directory for the application:
 static std::string make_user_dir(std::string const &app_name) {
 	std::string ret = "";
 	#if defined(_WIN32)
@@ -75,7 +79,7 @@ static std::string make_user_dir(std::string const &app_name) {
 			if (WideCharToMultiByte(CP_UTF8, 0, path, -1, temp.get(), needed, NULL, NULL) != 0) {
 				if (temp.get()[needed-1] != '\0') {
 					temp.get()[needed-1] = '\0'; //"fix it"
-					LOG_ERROR("!!!! Woah, missing '\\0' terminator in converted string: " << temp.get());
+					std::cerr << "!!!! Woah, missing '\\0' terminator in converted string: " << temp.get() << std::endl;
 				} else {
 					ret = temp.get();
 				}
@@ -84,7 +88,7 @@ static std::string make_user_dir(std::string const &app_name) {
 		CoTaskMemFree(path);
 		path = NULL;
 	} else {
-		LOG_WARNING("Unable to locate FOLDERID_Documents.");
+		std::cerr << "Unable to locate FOLDERID_Documents; using current directory as user directory." << std::endl;
 		ret = ".";
 	}
 	if (ret.empty() || ret[ret.size()-1] != '/') {
@@ -94,7 +98,7 @@ static std::string make_user_dir(std::string const &app_name) {
 	#elif defined(__APPLE__) || defined(__linux__)
 	char *var = getenv("HOME");
 	if (var == NULL) {
-		std::cerr << "Environment variable 'HOME' is not set; using current directory as data directory" << std::endl;
+		std::cerr << "Environment variable 'HOME' is not set; using current directory as user directory." << std::endl;
 		ret = ".";
 	} else {
 		ret = var;
@@ -108,10 +112,8 @@ static std::string make_user_dir(std::string const &app_name) {
 	#endif
 
 	//Make sure directory exists... or at least try to!
-	#ifdef WINDOWS
+	#if defined(_WIN32)
 	_mkdir(ret.c_str());
-	#elif defined(MINGW)
-	mkdir(ret.c_str());
 	#else
 	mkdir(ret.c_str(), 0755);
 	#endif
@@ -120,7 +122,6 @@ static std::string make_user_dir(std::string const &app_name) {
 }
 
 std::string user_path(std::string const &suffix) {
-	static std::string path = make_user_dir( ... TODO ... );
-	return path + '/' + suffix;
+	static std::string path = make_user_dir("gp21-game2"); //cache result of make_user_dir()
+	return path + "/" + suffix;
 }
-*/
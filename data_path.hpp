@@ -5,3 +5,7 @@
 //construct a path based on the location of the currently-running executable:
 // (e.g. if running /home/ix/game0/game.exe will return '/home/ix/game0/' + suffix)
 std::string data_path(std::string const &suffix);
+
+//construct a path in a per-user, writable directory (e.g. '~/.gp21-game2/' + suffix), creating the directory if needed:
+// (for files the game writes, like caches, which might not be writable next to the executable)
+std::string user_path(std::string const &suffix);
@@ -0,0 +1,76 @@
+#include "draw_mix_stats.hpp"
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+void draw_mix_stats(DrawLines &lines, Sound::MixStats const &stats,
+	glm::vec3 const &anchor, glm::vec3 const &x, glm::vec3 const &y) {
+
+	glm::u8vec4 const frame_color(0x88, 0x88, 0x88, 0xff);
+	glm::u8vec4 const bar_color(0xff, 0xff, 0xff, 0xff);
+	glm::u8vec4 const deadline_color(0xff, 0x44, 0x44, 0xff);
+	glm::u8vec4 const text_color(0xff, 0xff, 0x88, 0xff);
+
+	//layout: histogram in the lower 60% of the box, three lines of text above it:
+	glm::vec3 const graph_y = 0.6f * y;
+	float const text_height = 0.1f;
+	glm::vec3 const text_x = (glm::length(x) > 0.0f ? glm::normalize(x) : glm::vec3(1.0f, 0.0f, 0.0f)) * (text_height * glm::length(y));
+	glm::vec3 const text_y = text_height * y;
+
+	//frame around the histogram:
+	lines.draw(anchor, anchor + x, frame_color);
+	lines.draw(anchor + x, anchor + x + graph_y, frame_color);
+	lines.draw(anchor + x + graph_y, anchor + graph_y, frame_color);
+	lines.draw(anchor + graph_y, anchor, frame_color);
+
+	//histogram bars (log scale, so rare slow callbacks still show up):
+	uint32_t most = *std::max_element(stats.timing_histogram.begin(), stats.timing_histogram.end());
+	float const scale = (most > 0 ? 1.0f / std::log2(1.0f + float(most)) : 0.0f);
+	for (uint32_t b = 0; b < Sound::MixStats::TimingBins; ++b) {
+		uint32_t count = stats.timing_histogram[b];
+		if (count == 0) continue;
+		float height = std::log2(1.0f + float(count)) * scale;
+		float across = (b + 0.5f) / float(Sound::MixStats::TimingBins);
+		lines.draw(anchor + across * x, anchor + across * x + height * graph_y, bar_color);
+	}
+
+	//deadline marker, at the point in the (half-octave) bins where the budget falls:
+	if (stats.budget > 1.0f) {
+		float across = std::min(1.0f, 2.0f * std::log2(stats.budget) / float(Sound::MixStats::TimingBins));
+		lines.draw(anchor + across * x, anchor + across * x + graph_y, deadline_color);
+	}
+
+	//summary text:
+	auto ms = [](float us) {
+		std::ostringstream str;
+		str << std::fixed << std::setprecision(2) << (us / 1000.0f) << "ms";
+		return str.str();
+	};
+	std::ostringstream voices;
+	voices << std::fixed << std::setprecision(1) << stats.average_voices;
+
+	std::string text[3] = {
+		"mix " + ms(stats.average_time) + " avg, " + ms(stats.max_time) + " max of " + ms(stats.budget),
+		"voices " + voices.str() + " avg, " + std::to_string(stats.peak_voices) + " peak",
+		"underruns " + std::to_string(stats.underruns) + " (longest gap " + ms(stats.max_gap) + ")",
+	};
+	for (uint32_t l = 0; l < 3; ++l) {
+		glm::vec3 at = anchor + (0.65f + 0.12f * float(2 - l)) * y;
+		lines.draw_text(text[l], at, text_x, text_y, text_color);
+	}
+
+	//latency and convolution cost (summed over streams; per-stream costs are in the .csv), under the histogram:
+	std::string latency = "play latency " + ms(stats.average_play_latency) + " avg, " + ms(stats.max_play_latency) + " max (+" + ms(stats.output_latency) + " out)";
+	lines.draw_text(latency, anchor - 0.12f * y, text_x, text_y, text_color);
+	if (!stats.convolutions.empty()) {
+		float average = 0.0f, max = 0.0f;
+		for (auto const &convolution : stats.convolutions) {
+			average += convolution.average_time;
+			max += convolution.max_time;
+		}
+		std::string line = "convolution " + std::to_string(stats.convolutions.size()) + " streams, " + ms(average) + " avg, " + ms(max) + " max";
+		lines.draw_text(line, anchor - 0.24f * y, text_x, text_y, text_color);
+	}
+}
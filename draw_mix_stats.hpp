@@ -0,0 +1,11 @@
+#pragma once
+
+#include "DrawLines.hpp"
+#include "Sound.hpp"
+
+//Draw a small overlay showing mixer timing (see Sound::get_mix_stats) using DrawLines:
+// the overlay fills the box with corner 'anchor' and sides 'x' and 'y'; text is sized relative to 'y'.
+// Shows a histogram of callback times (with a red line at the deadline) under a few lines of summary text,
+// plus (just below the box) play latency and the cost of any convolution streams.
+void draw_mix_stats(DrawLines &lines, Sound::MixStats const &stats,
+	glm::vec3 const &anchor, glm::vec3 const &x, glm::vec3 const &y);
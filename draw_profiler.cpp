@@ -0,0 +1,120 @@
+#include "draw_profiler.hpp"
+
+#include "gl_state.hpp"
+
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+void draw_profiler(DrawLines &lines, Profiler::History const &history,
+	glm::vec3 const &anchor, glm::vec3 const &x, glm::vec3 const &y) {
+
+	glm::u8vec4 const frame_color(0x88, 0x88, 0x88, 0xff);
+	glm::u8vec4 const cpu_color(0xff, 0xff, 0xff, 0xff);
+	glm::u8vec4 const gpu_color(0x44, 0xff, 0x44, 0xff);
+	glm::u8vec4 const target_color(0xff, 0x44, 0x44, 0xff);
+	glm::u8vec4 const text_color(0xff, 0xff, 0x88, 0xff);
+
+	//layout: graph in the lower 45% of the box, one line of text per scope above it:
+	glm::vec3 const graph_y = 0.45f * y;
+	float const text_height = std::min(0.1f, 0.5f / float(history.names.size() + 1));
+	glm::vec3 const text_x = (glm::length(x) > 0.0f ? glm::normalize(x) : glm::vec3(1.0f, 0.0f, 0.0f)) * (text_height * glm::length(y));
+	glm::vec3 const text_y = text_height * y;
+
+	//frame around the graph:
+	lines.draw(anchor, anchor + x, frame_color);
+	lines.draw(anchor + x, anchor + x + graph_y, frame_color);
+	lines.draw(anchor + x + graph_y, anchor + graph_y, frame_color);
+	lines.draw(anchor + graph_y, anchor, frame_color);
+
+	//graph scale: at least 30fps worth of time, more if frames are slower than that:
+	float top_ms = 1000.0f / 30.0f * 1.25f;
+	for (auto const &frame : history.frames) {
+		top_ms = std::max(top_ms, std::max(frame.cpu_ms[0], frame.gpu_ms[0]));
+	}
+
+	//60 and 30 fps lines:
+	for (float fps : {60.0f, 30.0f}) {
+		glm::vec3 at = anchor + (1000.0f / fps / top_ms) * graph_y;
+		lines.draw(at, at + x, target_color);
+	}
+
+	//whole-frame times, oldest at the left:
+	auto plot = [&](std::vector< float > Profiler::Frame::*times, glm::u8vec4 const &color) {
+		for (uint32_t f = 1; f < history.frames.size(); ++f) {
+			float a = (history.frames[f-1].*times)[0] / top_ms;
+			float b = (history.frames[f].*times)[0] / top_ms;
+			lines.draw(
+				anchor + (float(f-1) / float(Profiler::History::Frames - 1)) * x + a * graph_y,
+				anchor + (float(f) / float(Profiler::History::Frames - 1)) * x + b * graph_y,
+				color);
+		}
+	};
+	plot(&Profiler::Frame::cpu_ms, cpu_color);
+	plot(&Profiler::Frame::gpu_ms, gpu_color);
+
+	//average time per scope (over the frames in which it ran), indented by nesting depth:
+	std::vector< float > cpu_total(history.names.size(), 0.0f);
+	std::vector< float > gpu_total(history.names.size(), 0.0f);
+	std::vector< uint32_t > count(history.names.size(), 0);
+	for (auto const &frame : history.frames) {
+		for (uint32_t n = 0; n < frame.cpu_ms.size(); ++n) {
+			if (frame.cpu_ms[n] < 0.0f) continue;
+			cpu_total[n] += frame.cpu_ms[n];
+			gpu_total[n] += frame.gpu_ms[n];
+			count[n] += 1;
+		}
+	}
+
+	glm::vec3 at = anchor + y - 1.1f * text_y;
+	lines.draw_text("ms (avg over " + std::to_string(history.frames.size()) + " frames): cpu / gpu", at, text_x, text_y, text_color);
+	for (uint32_t n = 0; n < history.names.size(); ++n) {
+		at -= 1.1f * text_y;
+		std::ostringstream str;
+		str << std::string(2 * history.depths[n], ' ') << history.names[n] << " ";
+		if (count[n] > 0) {
+			str << std::fixed << std::setprecision(2) << cpu_total[n] / count[n] << " / " << gpu_total[n] / count[n];
+		} else {
+			str << "-";
+		}
+		lines.draw_text(str.str(), at, text_x, text_y, text_color);
+	}
+}
+
+bool profiler_handle_event(SDL_Event const &evt) {
+	if (evt.type != SDL_KEYDOWN) return false;
+	if (evt.key.keysym.sym == SDLK_F1) {
+		// --- frame profiler overlay toggle ---
+		Profiler::show = !Profiler::show;
+		return true;
+	} else if (evt.key.keysym.sym == SDLK_F2) {
+		// --- frame profiler dump ---
+		try {
+			Profiler::save_csv("frame-profile.csv");
+			std::cout << "Wrote frame profile to 'frame-profile.csv'." << std::endl;
+		} catch (std::exception &e) {
+			std::cerr << e.what() << std::endl;
+		}
+		return true;
+	}
+	return false;
+}
+
+void draw_profiler_overlay(glm::uvec2 const &drawable_size) {
+	if (!Profiler::show) return;
+	Profiler::Scope scope("profiler");
+	//draw the mode's batched lines with the depth test they expect before turning it off:
+	DrawLines::flush();
+	gl_enable(GL_DEPTH_TEST, false);
+	float aspect = float(drawable_size.x) / float(drawable_size.y);
+	DrawLines lines(glm::mat4(
+		1.0f / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	));
+	draw_profiler(lines, Profiler::get_history(),
+		glm::vec3(-aspect + 0.1f, -0.2f, 0.0f),
+		glm::vec3(1.3f, 0.0f, 0.0f), glm::vec3(0.0f, 1.1f, 0.0f));
+}
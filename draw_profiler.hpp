@@ -0,0 +1,23 @@
+#pragma once
+
+#include "DrawLines.hpp"
+#include "Profiler.hpp"
+
+#include <SDL.h>
+
+//Draw a small overlay showing frame timing (see Profiler::get_history) using DrawLines:
+// the overlay fills the box with corner 'anchor' and sides 'x' and 'y'; text is sized relative to 'y'.
+// Shows a graph of recent whole-frame CPU (white) and GPU (green) times, with lines at 60 and 30 fps,
+// under the average time of each scope.
+void draw_profiler(DrawLines &lines, Profiler::History const &history,
+	glm::vec3 const &anchor, glm::vec3 const &x, glm::vec3 const &y);
+
+//The profiler's controls, shared by the main loops (main.cpp, show-meshes.cpp, show-scene.cpp):
+
+//F1 toggles the overlay (Profiler::show); F2 saves recent frames to 'frame-profile.csv'.
+// returns true if 'evt' was one of those keys:
+bool profiler_handle_event(SDL_Event const &evt);
+
+//if Profiler::show is set, draw the overlay on the left side of the window (in a "profiler" scope):
+// (call after the mode draws and before DrawLines::end_frame)
+void draw_profiler_overlay(glm::uvec2 const &drawable_size);
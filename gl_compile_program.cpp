@@ -1,16 +1,128 @@
 #include "gl_compile_program.hpp"
 
+#include "data_path.hpp"
+#include "gl_extensions.hpp"
+#include "read_write_chunk.hpp"
+
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+
+//Linked programs are cached on disk (in user_path) using GL_ARB_get_program_binary (core in GL 4.1), when the
+// driver supports it and offers at least one binary format.
+//
+//Cache files are named by a hash of the key -- the driver's vendor, renderer, and version strings plus the
+// shader sources -- and contain (as chunks, see read_write_chunk.hpp):
+// 'pgk0' -- the whole key (chars), so a hash collision or a driver update is a cache miss rather than a bad load
+// 'pgf0' -- the binary format (one uint32_t)
+// 'pgb0' -- the program binary (bytes)
+//If the driver rejects a cached binary, the program is compiled from source and the cache file is rewritten.
+//
+//Programs compiled from source are only checked for errors in gl_finish_programs, so the driver can work on
+// all submitted programs at once. With GL_KHR_parallel_shader_compile, the driver is also asked to use as many
+// compiler threads as it likes.
+
+//(not in GL.hpp, since it only covers GL 3.3:)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_PROGRAM_BINARY_FORMATS
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+typedef void (APIENTRY *GetProgramBinaryFn)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void (APIENTRY *ProgramBinaryFn)(GLuint program, GLenum binaryFormat, void const *binary, GLsizei length);
+typedef void (APIENTRY *ProgramParameteriFn)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRY *MaxShaderCompilerThreadsFn)(GLuint count);
+
+namespace {
+	struct ProgramExtensions {
+		bool binary_cache = false; //can programs be cached? (parallel compiling is set up regardless)
+		GetProgramBinaryFn get_program_binary = nullptr;
+		ProgramBinaryFn program_binary = nullptr;
+		ProgramParameteriFn program_parameteri = nullptr;
+		std::vector< GLint > formats; //binary formats the driver will accept
+		std::string driver; //vendor, renderer, and version strings (the first part of every key)
+
+		//looked up on first use, since that's when there is sure to be a GL context:
+		static ProgramExtensions &get() {
+			static ProgramExtensions extensions;
+			return extensions;
+		}
+
+		ProgramExtensions() {
+			//let the driver use as many compiler threads as it likes (rather than its default, which may be none):
+			MaxShaderCompilerThreadsFn max_shader_compiler_threads = nullptr;
+			if (gl_has_extension("GL_KHR_parallel_shader_compile")) {
+				max_shader_compiler_threads = (MaxShaderCompilerThreadsFn)gl_get_proc_address("glMaxShaderCompilerThreadsKHR");
+			} else if (gl_has_extension("GL_ARB_parallel_shader_compile")) {
+				max_shader_compiler_threads = (MaxShaderCompilerThreadsFn)gl_get_proc_address("glMaxShaderCompilerThreadsARB");
+			}
+			if (max_shader_compiler_threads) max_shader_compiler_threads(0xffffffff); //(= as many as the driver wants)
+
+			if (!gl_has_extension("GL_ARB_get_program_binary")) return;
+			get_program_binary = (GetProgramBinaryFn)gl_get_proc_address("glGetProgramBinary");
+			program_binary = (ProgramBinaryFn)gl_get_proc_address("glProgramBinary");
+			program_parameteri = (ProgramParameteriFn)gl_get_proc_address("glProgramParameteri");
+			if (!get_program_binary || !program_binary || !program_parameteri) return;
+
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+			if (count <= 0) return; //(e.g., Mesa built without its shader cache)
+			formats.assign(count, 0);
+			glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+
+			for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+				GLubyte const *str = glGetString(name);
+				driver += (str ? reinterpret_cast< char const * >(str) : "");
+				driver += '\n';
+			}
+			binary_cache = true;
+		}
+	};
 
-static GLuint gl_compile_shader(GLenum type, std::string const &source) {
+	//64-bit FNV-1a hash, as hex:
+	std::string hash_hex(std::string const &key) {
+		uint64_t hash = 0xcbf29ce484222325ULL;
+		for (char c : key) {
+			hash = (hash ^ uint8_t(c)) * 0x100000001b3ULL;
+		}
+		char hex[17];
+		for (uint32_t i = 0; i < 16; ++i) {
+			hex[i] = "0123456789abcdef"[(hash >> (60 - 4 * i)) & 0xf];
+		}
+		hex[16] = '\0';
+		return hex;
+	}
+
+	//programs submitted but not yet checked by gl_finish_programs:
+	struct PendingProgram {
+		GLuint program;
+		GLuint vertex_shader, fragment_shader;
+		std::string key, path; //for the cache (empty if not caching)
+	};
+	std::vector< PendingProgram > pending;
+}
+
+static GLuint gl_submit_shader(GLenum type, std::string const &source) {
 	GLuint shader = glCreateShader(type);
 	GLchar const *str = source.c_str();
 	GLint length = GLint(source.size());
 	glShaderSource(shader, 1, &str, &length);
 	glCompileShader(shader);
+	return shader;
+}
+
+//returns false (after printing the info log) if shader failed to compile:
+static bool gl_check_shader(GLuint shader) {
 	GLint compile_status = GL_FALSE;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &compile_status);
 	if (compile_status != GL_TRUE) {
@@ -21,42 +133,140 @@ static GLuint gl_compile_shader(GLenum type, std::string const &source) {
 		GLsizei length = 0;
 		glGetShaderInfoLog(shader, GLint(info_log.size()), &length, &info_log[0]);
 		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
-		glDeleteShader(shader);
-		throw std::runtime_error("Failed to compile shader.");
+		return false;
+	}
+	return true;
+}
+
+//returns false (after printing the info log) if program failed to link:
+static bool gl_check_program(GLuint program) {
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE) {
+		std::cerr << "Failed to link shader program." << std::endl;
+		GLint info_log_length = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);
+		std::vector< GLchar > info_log(info_log_length, 0);
+		GLsizei length = 0;
+		glGetProgramInfoLog(program, GLint(info_log.size()), &length, &info_log[0]);
+		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
+		return false;
+	}
+	return true;
+}
+
+//try to load a program from the cache; returns 0 on a miss (or if the driver rejects the binary):
+static GLuint load_cached_program(ProgramExtensions const &ext, std::string const &path, std::string const &key) {
+	std::vector< char > file_key;
+	std::vector< uint32_t > format;
+	std::vector< uint8_t > binary;
+	try {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) return 0; //(not cached yet)
+		read_chunk(file, "pgk0", &file_key);
+		read_chunk(file, "pgf0", &format);
+		read_chunk(file, "pgb0", &binary);
+	} catch (std::exception const &e) {
+		std::cerr << "WARNING: ignoring unreadable program cache file '" << path << "': " << e.what() << std::endl;
+		return 0;
+	}
+	if (file_key.size() != key.size() || !std::equal(file_key.begin(), file_key.end(), key.begin())) return 0;
+	if (format.size() != 1 || std::find(ext.formats.begin(), ext.formats.end(), GLint(format[0])) == ext.formats.end()) return 0;
+
+	GLuint program = glCreateProgram();
+	ext.program_binary(program, GLenum(format[0]), binary.data(), GLsizei(binary.size()));
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE) {
+		std::cerr << "Cached program binary '" << path << "' was rejected by the driver; compiling from source." << std::endl;
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+static void store_cached_program(ProgramExtensions const &ext, std::string const &path, std::string const &key, GLuint program) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+	std::vector< uint8_t > binary(length);
+	GLenum format = 0;
+	GLsizei got = 0;
+	ext.get_program_binary(program, length, &got, &format, binary.data());
+	binary.resize(got);
+
+	std::ofstream file(path, std::ios::binary);
+	write_chunk("pgk0", std::vector< char >(key.begin(), key.end()), &file);
+	write_chunk("pgf0", std::vector< uint32_t >(1, format), &file);
+	write_chunk("pgb0", binary, &file);
+	if (!file) {
+		std::cerr << "WARNING: failed to write program cache file '" << path << "'." << std::endl;
 	}
-	return shader;
 }
 
 GLuint gl_compile_program(
 	std::string const &vertex_shader_source,
 	std::string const &fragment_shader_source
 	) {
+	GLuint program = gl_submit_program(vertex_shader_source, fragment_shader_source);
+	gl_finish_programs();
+	return program;
+}
+
+GLuint gl_submit_program(
+	std::string const &vertex_shader_source,
+	std::string const &fragment_shader_source
+	) {
 
-	GLuint vertex_shader = gl_compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
-	GLuint fragment_shader = gl_compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
+	ProgramExtensions const &ext = ProgramExtensions::get();
+	std::string key, path;
+	if (ext.binary_cache) {
+		key = ext.driver + vertex_shader_source + '\0' + fragment_shader_source;
+		path = user_path("program-" + hash_hex(key) + ".cache");
+		//(cached programs are already linked and checked, so they don't need to wait for gl_finish_programs)
+		if (GLuint program = load_cached_program(ext, path, key)) return program;
+	}
+
+	GLuint vertex_shader = gl_submit_shader(GL_VERTEX_SHADER, vertex_shader_source);
+	GLuint fragment_shader = gl_submit_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
 
 	GLuint program = glCreateProgram();
 	glAttachShader(program, vertex_shader);
 	glAttachShader(program, fragment_shader);
 
-	//shaders are reference counted so this makes sure they are freed after program is deleted:
-	glDeleteShader(vertex_shader);
-	glDeleteShader(fragment_shader);
+	//ask the driver to keep the binary around for the cache:
+	if (ext.binary_cache) ext.program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
-	//link the shader program and throw errors if linking fails:
+	//link without waiting -- errors are checked in gl_finish_programs:
 	glLinkProgram(program);
-	GLint link_status = GL_FALSE;
-	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
-	if (link_status != GL_TRUE) {
-		std::cerr << "Failed to link shader program." << std::endl;
-		GLint info_log_length = 0;
-		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);
-		std::vector< GLchar > info_log(info_log_length, 0);
-		GLsizei length = 0;
-		glGetProgramInfoLog(program, GLint(info_log.size()), &length, &info_log[0]);
-		std::cerr << "Info log: " << std::string(info_log.begin(), info_log.begin() + length);
-		throw std::runtime_error("failed to link program");
-	}
+
+	pending.emplace_back(PendingProgram{program, vertex_shader, fragment_shader, key, path});
 
 	return program;
 }
+
+void gl_finish_programs() {
+	ProgramExtensions const &ext = ProgramExtensions::get();
+
+	std::vector< PendingProgram > finishing;
+	finishing.swap(pending);
+
+	//check every program (so all errors are reported), then throw for the first failure:
+	std::string error;
+	for (auto const &p : finishing) {
+		if (!gl_check_shader(p.vertex_shader) || !gl_check_shader(p.fragment_shader)) {
+			if (error.empty()) error = "Failed to compile shader.";
+		} else if (!gl_check_program(p.program)) {
+			if (error.empty()) error = "failed to link program";
+		} else if (!p.path.empty()) {
+			store_cached_program(ext, p.path, p.key, p.program);
+		}
+
+		//shaders are reference counted so this makes sure they are freed after program is deleted:
+		glDeleteShader(p.vertex_shader);
+		glDeleteShader(p.fragment_shader);
+	}
+	if (!error.empty()) {
+		throw std::runtime_error(error);
+	}
+}
@@ -6,6 +6,17 @@
 
 //compiles+links an OpenGL shader program from source.
 // throws on compilation error.
+// (linked programs are cached on disk, where the driver supports it, so later runs can skip compiling)
 GLuint gl_compile_program(
 	std::string const &vertex_shader_source,
 	std::string const &fragment_shader_source);
+
+//Batched version of the above, so the driver can compile and link many programs at once:
+// gl_submit_program starts compiling+linking and returns the program without waiting for (or checking) the result.
+// gl_finish_programs waits for all submitted programs; it throws if any failed to compile or link.
+//The Load<...Program>s submit their programs at LoadTagShaders and call gl_finish_programs before looking up
+// locations at LoadTagEarly. (see ColorProgram.cpp)
+GLuint gl_submit_program(
+	std::string const &vertex_shader_source,
+	std::string const &fragment_shader_source);
+void gl_finish_programs();
@@ -0,0 +1,208 @@
+#include "gl_debug.hpp"
+
+#include "gl_extensions.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+//(not in GL.hpp, since it only covers GL 3.3:)
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#endif
+#ifndef GL_DEBUG_OUTPUT_SYNCHRONOUS
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#endif
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+typedef void (APIENTRY *DebugProc)(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, GLchar const *message, void const *user);
+typedef void (APIENTRY *DebugMessageCallbackFn)(DebugProc callback, void const *user);
+typedef void (APIENTRY *DebugMessageControlFn)(GLenum source, GLenum type, GLenum severity, GLsizei count, GLuint const *ids, GLboolean enabled);
+typedef void (APIENTRY *ObjectLabelFn)(GLenum identifier, GLuint name, GLsizei length, GLchar const *label);
+static ObjectLabelFn object_label = nullptr; //nullptr if debug output isn't enabled
+
+namespace {
+	//A message, as copied out of the callback:
+	struct Message {
+		GLenum source = 0;
+		GLenum type = 0;
+		GLenum severity = 0;
+		GLuint id = 0;
+		uint32_t length = 0;
+		std::array< char, 244 > text; //(truncated if longer)
+	};
+
+	//Bounded multi-producer [driver threads] / single-consumer [gl_debug_flush] ring of messages:
+	// producers claim a slot by advancing 'write'; each slot's 'sequence' says whether it is free for
+	// the write with that index (sequence == index) or holds that write's message (sequence == index + 1).
+	// If the ring is full, messages are dropped (and counted) rather than waiting.
+	struct Log {
+		static constexpr uint32_t Size = 256;
+		struct Slot {
+			std::atomic< uint64_t > sequence;
+			Message message;
+		};
+		std::array< Slot, Size > slots;
+		std::atomic< uint64_t > write{0};
+		uint64_t read = 0; //(consumer only)
+		std::atomic< uint32_t > dropped{0};
+
+		Log() {
+			for (uint32_t i = 0; i < Size; ++i) {
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		void push(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, GLchar const *text) {
+			uint64_t index = write.load(std::memory_order_relaxed);
+			Slot *slot;
+			while (true) {
+				slot = &slots[index % Size];
+				int64_t diff = int64_t(slot->sequence.load(std::memory_order_acquire)) - int64_t(index);
+				if (diff == 0) {
+					if (write.compare_exchange_weak(index, index + 1, std::memory_order_relaxed)) break;
+				} else if (diff < 0) {
+					//slot still holds an unread message from a lap ago -- the ring is full:
+					dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				} else {
+					index = write.load(std::memory_order_relaxed);
+				}
+			}
+			Message &message = slot->message;
+			message.source = source;
+			message.type = type;
+			message.severity = severity;
+			message.id = id;
+			size_t len = (length < 0 ? std::strlen(text) : size_t(length));
+			message.length = uint32_t(std::min(len, message.text.size()));
+			std::memcpy(message.text.data(), text, message.length);
+			slot->sequence.store(index + 1, std::memory_order_release);
+		}
+
+		bool pop(Message *message) {
+			Slot &slot = slots[read % Size];
+			if (slot.sequence.load(std::memory_order_acquire) != read + 1) return false;
+			*message = slot.message;
+			slot.sequence.store(read + Size, std::memory_order_release);
+			read += 1;
+			return true;
+		}
+	};
+
+	Log &log() {
+		static Log log;
+		return log;
+	}
+
+	void APIENTRY debug_callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, GLchar const *message, void const *) {
+		log().push(source, type, id, severity, length, message);
+	}
+
+	char const *source_name(GLenum source) {
+		switch (source) {
+			case GL_DEBUG_SOURCE_API: return "api";
+			case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+			case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+			case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+			case GL_DEBUG_SOURCE_APPLICATION: return "application";
+			default: return "other";
+		}
+	}
+	char const *type_name(GLenum type) {
+		switch (type) {
+			case GL_DEBUG_TYPE_ERROR: return "error";
+			case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated behavior";
+			case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+			case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+			case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+			default: return "other";
+		}
+	}
+	char const *severity_name(GLenum severity) {
+		switch (severity) {
+			case GL_DEBUG_SEVERITY_HIGH: return "high";
+			case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+			case GL_DEBUG_SEVERITY_LOW: return "low";
+			default: return "notification";
+		}
+	}
+}
+
+#ifdef NDEBUG
+static constexpr bool const DebugBuild = false;
+#else
+static constexpr bool const DebugBuild = true;
+#endif
+
+bool gl_debug_init() {
+	//release builds don't use debug output (their GL_ERRORS() calls are compiled out):
+	if (!DebugBuild) return false;
+
+	if (object_label) return true; //already installed
+
+	if (!gl_has_extension("GL_KHR_debug")) return false;
+	DebugMessageCallbackFn debug_message_callback = (DebugMessageCallbackFn)gl_get_proc_address("glDebugMessageCallback");
+	DebugMessageControlFn debug_message_control = (DebugMessageControlFn)gl_get_proc_address("glDebugMessageControl");
+	ObjectLabelFn label = (ObjectLabelFn)gl_get_proc_address("glObjectLabel");
+	if (!debug_message_callback || !debug_message_control || !label) return false;
+
+	log(); //(construct the log before any messages can arrive)
+	debug_message_callback(debug_callback, nullptr);
+	//notifications are mostly chatter (e.g., "buffer will use video memory"), so skip them:
+	debug_message_control(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+	glEnable(GL_DEBUG_OUTPUT);
+	object_label = label;
+
+	char const *sync = std::getenv("GL_DEBUG_SYNC");
+	if (sync && std::strcmp(sync, "1") == 0) {
+		std::cout << "GL_DEBUG_SYNC=1: enabling synchronous debug output." << std::endl;
+		gl_debug_set_synchronous(true);
+	}
+	return true;
+}
+
+bool gl_debug_enabled() {
+	return object_label != nullptr;
+}
+
+void gl_debug_set_synchronous(bool synchronous) {
+	if (!gl_debug_enabled()) return;
+	if (synchronous) glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	else glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+}
+
+void gl_debug_flush(std::string const &where) {
+	if (!gl_debug_enabled()) return;
+	Log &l = log();
+	Message message;
+	while (l.pop(&message)) {
+		std::cerr << "WARNING: gl " << severity_name(message.severity) << " " << type_name(message.type)
+			<< " (" << source_name(message.source) << ", id " << message.id << ") before " << where << ": "
+			<< std::string(message.text.data(), message.length) << std::endl;
+	}
+	uint32_t dropped = l.dropped.exchange(0, std::memory_order_relaxed);
+	if (dropped) {
+		std::cerr << "WARNING: " << dropped << " gl debug messages dropped (log full) before " << where << "." << std::endl;
+	}
+}
+
+void gl_label(GLenum identifier, GLuint name, std::string const &label) {
+	if (!object_label) return;
+	object_label(identifier, name, GLsizei(label.size()), label.c_str());
+}
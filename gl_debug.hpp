@@ -0,0 +1,50 @@
+#pragma once
+
+#include "GL.hpp"
+
+#include <string>
+
+//OpenGL debug output (GL_KHR_debug; core in GL 4.3):
+// the driver reports errors, warnings, and performance hints through a callback instead of making
+// code poll glGetError (which can force it to sync). The callback may run on a driver thread, so it
+// only copies messages into a fixed-size lock-free log; gl_debug_flush() prints them.
+//
+//GL_ERRORS() (gl_errors.hpp) flushes the log when debug output is on, and falls back to glGetError otherwise.
+//Drivers are only required to produce messages in debug contexts (main.cpp and Headless.cpp ask for one in debug builds).
+//In release builds (NDEBUG defined), gl_debug_init does nothing.
+
+//install the callback if the context supports GL_KHR_debug; returns whether it did:
+// (call after the context is created and init_GL has run)
+// setting the environment variable GL_DEBUG_SYNC=1 also turns on synchronous output (see below).
+bool gl_debug_init();
+
+//was the callback installed?
+bool gl_debug_enabled();
+
+//synchronous output calls the callback from inside the GL call that caused the message
+// -- so a breakpoint in it shows the offending code -- at the cost of serializing the driver.
+void gl_debug_set_synchronous(bool synchronous);
+
+//print (to std::cerr) and clear the messages logged so far, tagged with 'where':
+void gl_debug_flush(std::string const &where);
+
+//name an object in debug messages (and in GL debuggers); does nothing without GL_KHR_debug:
+// 'identifier' is the object's type, e.g., GL_BUFFER, GL_PROGRAM, GL_VERTEX_ARRAY, GL_TEXTURE.
+void gl_label(GLenum identifier, GLuint name, std::string const &label);
+
+//(object identifiers not in GL.hpp, since it only covers GL 3.3:)
+#ifndef GL_BUFFER
+#define GL_BUFFER 0x82E0
+#endif
+#ifndef GL_SHADER
+#define GL_SHADER 0x82E1
+#endif
+#ifndef GL_PROGRAM
+#define GL_PROGRAM 0x82E2
+#endif
+#ifndef GL_VERTEX_ARRAY
+#define GL_VERTEX_ARRAY 0x8074
+#endif
+#ifndef GL_QUERY
+#define GL_QUERY 0x82E3
+#endif
@@ -1,12 +1,21 @@
 #pragma once
 
 #include "GL.hpp"
+#include "gl_debug.hpp"
 #include <iostream>
 
 #define STR2(X) # X
 #define STR(X) STR2(X)
 
+//report any OpenGL errors (and other debug messages) so far:
+// with debug output (see gl_debug.hpp), this prints the messages logged by the driver -- no glGetError stall;
+// otherwise it polls glGetError.
 inline void gl_errors(std::string const &where) {
+	if (gl_debug_enabled()) {
+		gl_debug_flush(where);
+		return;
+	}
+
 	GLenum err = 0;
 	while ((err = glGetError()) != GL_NO_ERROR) {
 		#define CHECK( ERR ) \
@@ -27,5 +36,10 @@ inline void gl_errors(std::string const &where) {
 		#undef CHECK
 	}
 }
-#define GL_ERRORS() gl_errors(__FILE__  ":" STR(__LINE__) )
 
+//GL_ERRORS() compiles to nothing in release builds (NDEBUG defined):
+#ifdef NDEBUG
+#define GL_ERRORS() do { } while (0)
+#else
+#define GL_ERRORS() gl_errors(__FILE__  ":" STR(__LINE__) )
+#endif
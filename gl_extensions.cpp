@@ -0,0 +1,29 @@
+#include "gl_extensions.hpp"
+
+#include <SDL.h>
+
+#include <cstring>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#endif
+
+bool gl_has_extension(char const *name) {
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; ++i) {
+		char const *extension = reinterpret_cast< char const * >(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+		if (extension && std::strcmp(extension, name) == 0) return true;
+	}
+	return false;
+}
+
+void *gl_get_proc_address(char const *name) {
+#ifdef __linux__
+	//headless contexts (see Headless.hpp) are made with EGL, without SDL's video subsystem:
+	if (eglGetCurrentContext() != EGL_NO_CONTEXT) {
+		return reinterpret_cast< void * >(eglGetProcAddress(name));
+	}
+#endif
+	return SDL_GL_GetProcAddress(name);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "GL.hpp"
+
+//Look up OpenGL extensions and entry points beyond GL.hpp's GL 3.3 core:
+// (these work both with windowed contexts, which come from SDL, and headless ones, which may come from EGL)
+
+//does the current context advertise extension 'name' (e.g., "GL_ARB_buffer_storage")?
+bool gl_has_extension(char const *name);
+
+//address of entry point 'name' (nullptr if not found):
+void *gl_get_proc_address(char const *name);
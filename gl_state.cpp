@@ -0,0 +1,210 @@
+#include "gl_state.hpp"
+
+#include <array>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	//marks shadow state that doesn't match anything known (so the next call goes through):
+	constexpr GLuint Unknown = -1U;
+
+	//tracked texture targets, along with the glGet* enum for their bindings:
+	constexpr uint32_t TrackedUnits = 16;
+	constexpr std::array< GLenum, 4 > const TextureTargets{{GL_TEXTURE_2D, GL_TEXTURE_3D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BUFFER}};
+	constexpr std::array< GLenum, 4 > const TextureBindings{{GL_TEXTURE_BINDING_2D, GL_TEXTURE_BINDING_3D, GL_TEXTURE_BINDING_CUBE_MAP, GL_TEXTURE_BINDING_BUFFER}};
+	uint32_t target_index(GLenum target) {
+		for (uint32_t i = 0; i < TextureTargets.size(); ++i) {
+			if (TextureTargets[i] == target) return i;
+		}
+		return Unknown;
+	}
+
+	//tracked capabilities:
+	constexpr std::array< GLenum, 3 > const Capabilities{{GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE}};
+	uint32_t capability_index(GLenum capability) {
+		for (uint32_t i = 0; i < Capabilities.size(); ++i) {
+			if (Capabilities[i] == capability) return i;
+		}
+		return Unknown;
+	}
+
+	struct Shadow {
+		GLuint program = Unknown;
+		GLuint vertex_array = Unknown;
+		GLuint active_unit = Unknown;
+		std::array< std::array< GLuint, TextureTargets.size() >, TrackedUnits > textures;
+		std::array< GLuint, Capabilities.size() > enabled; //(0, 1, or Unknown)
+		GLenum depth_func = Unknown;
+		GLenum blend_sfactor = Unknown;
+		GLenum blend_dfactor = Unknown;
+
+		Shadow() {
+			for (auto &unit : textures) unit.fill(Unknown);
+			enabled.fill(Unknown);
+		}
+	} shadow;
+
+	[[noreturn]] void mismatch(char const *what, GLuint expected, GLint actual) {
+		throw std::runtime_error(std::string("GL state cache: ") + what + " is " + std::to_string(actual)
+			+ " but the cache has " + std::to_string(expected) + " (was it changed without going through gl_state.hpp?)");
+	}
+
+	GLint get_integer(GLenum pname) {
+		GLint value = 0;
+		glGetIntegerv(pname, &value);
+		return value;
+	}
+
+	//validate each piece of shadow state (if known):
+	void validate_program() {
+		if (shadow.program == Unknown) return;
+		GLint actual = get_integer(GL_CURRENT_PROGRAM);
+		if (GLuint(actual) != shadow.program) mismatch("current program", shadow.program, actual);
+	}
+	void validate_vertex_array() {
+		if (shadow.vertex_array == Unknown) return;
+		GLint actual = get_integer(GL_VERTEX_ARRAY_BINDING);
+		if (GLuint(actual) != shadow.vertex_array) mismatch("vertex array binding", shadow.vertex_array, actual);
+	}
+	void validate_textures() {
+		GLint active = get_integer(GL_ACTIVE_TEXTURE);
+		if (shadow.active_unit != Unknown && GLuint(active) != GL_TEXTURE0 + shadow.active_unit) {
+			mismatch("active texture unit", GL_TEXTURE0 + shadow.active_unit, active);
+		}
+		for (uint32_t u = 0; u < TrackedUnits; ++u) {
+			bool switched = false;
+			for (uint32_t t = 0; t < TextureTargets.size(); ++t) {
+				if (shadow.textures[u][t] == Unknown) continue;
+				if (!switched) {
+					glActiveTexture(GL_TEXTURE0 + u);
+					switched = true;
+				}
+				GLint actual = get_integer(TextureBindings[t]);
+				if (GLuint(actual) != shadow.textures[u][t]) {
+					glActiveTexture(GLenum(active));
+					mismatch(("texture binding (unit " + std::to_string(u) + ", target index " + std::to_string(t) + ")").c_str(), shadow.textures[u][t], actual);
+				}
+			}
+		}
+		glActiveTexture(GLenum(active));
+	}
+	void validate_capabilities() {
+		for (uint32_t c = 0; c < Capabilities.size(); ++c) {
+			if (shadow.enabled[c] == Unknown) continue;
+			GLint actual = (glIsEnabled(Capabilities[c]) ? 1 : 0);
+			if (GLuint(actual) != shadow.enabled[c]) mismatch(("enable state of capability " + std::to_string(Capabilities[c])).c_str(), shadow.enabled[c], actual);
+		}
+	}
+	void validate_depth_func() {
+		if (shadow.depth_func == Unknown) return;
+		GLint actual = get_integer(GL_DEPTH_FUNC);
+		if (GLenum(actual) != shadow.depth_func) mismatch("depth func", shadow.depth_func, actual);
+	}
+	void validate_blend_func() {
+		if (shadow.blend_sfactor == Unknown) return;
+		GLint sfactor = get_integer(GL_BLEND_SRC_RGB);
+		GLint dfactor = get_integer(GL_BLEND_DST_RGB);
+		if (GLenum(sfactor) != shadow.blend_sfactor) mismatch("blend source factor", shadow.blend_sfactor, sfactor);
+		if (GLenum(dfactor) != shadow.blend_dfactor) mismatch("blend destination factor", shadow.blend_dfactor, dfactor);
+	}
+}
+
+#ifdef GL_STATE_VALIDATE
+#define VALIDATE( WHAT ) validate_ ## WHAT ()
+#else
+#define VALIDATE( WHAT )
+#endif
+
+void gl_use_program(GLuint program) {
+	VALIDATE( program );
+	if (shadow.program == program) return;
+	glUseProgram(program);
+	shadow.program = program;
+}
+
+void gl_bind_vertex_array(GLuint vertex_array) {
+	VALIDATE( vertex_array );
+	if (shadow.vertex_array == vertex_array) return;
+	glBindVertexArray(vertex_array);
+	shadow.vertex_array = vertex_array;
+}
+
+void gl_bind_texture(GLuint unit, GLenum target, GLuint texture) {
+	VALIDATE( textures );
+	uint32_t t = target_index(target);
+
+	//(the unit is made active even if the binding is already there, since callers may go on to glTexImage*, glTexParameter*, ...)
+	if (shadow.active_unit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		shadow.active_unit = unit;
+	}
+	if (unit < TrackedUnits && t != Unknown && shadow.textures[unit][t] == texture) return;
+
+	glBindTexture(target, texture);
+	if (unit < TrackedUnits && t != Unknown) shadow.textures[unit][t] = texture;
+}
+
+void gl_enable(GLenum capability, bool enabled) {
+	VALIDATE( capabilities );
+	uint32_t c = capability_index(capability);
+	if (c != Unknown && shadow.enabled[c] == GLuint(enabled)) return;
+
+	if (enabled) glEnable(capability);
+	else glDisable(capability);
+	if (c != Unknown) shadow.enabled[c] = GLuint(enabled);
+}
+
+void gl_depth_func(GLenum func) {
+	VALIDATE( depth_func );
+	if (shadow.depth_func == func) return;
+	glDepthFunc(func);
+	shadow.depth_func = func;
+}
+
+void gl_blend_func(GLenum sfactor, GLenum dfactor) {
+	VALIDATE( blend_func );
+	if (shadow.blend_sfactor == sfactor && shadow.blend_dfactor == dfactor) return;
+	glBlendFunc(sfactor, dfactor);
+	shadow.blend_sfactor = sfactor;
+	shadow.blend_dfactor = dfactor;
+}
+
+#undef VALIDATE
+
+void gl_delete_program(GLuint program) {
+	glDeleteProgram(program);
+	//(a program that is in use isn't actually deleted until it is replaced, but then its name may be reused)
+	if (shadow.program == program) shadow.program = Unknown;
+}
+
+void gl_delete_vertex_arrays(GLsizei count, GLuint const *vertex_arrays) {
+	glDeleteVertexArrays(count, vertex_arrays);
+	for (GLsizei i = 0; i < count; ++i) {
+		if (vertex_arrays[i] != 0 && shadow.vertex_array == vertex_arrays[i]) shadow.vertex_array = 0;
+	}
+}
+
+void gl_delete_textures(GLsizei count, GLuint const *textures) {
+	glDeleteTextures(count, textures);
+	for (GLsizei i = 0; i < count; ++i) {
+		if (textures[i] == 0) continue;
+		for (auto &unit : shadow.textures) {
+			for (auto &texture : unit) {
+				if (texture == textures[i]) texture = 0;
+			}
+		}
+	}
+}
+
+void gl_state_invalidate() {
+	shadow = Shadow();
+}
+
+void gl_state_validate() {
+	validate_program();
+	validate_vertex_array();
+	validate_textures();
+	validate_capabilities();
+	validate_depth_func();
+	validate_blend_func();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "GL.hpp"
+
+//Shadow copies of the GL state that draw code sets most often -- current program, vertex array,
+// texture bindings, and depth/blend settings -- so calls that wouldn't change anything are skipped.
+//
+//This only works if code changes these pieces of state through the functions below
+// (e.g., gl_use_program instead of glUseProgram). After code that doesn't (e.g., a library),
+// call gl_state_invalidate() so that the next call to each function goes through.
+//
+//Draw code should bind what it needs and leave it bound; there's no need to reset to 0 afterward.
+//
+//Compile with GL_STATE_VALIDATE defined to check the shadow state against glGet* queries every time it is used.
+// (slow -- each query waits for the driver -- but catches code that changes state behind the cache's back)
+
+void gl_use_program(GLuint program);
+void gl_bind_vertex_array(GLuint vertex_array);
+
+//bind 'texture' to 'target' on texture unit GL_TEXTURE0 + unit:
+// (also makes that unit active; GL_TEXTURE_2D, _3D, _CUBE_MAP, and _BUFFER bindings on units 0-15 are tracked)
+void gl_bind_texture(GLuint unit, GLenum target, GLuint texture);
+
+//GL_DEPTH_TEST, GL_BLEND, and GL_CULL_FACE are tracked; other capabilities are passed straight through:
+void gl_enable(GLenum capability, bool enabled);
+void gl_depth_func(GLenum func);
+void gl_blend_func(GLenum sfactor, GLenum dfactor);
+
+//deleting a bound object unbinds it (and its name may then be reused), so delete bindable objects with these:
+void gl_delete_program(GLuint program);
+void gl_delete_vertex_arrays(GLsizei count, GLuint const *vertex_arrays);
+void gl_delete_textures(GLsizei count, GLuint const *textures);
+
+//forget all shadow state (the next call to each function above will go through):
+void gl_state_invalidate();
+
+//compare all (known) shadow state to the actual GL state; throws std::runtime_error on a mismatch:
+void gl_state_validate();
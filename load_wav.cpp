@@ -3,7 +3,9 @@
 #include <SDL.h>
 
 #include <iostream>
+#include <fstream>
 #include <cassert>
+#include <cstring>
 #include <algorithm>
 
 constexpr uint32_t AUDIO_RATE = 48000;
@@ -48,4 +50,155 @@ void load_wav(std::string const& filename, std::vector< float >* data_) {
 		max = std::max(max, d);
 	}
 	std::cout << "Range: " << min << ", " << max << std::endl;
-}
\ No newline at end of file
+}
+
+bool load_wav_info(std::string const& filename, WavInfo* info_) {
+	assert(info_);
+
+	std::ifstream file(filename, std::ios::binary);
+	if (!file) return false;
+
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	//RIFF header, followed by "WAVE":
+	ChunkHeader riff;
+	char wave[4];
+	if (!file.read(reinterpret_cast< char* >(&riff), sizeof(riff))) return false;
+	if (!file.read(wave, 4)) return false;
+	if (std::memcmp(riff.magic, "RIFF", 4) != 0 || std::memcmp(wave, "WAVE", 4) != 0) return false;
+
+	//then a sequence of chunks, of which we care about "fmt " and "data":
+	WavInfo info;
+	bool have_fmt = false;
+	ChunkHeader chunk;
+	while (file.read(reinterpret_cast< char* >(&chunk), sizeof(chunk))) {
+		uint64_t chunk_start = uint64_t(file.tellg());
+		if (std::memcmp(chunk.magic, "fmt ", 4) == 0) {
+			struct {
+				uint16_t format;
+				uint16_t channels;
+				uint32_t rate;
+				uint32_t byte_rate;
+				uint16_t block_align;
+				uint16_t bits;
+			} fmt;
+			static_assert(sizeof(fmt) == 16, "fmt is packed");
+			if (chunk.size < sizeof(fmt) || !file.read(reinterpret_cast< char* >(&fmt), sizeof(fmt))) return false;
+			uint16_t format = fmt.format;
+			if (format == 0xFFFE && chunk.size >= 40) {
+				//WAVE_FORMAT_EXTENSIBLE: actual format is the first two bytes of the subformat GUID
+				char ext[24];
+				if (!file.read(ext, sizeof(ext))) return false;
+				std::memcpy(&format, ext + 8, 2);
+			}
+			if (format == 1) { //integer PCM
+				if (fmt.bits != 8 && fmt.bits != 16 && fmt.bits != 24 && fmt.bits != 32) return false;
+				info.is_float = false;
+			}
+			else if (format == 3) { //IEEE float
+				if (fmt.bits != 32) return false;
+				info.is_float = true;
+			}
+			else {
+				return false;
+			}
+			if (fmt.channels == 0) return false;
+			info.rate = fmt.rate;
+			info.channels = fmt.channels;
+			info.bytes_per_sample = fmt.bits / 8;
+			have_fmt = true;
+		}
+		else if (std::memcmp(chunk.magic, "data", 4) == 0) {
+			if (!have_fmt) return false;
+			info.data_offset = chunk_start;
+			info.frames = chunk.size / info.bytes_per_frame();
+			*info_ = info;
+			return true;
+		}
+		//skip to next chunk (chunks are padded to even sizes):
+		file.seekg(std::streamoff(chunk_start + chunk.size + (chunk.size & 1)));
+	}
+	return false;
+}
+
+void convert_wav_frames(WavInfo const& info, uint8_t const* raw, uint32_t frames, float* out) {
+	assert(info.channels > 0);
+	float const scale = 1.0f / float(info.channels);
+	for (uint32_t f = 0; f < frames; ++f) {
+		float sum = 0.0f;
+		for (uint32_t c = 0; c < info.channels; ++c) {
+			if (info.is_float) {
+				float v;
+				std::memcpy(&v, raw, 4);
+				sum += v;
+			}
+			else if (info.bytes_per_sample == 1) {
+				sum += (float(raw[0]) - 128.0f) * (1.0f / 128.0f); //8-bit wav data is unsigned
+			}
+			else if (info.bytes_per_sample == 2) {
+				int16_t v;
+				std::memcpy(&v, raw, 2);
+				sum += float(v) * (1.0f / 32768.0f);
+			}
+			else if (info.bytes_per_sample == 3) {
+				int32_t v = int32_t(uint32_t(raw[0]) << 8 | uint32_t(raw[1]) << 16 | uint32_t(raw[2]) << 24) >> 8;
+				sum += float(v) * (1.0f / 8388608.0f);
+			}
+			else {
+				int32_t v;
+				std::memcpy(&v, raw, 4);
+				sum += float(v) * (1.0f / 2147483648.0f);
+			}
+			raw += info.bytes_per_sample;
+		}
+		out[f] = sum * scale;
+	}
+}
+
+void save_wav(std::string const& filename, uint32_t rate, uint32_t channels, std::vector< float > const& data) {
+	std::ofstream file(filename, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Failed to open WAV file '" + filename + "' for writing.");
+	}
+
+	//little-endian helpers:
+	auto write_u32 = [&file](uint32_t v) {
+		uint8_t bytes[4] = { uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24) };
+		file.write(reinterpret_cast< char const* >(bytes), 4);
+	};
+	auto write_u16 = [&file](uint16_t v) {
+		uint8_t bytes[2] = { uint8_t(v), uint8_t(v >> 8) };
+		file.write(reinterpret_cast< char const* >(bytes), 2);
+	};
+
+	uint32_t data_bytes = uint32_t(data.size() * 4);
+	file.write("RIFF", 4);
+	write_u32(4 + (8 + 16) + (8 + data_bytes));
+	file.write("WAVE", 4);
+
+	file.write("fmt ", 4);
+	write_u32(16);
+	write_u16(3); //WAVE_FORMAT_IEEE_FLOAT
+	write_u16(uint16_t(channels));
+	write_u32(rate);
+	write_u32(rate * channels * 4); //bytes per second
+	write_u16(uint16_t(channels * 4)); //bytes per frame
+	write_u16(32); //bits per sample
+
+	file.write("data", 4);
+	write_u32(data_bytes);
+	for (float f : data) {
+		uint32_t bits;
+		static_assert(sizeof(bits) == sizeof(f), "float is 32 bits");
+		std::memcpy(&bits, &f, 4);
+		write_u32(bits);
+	}
+
+	if (!file) {
+		throw std::runtime_error("Failed to write WAV file '" + filename + "'.");
+	}
+}
@@ -2,6 +2,29 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 
 //Load a WAV file as 48kHz floating-point mono; throws on error:
 void load_wav(std::string const& filename, std::vector< float >* data);
+
+//Layout of the sample data in a WAV file, for reading it incrementally (e.g., when streaming):
+struct WavInfo {
+	uint32_t rate = 0; //samples per second
+	uint32_t channels = 0; //interleaved channels per frame
+	uint32_t bytes_per_sample = 0; //1, 2, 3, or 4
+	bool is_float = false; //32-bit IEEE float samples (otherwise, integer PCM)
+	uint64_t data_offset = 0; //file offset of first frame
+	uint32_t frames = 0; //number of frames in file
+
+	uint32_t bytes_per_frame() const { return channels * bytes_per_sample; }
+};
+
+//Read the header of a WAV file; returns false if the file doesn't hold uncompressed integer or float PCM:
+// (does not throw)
+bool load_wav_info(std::string const& filename, WavInfo* info);
+
+//Convert 'frames' frames of raw WAV data (laid out as described by 'info') to floating-point mono:
+void convert_wav_frames(WavInfo const& info, uint8_t const* raw, uint32_t frames, float* out);
+
+//Save interleaved floating-point audio as a 32-bit float WAV file; throws on error:
+void save_wav(std::string const& filename, uint32_t rate, uint32_t channels, std::vector< float > const& data);
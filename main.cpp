@@ -12,9 +12,19 @@
 
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
+//...and gl_debug.hpp has the driver report errors as they happen:
+#include "gl_debug.hpp"
 
 //for screenshots:
 #include "load_save_png.hpp"
+#include "DrawLines.hpp"
+
+//for benchmarking without a window:
+#include "Headless.hpp"
+
+//for frame timing (and its overlay):
+#include "Profiler.hpp"
+#include "draw_profiler.hpp"
 
 //Includes for libSDL:
 #include <SDL.h>
@@ -34,10 +44,23 @@ int main(int argc, char **argv) {
 
 	//------------  initialization ------------
 
+	//Headless mode renders a fixed number of frames offscreen and prints timings (see Headless.hpp):
+	Headless headless(&argc, argv);
+	if (headless.enabled) {
+		headless.create_context();
+		Sound::init_offline(); //(no audio device; nothing is mixed)
+		call_load_functions();
+		Mode::set_current(std::make_shared< PlayMode >());
+		headless.run();
+		Mode::set_current(nullptr); //(free the mode's resources while the context still exists)
+		Sound::shutdown();
+		return 0;
+	}
+
 	//Initialize SDL library:
 	SDL_Init(SDL_INIT_VIDEO);
 
-	//Ask for an OpenGL context version 3.3, core profile, enable debug:
+	//Ask for an OpenGL context version 3.3, core profile, enable debug (in debug builds):
 	SDL_GL_ResetAttributes();
 	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
 	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
@@ -47,7 +70,9 @@ int main(int argc, char **argv) {
 	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
 	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+#ifndef NDEBUG
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+#endif
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
 
@@ -81,6 +106,9 @@ int main(int argc, char **argv) {
 	//On windows, load OpenGL entrypoints: (does nothing on other platforms)
 	init_GL();
 
+	//Report OpenGL errors through GL_KHR_debug, if available (see gl_debug.hpp):
+	gl_debug_init();
+
 	//Set VSYNC + Late Swap (prevents crazy FPS):
 	if (SDL_GL_SetSwapInterval(-1) != 0) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
@@ -123,7 +151,11 @@ int main(int argc, char **argv) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
+		//(each step is timed as a named scope; see Profiler.hpp)
+		Profiler::begin_frame();
+
 		{ //(1) process any events that are pending
+			Profiler::Scope scope("events");
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt) == 1) {
 				//handle resizing:
@@ -150,12 +182,15 @@ int main(int argc, char **argv) {
 						px.a = 0xff;
 					}
 					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+				} else if (profiler_handle_event(evt)) {
+					// F1/F2: frame profiler overlay toggle / dump (see draw_profiler.hpp)
 				}
 			}
 			if (!Mode::current) break;
 		}
 
 		{ //(2) call the current mode's "update" function to deal with elapsed time:
+			Profiler::Scope scope("update");
 			auto current_time = std::chrono::high_resolution_clock::now();
 			static auto previous_time = current_time;
 			float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
@@ -170,12 +205,27 @@ int main(int argc, char **argv) {
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
-		
+			Profiler::Scope scope("draw");
 			Mode::current->draw(drawable_size);
 		}
 
-		//Wait until the recently-drawn frame is shown before doing it all again:
-		SDL_GL_SwapWindow(window);
+		//frame profiler overlay (F1 toggles, F2 saves to 'frame-profile.csv'):
+		draw_profiler_overlay(drawable_size);
+
+		{ //Draw any batched DrawLines (and update DrawLines text stats):
+			Profiler::Scope scope("DrawLines");
+			DrawLines::end_frame();
+		}
+
+		{ //Wait until the recently-drawn frame is shown before doing it all again:
+			Profiler::Scope scope("swap");
+			SDL_GL_SwapWindow(window);
+		}
+
+		//Print any OpenGL debug messages from this frame (does nothing without debug output):
+		gl_debug_flush("end of frame");
+
+		Profiler::end_frame();
 	}
 
 
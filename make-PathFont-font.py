@@ -372,7 +372,11 @@ def end_element(name):
 	glyph_stack.pop()
 
 	if glyph != None and glyph_stack[-1] == None:
-		glyphs[glyph.name] = glyph
+		if glyph.name in glyphs:
+			#(keep the first glyph with a given name, as the old PathFont constructor did)
+			print("WARNING: ignoring duplicate glyph for '" + glyph.name + "'.")
+		else:
+			glyphs[glyph.name] = glyph
 		#TODO: grab glyph path from accum
 
 
@@ -514,6 +518,47 @@ for m in range(0x20, 0x7f):
 		missing.append(c)
 print("Font misses: " + ", ".join(map(lambda x: "'" + x + "'", missing)))
 
+#glyph lookup: a direct table for the first byte of each name, then a trie for any further bytes:
+NONE = 0xffffffff
+out_byte_glyphs = [NONE] * 256
+out_byte_nodes = [0] * 256
+trie = [dict()] #trie[node] maps byte -> [glyph, child node]; node 0 is unused (so 0 can mean 'none')
+for g in range(0, out_glyphs):
+	name = out_chars[out_glyph_char_starts[g]:(out_glyph_char_starts[g+1] if g + 1 < out_glyphs else len(out_chars))]
+	assert(len(name) > 0)
+	if len(name) == 1:
+		assert out_byte_glyphs[name[0]] == NONE, "glyph names are unique"
+		out_byte_glyphs[name[0]] = g
+		continue
+	if out_byte_nodes[name[0]] == 0:
+		out_byte_nodes[name[0]] = len(trie)
+		trie.append(dict())
+	node = out_byte_nodes[name[0]]
+	for i in range(1, len(name)):
+		edge = trie[node].setdefault(name[i], [NONE, 0])
+		if i + 1 == len(name):
+			assert edge[0] == NONE, "glyph names are unique"
+			edge[0] = g
+		else:
+			if edge[1] == 0:
+				edge[1] = len(trie)
+				trie.append(dict())
+			node = edge[1]
+
+out_node_edge_starts = []
+out_edges = []
+for node in trie:
+	out_node_edge_starts.append(len(out_edges))
+	for byte in sorted(node.keys()):
+		out_edges.append((byte, node[byte][0], node[byte][1]))
+out_node_edge_starts.append(len(out_edges))
+
+def glyph_str(g):
+	if g == NONE: return '-1U'
+	else: return str(g)
+
+print("Glyph lookup trie has " + str(len(trie) - 1) + " nodes and " + str(len(out_edges)) + " edges.")
+
 print("Writing PathFont '" + fontname + "' to '" + cppname + "'")
 
 cppfile = open(cppname, 'wb')
@@ -553,8 +598,29 @@ w('\tconstexpr const float font_coords[' + str(len(out_coords)) + '] = {\n')
 wd(out_coords, "{:.6f}f", 6)
 w('\t};\n')
 
+w('\tconstexpr const uint32_t font_byte_glyphs[256] = {\n')
+wd(list(map(glyph_str, out_byte_glyphs)), "{}", 16)
+w('\t};\n')
+
+w('\tconstexpr const uint32_t font_byte_nodes[256] = {\n')
+wd(out_byte_nodes, "{}", 16)
+w('\t};\n')
+
+w('\tconstexpr const uint32_t font_node_edge_starts[' + str(len(out_node_edge_starts)) + '] = {\n')
+wd(out_node_edge_starts, "{}", 12)
+w('\t};\n')
+
+#(always at least one entry, since zero-length arrays aren't allowed)
+w('\tconstexpr const PathFont::Edge font_edges[' + str(max(1, len(out_edges))) + '] = {\n')
+if len(out_edges) == 0:
+	w('\t\t{0, -1U, 0} //(unused)\n')
+else:
+	wd(list(map(lambda e: '{' + str(e[0]) + ', ' + glyph_str(e[1]) + ', ' + str(e[2]) + '}', out_edges)), "{}", 6)
+w('\t};\n')
+
 
 w('}\n')
-w('PathFont PathFont::font(font_glyphs, font_glyph_widths, font_glyph_char_starts, font_chars, font_glyph_coord_starts, font_coords);\n')
+w('PathFont PathFont::font(font_glyphs, font_glyph_widths, font_glyph_char_starts, font_chars, font_glyph_coord_starts, font_coords,\n')
+w('\tfont_byte_glyphs, font_byte_nodes, font_node_edge_starts, font_edges);\n')
 
 cppfile.close()
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+
+#
+# Writes a '.hrtf' file (head-related impulse responses) for Sound::set_hrtf.
+#
+# Usage:
+#   make-hrtf.py out.hrtf             -- spherical head model (Brown & Duda, 1998) at the 12 vertices of an icosahedron
+#   make-hrtf.py out.hrtf list.txt    -- measured responses; each line of list.txt is:
+#                                        azimuth elevation file.wav
+#                                        (degrees; azimuth 0 is ahead and 90 is right, elevation 90 is up;
+#                                         files are 48kHz, 16-bit stereo [left, right])
+#
+# File format (see read_write_chunk.hpp):
+#   'hrd0' chunk: one direction per response as three floats, in listener space (x right, y forward, z up)
+#   'hri0' chunk: float samples; for each direction, the left ear's response then the right ear's (all the same length)
+# Responses should be 48kHz. The mixer treats the directions as virtual speakers, so they should cover the sphere
+# roughly evenly.
+#
+
+import math
+import struct
+import sys
+import wave
+
+RATE = 48000
+TAPS = 128
+
+def write_chunk(f, magic, data):
+	assert len(magic) == 4
+	f.write(magic.encode('ascii'))
+	f.write(struct.pack('<I', len(data)))
+	f.write(data)
+
+def direction(azimuth, elevation):
+	az = math.radians(azimuth)
+	el = math.radians(elevation)
+	return (math.sin(az) * math.cos(el), math.cos(az) * math.cos(el), math.sin(el))
+
+#---- spherical head model ----
+
+HEAD_RADIUS = 0.0875 #meters
+SPEED_OF_SOUND = 343.0 #meters / second
+
+def spherical_ear(d, ear_x):
+	#angle between source direction and the ear's axis:
+	theta = math.acos(max(-1.0, min(1.0, d[0] * ear_x)))
+
+	#arrival time (Woodworth), offset so the earliest possible arrival lands a few samples in:
+	a_c = HEAD_RADIUS / SPEED_OF_SOUND
+	if theta < 0.5 * math.pi:
+		delay = -a_c * math.cos(theta)
+	else:
+		delay = a_c * (theta - 0.5 * math.pi)
+	delay = (delay + a_c) * RATE + 4.0
+
+	#fractionally-delayed impulse:
+	x = [0.0] * TAPS
+	i = int(math.floor(delay))
+	x[i] = 1.0 - (delay - i)
+	x[i + 1] = delay - i
+
+	#head shadow: one-pole / one-zero filter whose high-frequency gain alpha depends on angle (bilinear transform):
+	alpha_min = 0.1
+	theta_min = math.radians(150.0)
+	alpha = (1.0 + 0.5 * alpha_min) + (1.0 - 0.5 * alpha_min) * math.cos(theta / theta_min * math.pi)
+	k = RATE / (SPEED_OF_SOUND / HEAD_RADIUS)
+	b0 = (1.0 + alpha * k) / (1.0 + k)
+	b1 = (1.0 - alpha * k) / (1.0 + k)
+	a1 = (1.0 - k) / (1.0 + k)
+	y = []
+	prev_x = 0.0
+	prev_y = 0.0
+	for v in x:
+		out = b0 * v + b1 * prev_x - a1 * prev_y
+		y.append(out)
+		prev_x = v
+		prev_y = out
+	return y
+
+def spherical_head():
+	phi = 0.5 * (1.0 + math.sqrt(5.0))
+	vertices = []
+	for s1 in (-1.0, 1.0):
+		for s2 in (-1.0, 1.0):
+			vertices.append((0.0, s1, s2 * phi))
+			vertices.append((s1, s2 * phi, 0.0))
+			vertices.append((s2 * phi, 0.0, s1))
+	directions = []
+	responses = []
+	for v in vertices:
+		l = math.sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2])
+		d = (v[0] / l, v[1] / l, v[2] / l)
+		directions.append(d)
+		responses.append((spherical_ear(d, -1.0), spherical_ear(d, 1.0)))
+	return directions, responses
+
+#---- measured responses ----
+
+def measured(list_file):
+	directions = []
+	responses = []
+	with open(list_file) as f:
+		for line in f:
+			line = line.split('#')[0].split()
+			if len(line) == 0: continue
+			if len(line) != 3:
+				raise ValueError("Expected 'azimuth elevation file.wav', got '" + ' '.join(line) + "'")
+			with wave.open(line[2], 'rb') as w:
+				if w.getframerate() != RATE or w.getnchannels() != 2 or w.getsampwidth() != 2:
+					raise ValueError("'" + line[2] + "' is not 48kHz, 16-bit stereo.")
+				frames = w.readframes(w.getnframes())
+			samples = struct.unpack('<' + str(len(frames) // 2) + 'h', frames)
+			left = [s / 32768.0 for s in samples[0::2]]
+			right = [s / 32768.0 for s in samples[1::2]]
+			directions.append(direction(float(line[0]), float(line[1])))
+			responses.append((left, right))
+	if len(directions) == 0:
+		raise ValueError("No responses listed in '" + list_file + "'")
+	#pad to a common length:
+	taps = max(len(r[0]) for r in responses)
+	responses = [(l + [0.0] * (taps - len(l)), r + [0.0] * (taps - len(r))) for (l, r) in responses]
+	return directions, responses
+
+if len(sys.argv) not in (2, 3):
+	print("Usage:\n\t" + sys.argv[0] + " out.hrtf [list.txt]")
+	sys.exit(1)
+
+if len(sys.argv) == 3:
+	directions, responses = measured(sys.argv[2])
+else:
+	directions, responses = spherical_head()
+
+with open(sys.argv[1], 'wb') as f:
+	write_chunk(f, 'hrd0', b''.join(struct.pack('<3f', *d) for d in directions))
+	data = []
+	for (l, r) in responses:
+		data += l
+		data += r
+	write_chunk(f, 'hri0', struct.pack('<' + str(len(data)) + 'f', *data))
+
+print("Wrote " + str(len(directions)) + " directions x " + str(len(responses[0][0])) + " taps to '" + sys.argv[1] + "'.")
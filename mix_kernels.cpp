@@ -0,0 +1,404 @@
+#include "mix_kernels.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIX_KERNELS_SSE 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#define MIX_KERNELS_AVX 1
+#include <immintrin.h>
+#endif
+
+void mix_mono_ramp(StereoFrame *out, float const *in, uint32_t count,
+	StereoFrame start, StereoFrame step, uint32_t first) {
+
+	uint32_t f = 0;
+
+#if defined(MIX_KERNELS_AVX)
+	{ //eight frames (= sixteen floats) per iteration:
+		//gains for frames [0,4) and [4,8) of the current group, as [l r l r l r l r]:
+		__m256 const frame_ofs_lo = _mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f);
+		__m256 const frame_ofs_hi = _mm256_setr_ps(4.0f, 4.0f, 5.0f, 5.0f, 6.0f, 6.0f, 7.0f, 7.0f);
+		__m256 const start_lr = _mm256_setr_ps(start.l, start.r, start.l, start.r, start.l, start.r, start.l, start.r);
+		__m256 const step_lr = _mm256_setr_ps(step.l, step.r, step.l, step.r, step.l, step.r, step.l, step.r);
+		for (; f + 8 <= count; f += 8) {
+			__m256 base = _mm256_set1_ps(float(first + f));
+			__m256 gain_lo = _mm256_add_ps(start_lr, _mm256_mul_ps(step_lr, _mm256_add_ps(base, frame_ofs_lo)));
+			__m256 gain_hi = _mm256_add_ps(start_lr, _mm256_mul_ps(step_lr, _mm256_add_ps(base, frame_ofs_hi)));
+
+			//duplicate each mono sample into both channels:
+			__m256 samples = _mm256_loadu_ps(in + f); //s0 .. s7
+			__m256 dup_a = _mm256_unpacklo_ps(samples, samples); //s0 s0 s1 s1 | s4 s4 s5 s5
+			__m256 dup_b = _mm256_unpackhi_ps(samples, samples); //s2 s2 s3 s3 | s6 s6 s7 s7
+			__m256 dup_lo = _mm256_permute2f128_ps(dup_a, dup_b, 0x20); //s0 s0 s1 s1 s2 s2 s3 s3
+			__m256 dup_hi = _mm256_permute2f128_ps(dup_a, dup_b, 0x31); //s4 s4 s5 s5 s6 s6 s7 s7
+
+			float *dst = &out[f].l;
+			_mm256_storeu_ps(dst, _mm256_add_ps(_mm256_loadu_ps(dst), _mm256_mul_ps(dup_lo, gain_lo)));
+			_mm256_storeu_ps(dst + 8, _mm256_add_ps(_mm256_loadu_ps(dst + 8), _mm256_mul_ps(dup_hi, gain_hi)));
+		}
+	}
+#endif
+
+#if defined(MIX_KERNELS_SSE)
+	{ //four frames (= eight floats) per iteration:
+		__m128 const frame_ofs_lo = _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+		__m128 const frame_ofs_hi = _mm_setr_ps(2.0f, 2.0f, 3.0f, 3.0f);
+		__m128 const start_lr = _mm_setr_ps(start.l, start.r, start.l, start.r);
+		__m128 const step_lr = _mm_setr_ps(step.l, step.r, step.l, step.r);
+		for (; f + 4 <= count; f += 4) {
+			__m128 base = _mm_set1_ps(float(first + f));
+			__m128 gain_lo = _mm_add_ps(start_lr, _mm_mul_ps(step_lr, _mm_add_ps(base, frame_ofs_lo)));
+			__m128 gain_hi = _mm_add_ps(start_lr, _mm_mul_ps(step_lr, _mm_add_ps(base, frame_ofs_hi)));
+
+			__m128 samples = _mm_loadu_ps(in + f); //s0 s1 s2 s3
+			__m128 dup_lo = _mm_unpacklo_ps(samples, samples); //s0 s0 s1 s1
+			__m128 dup_hi = _mm_unpackhi_ps(samples, samples); //s2 s2 s3 s3
+
+			float *dst = &out[f].l;
+			_mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(dst), _mm_mul_ps(dup_lo, gain_lo)));
+			_mm_storeu_ps(dst + 4, _mm_add_ps(_mm_loadu_ps(dst + 4), _mm_mul_ps(dup_hi, gain_hi)));
+		}
+	}
+#endif
+
+	//scalar fallback (and leftovers from the vector loops):
+	mix_mono_ramp_scalar(out + f, in + f, count - f, start, step, first + f);
+}
+
+void mix_mono_ramp_scalar(StereoFrame *out, float const *in, uint32_t count,
+	StereoFrame start, StereoFrame step, uint32_t first) {
+	for (uint32_t f = 0; f < count; ++f) {
+		float t = float(first + f);
+		out[f].l += (start.l + t * step.l) * in[f];
+		out[f].r += (start.r + t * step.r) * in[f];
+	}
+}
+
+void mix_mono_bformat(BFormatFrame *out, float const *in, uint32_t count,
+	BFormatFrame start, BFormatFrame step, uint32_t first) {
+
+	uint32_t f = 0;
+
+#if defined(MIX_KERNELS_AVX)
+	{ //four frames (= two vectors) per iteration:
+		__m256 const frame_ofs_lo = _mm256_setr_ps(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f);
+		__m256 const frame_ofs_hi = _mm256_setr_ps(2.0f, 2.0f, 2.0f, 2.0f, 3.0f, 3.0f, 3.0f, 3.0f);
+		__m256 const start_v = _mm256_setr_ps(start.w, start.x, start.y, start.z, start.w, start.x, start.y, start.z);
+		__m256 const step_v = _mm256_setr_ps(step.w, step.x, step.y, step.z, step.w, step.x, step.y, step.z);
+		for (; f + 4 <= count; f += 4) {
+			__m256 base = _mm256_set1_ps(float(first + f));
+			__m256 gain_lo = _mm256_add_ps(start_v, _mm256_mul_ps(step_v, _mm256_add_ps(base, frame_ofs_lo)));
+			__m256 gain_hi = _mm256_add_ps(start_v, _mm256_mul_ps(step_v, _mm256_add_ps(base, frame_ofs_hi)));
+
+			//spread each mono sample across its frame's four channels:
+			__m128 samples = _mm_loadu_ps(in + f); //s0 s1 s2 s3
+			__m256 dup_lo = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_shuffle_ps(samples, samples, 0x00)), _mm_shuffle_ps(samples, samples, 0x55), 1); //s0 x4, s1 x4
+			__m256 dup_hi = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_shuffle_ps(samples, samples, 0xaa)), _mm_shuffle_ps(samples, samples, 0xff), 1); //s2 x4, s3 x4
+
+			float *dst = &out[f].w;
+			_mm256_storeu_ps(dst, _mm256_add_ps(_mm256_loadu_ps(dst), _mm256_mul_ps(dup_lo, gain_lo)));
+			_mm256_storeu_ps(dst + 8, _mm256_add_ps(_mm256_loadu_ps(dst + 8), _mm256_mul_ps(dup_hi, gain_hi)));
+		}
+	}
+#endif
+
+#if defined(MIX_KERNELS_SSE)
+	{ //one frame is exactly one vector; four frames per iteration:
+		__m128 const start_v = _mm_loadu_ps(&start.w);
+		__m128 const step_v = _mm_loadu_ps(&step.w);
+		for (; f + 4 <= count; f += 4) {
+			float base = float(first + f);
+			__m128 samples = _mm_loadu_ps(in + f); //s0 s1 s2 s3
+			float *dst = &out[f].w;
+			_mm_storeu_ps(dst + 0, _mm_add_ps(_mm_loadu_ps(dst + 0), _mm_mul_ps(_mm_shuffle_ps(samples, samples, 0x00),
+				_mm_add_ps(start_v, _mm_mul_ps(step_v, _mm_set1_ps(base + 0.0f))))));
+			_mm_storeu_ps(dst + 4, _mm_add_ps(_mm_loadu_ps(dst + 4), _mm_mul_ps(_mm_shuffle_ps(samples, samples, 0x55),
+				_mm_add_ps(start_v, _mm_mul_ps(step_v, _mm_set1_ps(base + 1.0f))))));
+			_mm_storeu_ps(dst + 8, _mm_add_ps(_mm_loadu_ps(dst + 8), _mm_mul_ps(_mm_shuffle_ps(samples, samples, 0xaa),
+				_mm_add_ps(start_v, _mm_mul_ps(step_v, _mm_set1_ps(base + 2.0f))))));
+			_mm_storeu_ps(dst + 12, _mm_add_ps(_mm_loadu_ps(dst + 12), _mm_mul_ps(_mm_shuffle_ps(samples, samples, 0xff),
+				_mm_add_ps(start_v, _mm_mul_ps(step_v, _mm_set1_ps(base + 3.0f))))));
+		}
+	}
+#endif
+
+	//scalar fallback (and leftovers from the vector loops):
+	for (; f < count; ++f) {
+		float t = float(first + f);
+		out[f].w += (start.w + t * step.w) * in[f];
+		out[f].x += (start.x + t * step.x) * in[f];
+		out[f].y += (start.y + t * step.y) * in[f];
+		out[f].z += (start.z + t * step.z) * in[f];
+	}
+}
+
+void decode_bformat(StereoFrame *out, BFormatFrame const *in, uint32_t count,
+	BFormatFrame left_start, BFormatFrame left_step, BFormatFrame right_start, BFormatFrame right_step) {
+
+	uint32_t f = 0;
+
+#if defined(MIX_KERNELS_SSE)
+	{
+		__m128 const left_start_v = _mm_loadu_ps(&left_start.w);
+		__m128 const left_step_v = _mm_loadu_ps(&left_step.w);
+		__m128 const right_start_v = _mm_loadu_ps(&right_start.w);
+		__m128 const right_step_v = _mm_loadu_ps(&right_step.w);
+		for (; f < count; ++f) {
+			__m128 t = _mm_set1_ps(float(f));
+			__m128 frame = _mm_loadu_ps(&in[f].w);
+			__m128 l = _mm_mul_ps(frame, _mm_add_ps(left_start_v, _mm_mul_ps(left_step_v, t)));
+			__m128 r = _mm_mul_ps(frame, _mm_add_ps(right_start_v, _mm_mul_ps(right_step_v, t)));
+			//horizontal sums of l and r, together: [l0+l2, r0+r2, l1+l3, r1+r3] -> [l, r]:
+			__m128 lr = _mm_add_ps(_mm_unpacklo_ps(l, r), _mm_unpackhi_ps(l, r));
+			lr = _mm_add_ps(lr, _mm_movehl_ps(lr, lr));
+			out[f].l += _mm_cvtss_f32(lr);
+			out[f].r += _mm_cvtss_f32(_mm_shuffle_ps(lr, lr, 0x55));
+		}
+	}
+#endif
+
+	//scalar fallback:
+	for (; f < count; ++f) {
+		float t = float(f);
+		BFormatFrame const &b = in[f];
+		out[f].l += b.w * (left_start.w + t * left_step.w) + b.x * (left_start.x + t * left_step.x)
+		          + b.y * (left_start.y + t * left_step.y) + b.z * (left_start.z + t * left_step.z);
+		out[f].r += b.w * (right_start.w + t * right_step.w) + b.x * (right_start.x + t * right_step.x)
+		          + b.y * (right_start.y + t * right_step.y) + b.z * (right_start.z + t * right_step.z);
+	}
+}
+
+//---- int16 ----
+
+void encode_int16(float const *in, uint32_t count, std::vector< int16_t > *out_) {
+	assert(out_);
+	auto &out = *out_;
+	out.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		float v = std::max(-1.0f, std::min(1.0f, in[i]));
+		out[i] = int16_t(std::lround(v * 32767.0f));
+	}
+}
+
+void decode_int16(int16_t const *in, uint32_t count, float *out) {
+	uint32_t i = 0;
+
+#if defined(MIX_KERNELS_SSE)
+	{ //eight samples per iteration:
+		__m128 const scale = _mm_set1_ps(1.0f / 32767.0f);
+		for (; i + 8 <= count; i += 8) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast< __m128i const * >(in + i));
+			//sign-extend to 32 bits by unpacking into the high half and shifting back down:
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+	}
+#endif
+
+	for (; i < count; ++i) {
+		out[i] = float(in[i]) * (1.0f / 32767.0f);
+	}
+}
+
+//---- 4-bit ADPCM ----
+
+namespace {
+	//standard IMA ADPCM tables:
+	constexpr int16_t const adpcm_steps[89] = {
+		7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+		34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+		157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+		724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+		3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+		15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+	};
+	constexpr int8_t const adpcm_index_deltas[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+	//advance decoder state by one nibble; returns new predictor:
+	inline int32_t adpcm_step(uint8_t nibble, int32_t *predictor, int32_t *index) {
+		int32_t step = adpcm_steps[*index];
+		int32_t diff = step >> 3;
+		if (nibble & 4) diff += step;
+		if (nibble & 2) diff += step >> 1;
+		if (nibble & 1) diff += step >> 2;
+		if (nibble & 8) *predictor -= diff;
+		else *predictor += diff;
+		*predictor = std::max(-32768, std::min(32767, *predictor));
+		*index = std::max(0, std::min(88, *index + adpcm_index_deltas[nibble & 7]));
+		return *predictor;
+	}
+}
+
+void encode_adpcm4(float const *in, uint32_t count, std::vector< uint8_t > *out_) {
+	assert(out_);
+	auto &out = *out_;
+	uint32_t blocks = (count + ADPCM4_BLOCK_SAMPLES - 1) / ADPCM4_BLOCK_SAMPLES;
+	out.assign(size_t(blocks) * ADPCM4_BLOCK_BYTES, 0);
+
+	int32_t predictor = 0;
+	int32_t index = 0;
+	for (uint32_t b = 0; b < blocks; ++b) {
+		uint8_t *block = &out[size_t(b) * ADPCM4_BLOCK_BYTES];
+		//header records decoder state at the start of the block:
+		int16_t header_predictor = int16_t(predictor);
+		block[0] = uint8_t(uint16_t(header_predictor) & 0xff);
+		block[1] = uint8_t(uint16_t(header_predictor) >> 8);
+		block[2] = uint8_t(index);
+		block[3] = 0;
+
+		for (uint32_t s = 0; s < ADPCM4_BLOCK_SAMPLES; ++s) {
+			uint32_t i = b * ADPCM4_BLOCK_SAMPLES + s;
+			float v = (i < count ? std::max(-1.0f, std::min(1.0f, in[i])) : 0.0f);
+			int32_t target = int32_t(std::lround(v * 32767.0f));
+
+			//pick the nibble that moves the (decoder-side) predictor closest to the target:
+			int32_t step = adpcm_steps[index];
+			int32_t diff = target - predictor;
+			uint8_t nibble = 0;
+			if (diff < 0) {
+				nibble = 8;
+				diff = -diff;
+			}
+			if (diff >= step) { nibble |= 4; diff -= step; }
+			step >>= 1;
+			if (diff >= step) { nibble |= 2; diff -= step; }
+			step >>= 1;
+			if (diff >= step) { nibble |= 1; }
+
+			adpcm_step(nibble, &predictor, &index);
+			block[4 + s / 2] |= (s & 1) ? uint8_t(nibble << 4) : nibble;
+		}
+	}
+}
+
+void decode_adpcm4(uint8_t const *blocks, uint32_t first, uint32_t count, float *out) {
+	uint32_t b = first / ADPCM4_BLOCK_SAMPLES;
+	uint32_t s = first % ADPCM4_BLOCK_SAMPLES;
+	while (count > 0) {
+		uint8_t const *block = blocks + size_t(b) * ADPCM4_BLOCK_BYTES;
+		int32_t predictor = int16_t(uint16_t(block[0]) | uint16_t(block[1]) << 8);
+		int32_t index = block[2];
+
+		//decode (and discard) any samples before the requested start:
+		for (uint32_t k = 0; k < s; ++k) {
+			adpcm_step((block[4 + k / 2] >> ((k & 1) * 4)) & 0xf, &predictor, &index);
+		}
+		for (; s < ADPCM4_BLOCK_SAMPLES && count > 0; ++s, --count) {
+			int32_t v = adpcm_step((block[4 + s / 2] >> ((s & 1) * 4)) & 0xf, &predictor, &index);
+			*(out++) = float(v) * (1.0f / 32767.0f);
+		}
+		b += 1;
+		s = 0;
+	}
+}
+
+//---- resampling ----
+
+namespace {
+	//windowed-sinc filter banks, built at startup:
+	struct ResampleFilters {
+		static constexpr uint32_t const Banks = 3; //for rates up to 1, 2, and RESAMPLE_MAX_RATE
+		std::array< float, Banks * (RESAMPLE_PHASES + 1) * RESAMPLE_TAPS > taps;
+
+		ResampleFilters() {
+			//zeroth-order modified Bessel function (for the Kaiser window):
+			auto bessel_i0 = [](double x) {
+				double sum = 1.0;
+				double term = 1.0;
+				for (uint32_t k = 1; k < 32; ++k) {
+					term *= (x / (2.0 * k)) * (x / (2.0 * k));
+					sum += term;
+				}
+				return sum;
+			};
+			constexpr double const Pi = 3.14159265358979323846;
+			constexpr double const Beta = 6.0; //Kaiser window shape; trades transition width for stopband rejection
+			constexpr double const Half = RESAMPLE_TAPS / 2;
+
+			for (uint32_t b = 0; b < Banks; ++b) {
+				double max_rate = (b == 0 ? 1.0 : b == 1 ? 2.0 : double(RESAMPLE_MAX_RATE));
+				double cutoff = 0.9 / max_rate; //fraction of (input) Nyquist frequency
+				for (uint32_t p = 0; p <= RESAMPLE_PHASES; ++p) {
+					float *row = &taps[(b * (RESAMPLE_PHASES + 1) + p) * RESAMPLE_TAPS];
+					double frac = double(p) / RESAMPLE_PHASES;
+					double sum = 0.0;
+					for (uint32_t k = 0; k < RESAMPLE_TAPS; ++k) {
+						//distance from the read position to input sample k:
+						double x = double(k) - (Half - 1.0) - frac;
+						double sinc = (x == 0.0 ? 1.0 : std::sin(Pi * cutoff * x) / (Pi * cutoff * x));
+						double w = x / Half;
+						double window = (std::abs(w) >= 1.0 ? 0.0 : bessel_i0(Beta * std::sqrt(1.0 - w * w)) / bessel_i0(Beta));
+						row[k] = float(sinc * window);
+						sum += sinc * window;
+					}
+					//normalize so DC passes at unit gain:
+					for (uint32_t k = 0; k < RESAMPLE_TAPS; ++k) {
+						row[k] = float(row[k] / sum);
+					}
+				}
+			}
+		}
+	};
+	ResampleFilters const resample_filters;
+}
+
+float const *resample_filter(float max_rate) {
+	uint32_t bank = (max_rate <= 1.0f ? 0 : max_rate <= 2.0f ? 1 : 2);
+	return &resample_filters.taps[bank * (RESAMPLE_PHASES + 1) * RESAMPLE_TAPS];
+}
+
+void resample_linear(float *out, float const *in, uint32_t count,
+	float start, float rate, float accel) {
+	//n.b. positions are computed directly (not accumulated) so rounding error doesn't build up over a block:
+	for (uint32_t f = 0; f < count; ++f) {
+		float ff = float(f);
+		float pos = start + ff * rate + (0.5f * ff * (ff - 1.0f)) * accel;
+		uint32_t n = uint32_t(pos);
+		float amt = pos - float(n);
+		out[f] = in[n] + amt * (in[n + 1] - in[n]);
+	}
+}
+
+void resample_polyphase(float *out, float const *in, uint32_t count,
+	float start, float rate, float accel, float const *filter) {
+	static_assert(RESAMPLE_TAPS == 8, "kernels assume eight taps");
+	for (uint32_t f = 0; f < count; ++f) {
+		float ff = float(f);
+		float pos = start + ff * rate + (0.5f * ff * (ff - 1.0f)) * accel;
+		uint32_t n = uint32_t(pos);
+		uint32_t phase = uint32_t((pos - float(n)) * float(RESAMPLE_PHASES) + 0.5f);
+		float const *src = in + n - (RESAMPLE_TAPS / 2 - 1);
+		float const *taps = filter + phase * RESAMPLE_TAPS;
+
+#if defined(MIX_KERNELS_AVX)
+		__m256 prod = _mm256_mul_ps(_mm256_loadu_ps(src), _mm256_loadu_ps(taps));
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(prod), _mm256_extractf128_ps(prod, 1));
+#elif defined(MIX_KERNELS_SSE)
+		__m128 sum = _mm_add_ps(
+			_mm_mul_ps(_mm_loadu_ps(src), _mm_loadu_ps(taps)),
+			_mm_mul_ps(_mm_loadu_ps(src + 4), _mm_loadu_ps(taps + 4))
+		);
+#endif
+
+#if defined(MIX_KERNELS_SSE) || defined(MIX_KERNELS_AVX)
+		//horizontal add of the four lanes:
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+		sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+		out[f] = _mm_cvtss_f32(sum);
+#else
+		float acc = 0.0f;
+		for (uint32_t k = 0; k < RESAMPLE_TAPS; ++k) {
+			acc += src[k] * taps[k];
+		}
+		out[f] = acc;
+#endif
+	}
+}
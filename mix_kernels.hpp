@@ -0,0 +1,87 @@
+#pragma once
+
+/*
+ * Inner loops used by the Sound mixer.
+ *
+ * Most kernels have an SSE (and, where the compiler targets it, AVX) version,
+ * plus a plain scalar fallback for other platforms.
+ *
+ */
+
+#include <cstdint>
+#include <vector>
+
+//One interleaved frame of stereo output (matches SDL's 2-channel AUDIO_F32SYS layout):
+struct StereoFrame {
+	float l;
+	float r;
+};
+static_assert(sizeof(StereoFrame) == 8, "StereoFrame is packed");
+
+//One frame of first-order ambisonic (B-format) audio:
+// w is the omnidirectional component (scaled by 1/sqrt(2)); x, y, z are figure-eight components along the world axes.
+struct BFormatFrame {
+	float w;
+	float x;
+	float y;
+	float z;
+};
+static_assert(sizeof(BFormatFrame) == 16, "BFormatFrame is packed");
+
+//Add 'count' mono samples from 'in' into 'out', scaled by a linear gain ramp:
+// frame f (counting from the start of 'out') gets gain 'start + (first + f) * step',
+// so a ramp split into several runs [e.g., at loop boundaries] stays continuous.
+void mix_mono_ramp(StereoFrame *out, float const *in, uint32_t count,
+	StereoFrame start, StereoFrame step, uint32_t first);
+
+//mix_mono_ramp's scalar loop on its own, as if built without SSE/AVX:
+// (for comparing the two in benchmarks -- see render-audio --budget)
+void mix_mono_ramp_scalar(StereoFrame *out, float const *in, uint32_t count,
+	StereoFrame start, StereoFrame step, uint32_t first);
+
+//Add 'count' mono samples from 'in' into B-format 'out', with per-channel gains ramped as in mix_mono_ramp:
+void mix_mono_bformat(BFormatFrame *out, float const *in, uint32_t count,
+	BFormatFrame start, BFormatFrame step, uint32_t first);
+
+//Decode 'count' B-format frames from 'in' and add them to 'out' using one "virtual microphone" per output channel:
+// each output is the dot product of a frame with that channel's weights, which ramp from 'start' by 'step' per frame.
+void decode_bformat(StereoFrame *out, BFormatFrame const *in, uint32_t count,
+	BFormatFrame left_start, BFormatFrame left_step, BFormatFrame right_start, BFormatFrame right_step);
+
+//---- compressed sample storage ----
+
+//Int16 encoding: samples are scaled by 32767 and rounded (2x smaller than float):
+void encode_int16(float const *in, uint32_t count, std::vector< int16_t > *out);
+//Decode 'count' int16 samples into floats:
+void decode_int16(int16_t const *in, uint32_t count, float *out);
+
+//4-bit IMA-style ADPCM encoding (about 7x smaller than float):
+// samples are coded in independent blocks, so decoding can start at any block boundary.
+// each block is a 4-byte header (predictor, step index) followed by ADPCM4_BLOCK_SAMPLES nibbles.
+constexpr uint32_t const ADPCM4_BLOCK_SAMPLES = 64;
+constexpr uint32_t const ADPCM4_BLOCK_BYTES = 4 + ADPCM4_BLOCK_SAMPLES / 2;
+void encode_adpcm4(float const *in, uint32_t count, std::vector< uint8_t > *out);
+//Decode samples [first, first + count) from a sequence of ADPCM blocks into floats:
+void decode_adpcm4(uint8_t const *blocks, uint32_t first, uint32_t count, float *out);
+
+//---- resampling ----
+
+//Resamplers read 'in' at fractional positions, one per output frame:
+// frame f reads position 'start + f * rate + (f * (f - 1) / 2) * accel' (i.e., rate grows by 'accel' each frame).
+// With n = floor(position):
+// - resample_linear reads in[n] and in[n + 1]
+// - resample_polyphase reads in[n - RESAMPLE_TAPS / 2 + 1] through in[n + RESAMPLE_TAPS / 2]
+constexpr uint32_t const RESAMPLE_TAPS = 8;
+constexpr uint32_t const RESAMPLE_PHASES = 128;
+constexpr float const RESAMPLE_MAX_RATE = 4.0f;
+
+void resample_linear(float *out, float const *in, uint32_t count,
+	float start, float rate, float accel);
+
+//'filter' should come from resample_filter():
+void resample_polyphase(float *out, float const *in, uint32_t count,
+	float start, float rate, float accel, float const *filter);
+
+//Band-limited filter bank [(RESAMPLE_PHASES + 1) x RESAMPLE_TAPS] suitable for reading at up to 'max_rate' input samples per output frame:
+// (when max_rate > 1, the cutoff is lowered to avoid aliasing)
+float const *resample_filter(float max_rate);
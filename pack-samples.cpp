@@ -0,0 +1,70 @@
+//pack-samples: pack '.wav' files into one sample bank file (see Sound::SampleBank), for fast loading.
+// Each file is converted to 48kHz mono (with a warning, as in Sound::Sample) and stored in the encoding
+// that was most recently selected on the command line.
+
+#include "Sound.hpp"
+
+#include <SDL.h> //(for SDL_main on windows)
+
+#include <iostream>
+#include <stdexcept>
+#include <memory>
+
+static void usage(char const *argv0) {
+	std::cerr << "Usage:\n"
+		<< "\t" << argv0 << " <output.bank> [--float32|--int16|--adpcm4] NAME=file.wav [...]\n"
+		<< "(encoding options apply to all following files; the default is --float32)\n";
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	if (argc < 3) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector< std::unique_ptr< Sound::Sample > > loaded;
+	std::vector< std::pair< std::string, Sound::Sample const * > > named;
+	Sound::Sample::Encoding encoding = Sound::Sample::Float32;
+	for (int a = 2; a < argc; ++a) {
+		std::string arg = argv[a];
+		if (arg == "--float32") encoding = Sound::Sample::Float32;
+		else if (arg == "--int16") encoding = Sound::Sample::Int16;
+		else if (arg == "--adpcm4") encoding = Sound::Sample::ADPCM4;
+		else {
+			auto eq = arg.find('=');
+			if (eq == std::string::npos || eq == 0 || eq + 1 == arg.size()) {
+				std::cerr << "Expected NAME=file.wav, got '" << arg << "'." << std::endl;
+				usage(argv[0]);
+				return 1;
+			}
+			loaded.emplace_back(new Sound::Sample(arg.substr(eq + 1), Sound::Sample::Resident, encoding));
+			named.emplace_back(arg.substr(0, eq), loaded.back().get());
+		}
+	}
+
+	Sound::SampleBank::write(argv[1], named);
+	std::cout << "Wrote " << named.size() << " samples to '" << argv[1] << "'." << std::endl;
+
+	//check that the bank reads back:
+	Sound::SampleBank bank(argv[1]);
+	if (bank.samples.size() != named.size()) {
+		std::cerr << "WARNING: bank has " << bank.samples.size() << " samples (names may be duplicated)." << std::endl;
+	}
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
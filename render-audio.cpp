@@ -0,0 +1,767 @@
+//render-audio: drive the Sound mixer offline (no audio device, no real-time clock).
+// - render a script of play/set/stop commands to a '.wav' (or '.raw' float) file, deterministically
+// - or benchmark mixing throughput at various voice counts
+// - or find how many voices fit in one block's time budget, with and without the SIMD mixing kernel
+// - or measure latency from Sound::play to output at each block size
+// - or stress the voice pool with thousands of plays per second, checking handles and heap allocations
+// - or check that streamed samples whose files go missing (or come up short) still finish
+
+#include "Sound.hpp"
+#include "load_wav.hpp"
+#include "count_allocations.hpp"
+#include "mix_kernels.hpp"
+
+#include <SDL.h> //(for SDL_main on windows)
+
+#include <ctime>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+
+//The script format is one command per line; '#' starts a comment. Each command starts with a time (in seconds):
+//  T sample NAME file.wav [streamed] [float32|int16|adpcm4]   -- load a sample (loaded before rendering starts)
+//  T bank file.bank                                           -- map a sample bank; its samples are used by name
+//  T play HANDLE SAMPLE [volume [pan]]                        -- (also: loop)
+//  T play_3D HANDLE SAMPLE volume x y z [half_volume_radius]  -- (also: loop_3D)
+//  T set_volume HANDLE value [ramp]                           -- (also: set_pan, set_half_volume_radius, set_rate)
+//  T set_position HANDLE x y z [ramp]
+//  T set_priority HANDLE priority
+//  T set_interpolation HANDLE linear|polyphase
+//  T stop HANDLE [ramp]
+//  T listener x y z right_x right_y right_z [ramp]
+//  T volume value [ramp]
+//  T ambisonics on|off                                        -- mix 3D samples through the ambisonic bus
+//  T hrtf file.hrtf|off                                       -- decode the ambisonic bus binaurally
+//  T end                                                      -- stop rendering
+//Commands are issued once the rendered time reaches T, and take effect at the next mixer block.
+
+struct ScriptCommand {
+	uint64_t frame = 0; //when to issue the command
+	uint32_t line = 0; //for error messages
+	std::vector< std::string > args; //command name and arguments (time stripped)
+};
+
+static void usage(char const *argv0) {
+	std::cerr << "Usage:\n"
+		<< "\t" << argv0 << " <script.txt> <output.wav|output.raw>\n"
+		<< "\t" << argv0 << " --benchmark [sample.wav] [seconds] [file.hrtf]\n"
+		<< "\t" << argv0 << " --budget\n"
+		<< "\t" << argv0 << " --latency\n"
+		<< "\t" << argv0 << " --stress [seconds]\n"
+		<< "\t" << argv0 << " --stream-failure\n";
+}
+
+//helper: 'frames' samples of (deterministic) noise:
+static std::vector< float > make_noise(uint32_t frames, uint32_t seed = 0x12345678) {
+	std::vector< float > data(frames);
+	uint32_t state = seed;
+	for (auto &d : data) {
+		state = state * 1664525u + 1013904223u;
+		d = float(state >> 8) / float(1 << 24) * 2.0f - 1.0f;
+	}
+	return data;
+}
+
+//------------------------ script playback ------------------------
+
+static int render_script(std::string const &script_file, std::string const &output_file) {
+	std::ifstream script(script_file);
+	if (!script) {
+		throw std::runtime_error("Failed to open script '" + script_file + "'.");
+	}
+
+	Sound::init_offline();
+
+	//read commands (loading samples as they are mentioned):
+	std::map< std::string, std::unique_ptr< Sound::Sample > > samples;
+	std::vector< std::unique_ptr< Sound::SampleBank > > banks; //(searched, in order, for samples not named above)
+	std::vector< ScriptCommand > commands;
+	uint64_t end_frame = 0;
+	bool have_end = false;
+	{
+		std::string line_text;
+		uint32_t line = 0;
+		while (std::getline(script, line_text)) {
+			line += 1;
+			line_text = line_text.substr(0, line_text.find('#'));
+			std::istringstream str(line_text);
+			float time;
+			if (!(str >> time)) continue; //blank line
+			ScriptCommand command;
+			command.frame = uint64_t(std::max(0.0, double(time) * 48000.0 + 0.5));
+			command.line = line;
+			std::string arg;
+			while (str >> arg) command.args.emplace_back(arg);
+			if (command.args.empty()) {
+				throw std::runtime_error(script_file + ":" + std::to_string(line) + ": expected a command after the time.");
+			}
+
+			if (command.args[0] == "sample") {
+				if (command.args.size() < 3) {
+					throw std::runtime_error(script_file + ":" + std::to_string(line) + ": expected 'sample NAME file.wav'.");
+				}
+				Sound::Sample::Storage storage = Sound::Sample::Resident;
+				Sound::Sample::Encoding encoding = Sound::Sample::Float32;
+				for (uint32_t a = 3; a < command.args.size(); ++a) {
+					if (command.args[a] == "streamed") storage = Sound::Sample::Streamed;
+					else if (command.args[a] == "float32") encoding = Sound::Sample::Float32;
+					else if (command.args[a] == "int16") encoding = Sound::Sample::Int16;
+					else if (command.args[a] == "adpcm4") encoding = Sound::Sample::ADPCM4;
+					else throw std::runtime_error(script_file + ":" + std::to_string(line) + ": unknown sample option '" + command.args[a] + "'.");
+				}
+				samples[command.args[1]].reset(new Sound::Sample(command.args[2], storage, encoding));
+				continue;
+			}
+			if (command.args[0] == "bank") {
+				if (command.args.size() != 2) {
+					throw std::runtime_error(script_file + ":" + std::to_string(line) + ": expected 'bank file.bank'.");
+				}
+				banks.emplace_back(new Sound::SampleBank(command.args[1]));
+				continue;
+			}
+			if (command.args[0] == "end") {
+				end_frame = have_end ? std::min(end_frame, command.frame) : command.frame;
+				have_end = true;
+				continue;
+			}
+			commands.emplace_back(command);
+		}
+	}
+	std::stable_sort(commands.begin(), commands.end(), [](ScriptCommand const &a, ScriptCommand const &b) {
+		return a.frame < b.frame;
+	});
+	if (!have_end) {
+		throw std::runtime_error("Script '" + script_file + "' has no 'end' command.");
+	}
+
+	std::map< std::string, Sound::PlayingSample > handles;
+
+	//issue one command:
+	auto issue = [&](ScriptCommand const &command) {
+		auto const &args = command.args;
+		auto fail = [&](std::string const &message) {
+			throw std::runtime_error(script_file + ":" + std::to_string(command.line) + ": " + message);
+		};
+		//argument helpers:
+		auto number = [&](uint32_t a, float fallback) -> float {
+			if (a >= args.size()) return fallback;
+			try {
+				return std::stof(args[a]);
+			} catch (std::exception &) {
+				fail("expected a number, got '" + args[a] + "'.");
+				return 0.0f;
+			}
+		};
+		auto need = [&](uint32_t count) {
+			if (args.size() < count) fail("'" + args[0] + "' needs " + std::to_string(count - 1) + " arguments.");
+		};
+		auto sample = [&](uint32_t a) -> Sound::Sample const & {
+			auto f = samples.find(args[a]);
+			if (f != samples.end()) return *f->second;
+			for (auto const &bank : banks) {
+				auto b = bank->samples.find(args[a]);
+				if (b != bank->samples.end()) return b->second;
+			}
+			fail("no sample named '" + args[a] + "'.");
+			return *f->second;
+		};
+		auto handle = [&](uint32_t a) -> Sound::PlayingSample const & {
+			auto f = handles.find(args[a]);
+			if (f == handles.end()) fail("no playing sample named '" + args[a] + "'.");
+			return f->second;
+		};
+		float const default_ramp = 1.0f / 60.0f;
+
+		std::string const &name = args[0];
+		if (name == "play" || name == "loop") {
+			need(3);
+			auto play = (name == "play" ? Sound::play : Sound::loop);
+			handles[args[1]] = play(sample(2), number(3, 1.0f), number(4, 0.0f));
+		} else if (name == "play_3D" || name == "loop_3D") {
+			need(7);
+			auto play = (name == "play_3D" ? Sound::play_3D : Sound::loop_3D);
+			glm::vec3 position(number(4, 0.0f), number(5, 0.0f), number(6, 0.0f));
+			handles[args[1]] = play(sample(2), number(3, 1.0f), position, number(7, std::numeric_limits< float >::infinity()));
+		} else if (name == "set_volume") {
+			need(3);
+			handle(1).set_volume(number(2, 1.0f), number(3, default_ramp));
+		} else if (name == "set_pan") {
+			need(3);
+			handle(1).set_pan(number(2, 0.0f), number(3, default_ramp));
+		} else if (name == "set_half_volume_radius") {
+			need(3);
+			handle(1).set_half_volume_radius(number(2, 1.0f), number(3, default_ramp));
+		} else if (name == "set_rate") {
+			need(3);
+			handle(1).set_rate(number(2, 1.0f), number(3, default_ramp));
+		} else if (name == "set_position") {
+			need(5);
+			handle(1).set_position(glm::vec3(number(2, 0.0f), number(3, 0.0f), number(4, 0.0f)), number(5, default_ramp));
+		} else if (name == "set_priority") {
+			need(3);
+			handle(1).set_priority(int32_t(number(2, 0.0f)));
+		} else if (name == "set_interpolation") {
+			need(3);
+			if (args[2] == "linear") handle(1).set_interpolation(Sound::Linear);
+			else if (args[2] == "polyphase") handle(1).set_interpolation(Sound::Polyphase);
+			else fail("expected 'linear' or 'polyphase'.");
+		} else if (name == "stop") {
+			need(2);
+			handle(1).stop(number(2, default_ramp));
+		} else if (name == "listener") {
+			need(7);
+			Sound::listener.set_position_right(
+				glm::vec3(number(1, 0.0f), number(2, 0.0f), number(3, 0.0f)),
+				glm::vec3(number(4, 1.0f), number(5, 0.0f), number(6, 0.0f)),
+				number(7, default_ramp));
+		} else if (name == "volume") {
+			need(2);
+			Sound::set_volume(number(1, 1.0f), number(2, default_ramp));
+		} else if (name == "ambisonics") {
+			need(2);
+			if (args[1] == "on") Sound::set_ambisonics(true);
+			else if (args[1] == "off") Sound::set_ambisonics(false);
+			else fail("expected 'on' or 'off'.");
+		} else if (name == "hrtf") {
+			need(2);
+			Sound::set_hrtf(args[1] == "off" ? "" : args[1]);
+		} else {
+			fail("unknown command '" + name + "'.");
+		}
+	};
+
+	//render, stopping to issue commands as their times come up:
+	std::vector< float > output(size_t(end_frame) * 2, 0.0f);
+	auto next = commands.begin();
+	while (Sound::get_rendered_frames() < end_frame) {
+		while (next != commands.end() && next->frame <= Sound::get_rendered_frames()) {
+			issue(*next);
+			++next;
+		}
+		uint64_t until = (next != commands.end() ? std::min(next->frame, end_frame) : end_frame);
+		uint64_t at = Sound::get_rendered_frames();
+		Sound::render(output.data() + at * 2, uint32_t(until - at));
+	}
+
+	Sound::shutdown();
+
+	//write output:
+	if (output_file.size() >= 4 && output_file.substr(output_file.size() - 4) == ".raw") {
+		std::ofstream out(output_file, std::ios::binary);
+		out.write(reinterpret_cast< char const * >(output.data()), output.size() * sizeof(float));
+		if (!out) throw std::runtime_error("Failed to write '" + output_file + "'.");
+	} else {
+		save_wav(output_file, 48000, 2, output);
+	}
+	std::cout << "Rendered " << end_frame << " frames to '" << output_file << "'." << std::endl;
+	return 0;
+}
+
+//------------------------ benchmark ------------------------
+
+static int benchmark(std::string const &sample_file, float seconds, std::string const &hrtf_file) {
+	//the sample every voice plays:
+	std::vector< float > data;
+	if (sample_file != "") {
+		load_wav(sample_file, &data);
+	} else {
+		//one second of noise:
+		data = make_noise(48000);
+	}
+
+	struct Config {
+		char const *name;
+		Sound::Sample::Encoding encoding;
+		float rate;
+		Sound::Interpolation interpolation;
+		bool spatial; //play in 3D (around the listener) rather than panned in 2D
+		bool ambisonic; //...through the ambisonic bus
+		bool binaural; //...decoded with 'hrtf_file'
+	};
+	std::vector< Config > configs{
+		{"float32", Sound::Sample::Float32, 1.0f, Sound::Polyphase, false, false, false},
+		{"adpcm4", Sound::Sample::ADPCM4, 1.0f, Sound::Polyphase, false, false, false},
+		{"linear x1.1", Sound::Sample::Float32, 1.1f, Sound::Linear, false, false, false},
+		{"polyphase x1.1", Sound::Sample::Float32, 1.1f, Sound::Polyphase, false, false, false},
+		{"3D pan", Sound::Sample::Float32, 1.0f, Sound::Polyphase, true, false, false},
+		{"3D ambisonic", Sound::Sample::Float32, 1.0f, Sound::Polyphase, true, true, false},
+	};
+	if (hrtf_file != "") {
+		configs.push_back(Config{"3D binaural", Sound::Sample::Float32, 1.0f, Sound::Polyphase, true, true, true});
+	}
+
+	uint32_t frames = uint32_t(seconds * 48000.0f);
+	std::vector< float > output(size_t(frames) * 2);
+
+	std::cout << std::setw(8) << "voices" << std::setw(16) << "config" << std::setw(10) << "workers"
+		<< std::setw(16) << "frames/cpu-sec" << std::setw(12) << "realtime"
+		<< std::setw(16) << "frames/sec" << std::setw(12) << "realtime" << std::endl;
+	for (uint32_t voices : {1, 16, 64, 128, 256, 1024}) {
+		for (auto const &config : configs) for (uint32_t workers : {0U, -1U}) {
+			if (workers != 0 && voices < 64) continue; //(too few voices to split into groups)
+			Sound::init_offline(voices, workers);
+			Sound::set_max_real_voices(voices); //mix every voice
+			Sound::set_ambisonics(config.ambisonic);
+			if (config.binaural) Sound::set_hrtf(hrtf_file);
+			Sound::Sample sample(data, config.encoding);
+			for (uint32_t v = 0; v < voices; ++v) {
+				Sound::PlayingSample playing;
+				if (config.spatial) {
+					//spread voices around the listener (at the origin, facing +y) at a few distances:
+					float ang = 2.0f * 3.1415926f * float(v) / float(voices);
+					float dist = 1.0f + float(v % 4);
+					glm::vec3 position(dist * std::cos(ang), dist * std::sin(ang), 0.5f * float(v % 3) - 0.5f);
+					playing = Sound::loop_3D(sample, 1.0f / voices, position, 4.0f);
+				} else {
+					float pan = (voices > 1 ? -1.0f + 2.0f * float(v) / float(voices - 1) : 0.0f);
+					playing = Sound::loop(sample, 1.0f / voices, pan);
+				}
+				if (config.rate != 1.0f) {
+					playing.set_interpolation(config.interpolation);
+					playing.set_rate(config.rate, 0.0f);
+				}
+			}
+
+			//n.b. CPU time includes time spent by mix workers, so wall-clock time is reported as well:
+			std::clock_t before = std::clock();
+			auto wall_before = std::chrono::high_resolution_clock::now();
+			Sound::render(output.data(), frames);
+			auto wall_after = std::chrono::high_resolution_clock::now();
+			std::clock_t after = std::clock();
+
+			double cpu = double(after - before) / CLOCKS_PER_SEC;
+			double wall = std::chrono::duration< double >(wall_after - wall_before).count();
+			double rate = (cpu > 0.0 ? frames / cpu : std::numeric_limits< double >::infinity());
+			double wall_rate = (wall > 0.0 ? frames / wall : std::numeric_limits< double >::infinity());
+			std::cout << std::setw(8) << voices << std::setw(16) << config.name << std::setw(10) << (workers == -1U ? "auto" : "0")
+				<< std::setw(16) << std::fixed << std::setprecision(0) << rate
+				<< std::setw(11) << std::setprecision(1) << rate / 48000.0 << "x"
+				<< std::setw(16) << std::setprecision(0) << wall_rate
+				<< std::setw(11) << std::setprecision(1) << wall_rate / 48000.0 << "x" << std::endl;
+
+			//per-stream convolution cost:
+			for (auto const &convolution : Sound::get_mix_stats().convolutions) {
+				std::cout << std::setw(34) << convolution.name << ": " << convolution.partitions << " partitions, "
+					<< std::setprecision(1) << convolution.average_time << "us average, " << convolution.max_time << "us max per block" << std::endl;
+			}
+
+			Sound::shutdown();
+		}
+	}
+	return 0;
+}
+
+//------------------------ voices per block budget ------------------------
+
+static int budget() {
+	//voices loop one second of noise (float32, panned in 2D, rate 1), and every voice is mixed on the audio thread alone:
+	std::vector< float > data = make_noise(48000);
+	constexpr uint32_t const Block = 1024;
+	constexpr uint32_t const Blocks = 16; //timed blocks per trial
+	float const budget_us = 1.0e6f * Block / 48000.0f;
+
+	//average time (microseconds) to mix one block of 'voices' voices:
+	auto block_time = [&](uint32_t voices) {
+		Sound::init_offline(voices, 0, Block);
+		Sound::set_max_real_voices(voices);
+		Sound::Sample sample(data);
+		for (uint32_t v = 0; v < voices; ++v) {
+			float pan = (voices > 1 ? -1.0f + 2.0f * float(v) / float(voices - 1) : 0.0f);
+			Sound::loop(sample, 0.001f, pan); //(quiet, but well above the level where voices are virtualized)
+		}
+		std::vector< float > output(2 * Block);
+		Sound::render(output.data(), Block); //(voices start during the first block)
+		Sound::reset_mix_stats();
+		for (uint32_t b = 0; b < Blocks; ++b) {
+			Sound::render(output.data(), Block);
+		}
+		float time = Sound::get_mix_stats().average_time;
+		if (Sound::get_real_voice_count() != voices) {
+			throw std::runtime_error("Only " + std::to_string(Sound::get_real_voice_count()) + " of " + std::to_string(voices) + " voices were mixed.");
+		}
+		Sound::shutdown();
+		return time;
+	};
+
+	std::cout << "Voices mixed per " << Block << "-sample block in the block's " << std::fixed << std::setprecision(0) << budget_us << "us budget (one thread):" << std::endl;
+
+	//whole mixer (as shipped): double the voice count until a block takes longer than its budget, then bisect (to within 1%):
+	uint32_t under = 0, over = 256;
+	while (block_time(over) < budget_us) {
+		under = over;
+		over *= 2;
+	}
+	while (over - under > std::max(1U, under / 100)) {
+		uint32_t mid = (under + over) / 2;
+		if (block_time(mid) < budget_us) under = mid;
+		else over = mid;
+	}
+	float mixer_us = (under ? budget_us / under : 0.0f);
+	std::cout << "  mixer: " << under << " voices (" << std::setprecision(3) << mixer_us << "us per voice)" << std::endl;
+
+	//the gain/pan kernel alone, SIMD (mix_mono_ramp) vs. scalar (mix_mono_ramp_scalar), each called directly:
+	// (time per voice-block)
+	constexpr uint32_t const Calls = 20000;
+	std::vector< StereoFrame > mixed(Block, StereoFrame{0.0f, 0.0f});
+	StereoFrame const start{0.5f, 0.25f};
+	StereoFrame const step{1.0e-6f, -1.0e-6f};
+	typedef void (*Kernel)(StereoFrame *, float const *, uint32_t, StereoFrame, StereoFrame, uint32_t);
+	auto kernel_time = [&](Kernel kernel) {
+		kernel(mixed.data(), data.data(), Block, start, step, 0); //(warm up)
+		auto before = std::chrono::high_resolution_clock::now();
+		for (uint32_t c = 0; c < Calls; ++c) {
+			kernel(mixed.data(), data.data() + (c % 32), Block, start, step, 0);
+		}
+		auto after = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration< float, std::micro >(after - before).count() / Calls;
+	};
+	float vector_us = kernel_time(mix_mono_ramp);
+	float scalar_us = kernel_time(mix_mono_ramp_scalar);
+
+	std::cout << std::setw(10) << "kernel" << std::setw(10) << "voices" << std::setw(16) << "us per voice" << std::endl;
+	std::cout << std::setw(10) << "vector" << std::setw(10) << uint32_t(budget_us / vector_us)
+		<< std::setw(16) << std::setprecision(3) << vector_us << std::endl;
+	std::cout << std::setw(10) << "scalar" << std::setw(10) << uint32_t(budget_us / scalar_us)
+		<< std::setw(16) << std::setprecision(3) << scalar_us << std::endl;
+	std::cout << "vector / scalar: " << std::setprecision(2) << scalar_us / vector_us << "x (kernel alone)" << std::endl;
+	//the rest of the mixer's per-voice cost doesn't depend on the kernel, so estimate the whole mixer with the scalar kernel:
+	if (under) {
+		float scalar_mixer_us = mixer_us - vector_us + scalar_us;
+		std::cout << "mixer with the scalar kernel (estimated): " << uint32_t(budget_us / scalar_mixer_us) << " voices; vector / scalar: "
+			<< std::setprecision(2) << scalar_mixer_us / mixer_us << "x" << std::endl;
+	}
+	return 0;
+}
+
+//------------------------ latency ------------------------
+
+static int latency() {
+	//a sample that's audible from its first frame:
+	std::vector< float > click(4800, 1.0f);
+
+	std::cout << std::setw(8) << "block" << std::setw(12) << "min" << std::setw(12) << "average" << std::setw(12) << "max"
+		<< std::setw(16) << "stats average" << std::endl;
+	for (uint32_t block : {128, 256, 512, 1024}) {
+		Sound::init_offline(16, 0, block);
+		Sound::Sample sample(click);
+		std::vector< float > output(2 * 4096);
+
+		//play at (deterministic) pseudo-random times and count frames until the click is heard:
+		uint32_t state = 0x12345678;
+		uint32_t const Trials = 200;
+		uint64_t least = -1ULL, most = 0, total = 0;
+		for (uint32_t trial = 0; trial < Trials; ++trial) {
+			state = state * 1664525u + 1013904223u;
+			Sound::render(output.data(), (state >> 8) % 2000); //(arbitrary offset from the block boundary)
+
+			Sound::PlayingSample playing = Sound::play(sample);
+			uint64_t frames = 0;
+			while (true) {
+				Sound::render(output.data(), 1);
+				if (output[0] != 0.0f) break;
+				frames += 1;
+			}
+			least = std::min(least, frames);
+			most = std::max(most, frames);
+			total += frames;
+
+			//let the click finish before the next trial:
+			playing.stop(0.0f);
+			while (!playing.stopped()) {
+				Sound::render(output.data(), block);
+			}
+			Sound::render(output.data(), block);
+		}
+
+		auto ms = [](double frames) { return 1000.0 * frames / 48000.0; };
+		std::cout << std::setw(8) << block << std::fixed << std::setprecision(2)
+			<< std::setw(10) << ms(double(least)) << "ms"
+			<< std::setw(10) << ms(double(total) / Trials) << "ms"
+			<< std::setw(10) << ms(double(most)) << "ms"
+			<< std::setw(14) << Sound::get_mix_stats().average_play_latency / 1000.0f << "ms" << std::endl;
+
+		Sound::shutdown();
+	}
+	std::cout << "(offline: no device buffering; real-time playback adds at least one block [see MixStats::output_latency] plus OS buffering)" << std::endl;
+	return 0;
+}
+
+//------------------------ voice pool stress test ------------------------
+
+static int stress(float seconds) {
+	constexpr uint32_t const Voices = 256; //pool size
+	constexpr uint32_t const TickFrames = 800; //the "game" updates at 60Hz...
+	constexpr uint32_t const PlaysPerTick = 50; //...starting 3000 one-shots per second (more than the pool can hold)
+	constexpr uint32_t const Tracked = 2048; //recent handles, checked every tick
+
+	Sound::init_offline(Voices, -1U, 256);
+
+	//one-shots from 20ms to 250ms long (in each encoding), and a longer sample to loop:
+	std::vector< std::unique_ptr< Sound::Sample > > one_shots;
+	one_shots.emplace_back(new Sound::Sample(make_noise(960, 1)));
+	one_shots.emplace_back(new Sound::Sample(make_noise(2400, 2), Sound::Sample::Int16));
+	one_shots.emplace_back(new Sound::Sample(make_noise(4800, 3), Sound::Sample::ADPCM4));
+	one_shots.emplace_back(new Sound::Sample(make_noise(12000, 4)));
+	Sound::Sample long_sample(make_noise(48000, 5));
+
+	uint32_t failures = 0;
+	auto fail = [&](std::string const &message) {
+		if (failures < 10) std::cout << "FAIL: " << message << std::endl;
+		failures += 1;
+	};
+
+	uint32_t state = 0x12345678;
+	auto random = [&]() -> uint32_t {
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	};
+
+	//heap allocations (see count_allocations.hpp) during Sound calls made by the "game", and during mixing:
+	uint64_t game_allocations = 0, mix_allocations = 0;
+	std::vector< float > output(size_t(TickFrames) * 2);
+	auto render = [&]() {
+		uint64_t before = get_allocation_count();
+		Sound::render(output.data(), TickFrames);
+		mix_allocations += get_allocation_count() - before;
+	};
+
+	struct Handle {
+		Sound::PlayingSample playing;
+		bool seen_stopped = false;
+	};
+	std::vector< Handle > handles(Tracked); //ring of recent handles
+	uint32_t next_handle = 0;
+	std::vector< Sound::PlayingSample > last_on_voice(Voices); //most recent handle that got each voice
+
+	uint64_t plays = 0, started = 0, dropped = 0, pokes = 0;
+	uint32_t ticks = uint32_t(seconds * 60.0f);
+	for (uint32_t tick = 0; tick < ticks; ++tick) {
+		//once a handle has stopped, it must stay stopped (even though its voice has probably been reused since):
+		for (auto &handle : handles) {
+			if (handle.playing.stopped()) handle.seen_stopped = true;
+			else if (handle.seen_stopped) fail("tick " + std::to_string(tick) + ": a stopped handle (voice " + std::to_string(handle.playing.voice) + ") is playing again.");
+		}
+
+		for (uint32_t p = 0; p < PlaysPerTick; ++p) {
+			Sound::Sample const &sample = *one_shots[random() % one_shots.size()];
+			uint64_t before = get_allocation_count();
+			Sound::PlayingSample playing;
+			if (random() % 4 == 0) {
+				glm::vec3 position(float(random() % 21) - 10.0f, float(random() % 21) - 10.0f, 0.0f);
+				playing = Sound::play_3D(sample, 0.1f, position, 2.0f);
+			} else {
+				playing = Sound::play(sample, 0.1f, float(random() % 201) / 100.0f - 1.0f);
+			}
+			game_allocations += get_allocation_count() - before;
+			plays += 1;
+			if (playing.stopped()) {
+				dropped += 1; //every voice was busy
+			} else {
+				started += 1;
+				//the voice must not still belong to an earlier handle:
+				Sound::PlayingSample &previous = last_on_voice[playing.voice];
+				if (!previous.stopped()) fail("voice " + std::to_string(playing.voice) + " was handed out while still playing.");
+				if (previous.voice == playing.voice && previous.generation == playing.generation) fail("voice " + std::to_string(playing.voice) + " was reused without a new generation.");
+				previous = playing;
+				handles[next_handle++ % Tracked] = Handle{playing, false};
+			}
+
+			//poke a recent handle (which has often finished already):
+			Sound::PlayingSample const &other = handles[random() % Tracked].playing;
+			before = get_allocation_count();
+			switch (random() % 4) {
+				case 0: other.stop(random() % 2 ? 0.0f : 1.0f / 60.0f); break;
+				case 1: other.set_volume(0.05f); break;
+				case 2: other.set_rate(0.5f + float(random() % 100) / 100.0f); break;
+				default: other.set_priority(int32_t(random() % 3)); break;
+			}
+			game_allocations += get_allocation_count() - before;
+			pokes += 1;
+		}
+
+		render();
+	}
+	uint32_t peak_voices = Sound::get_mix_stats().peak_voices;
+
+	auto all_stopped = [](std::vector< Sound::PlayingSample > const &list) {
+		for (auto const &playing : list) {
+			if (!playing.stopped()) return false;
+		}
+		return true;
+	};
+
+	//stop everything; the mixer should finish every voice:
+	Sound::stop_all_samples();
+	for (uint32_t tick = 0; tick < 60 && !all_stopped(last_on_voice); ++tick) {
+		render();
+	}
+	if (!all_stopped(last_on_voice)) fail("voices still playing a second after stop_all_samples().");
+
+	//...and every voice should be back in the pool:
+	std::vector< Sound::PlayingSample > loops(Voices);
+	for (uint32_t v = 0; v < Voices; ++v) {
+		uint64_t before = get_allocation_count();
+		loops[v] = Sound::loop(long_sample, 1.0f / Voices);
+		game_allocations += get_allocation_count() - before;
+		if (loops[v].stopped()) {
+			fail("only " + std::to_string(v) + " of " + std::to_string(Voices) + " voices were free once everything stopped.");
+			break;
+		}
+	}
+	if (!Sound::play(long_sample).stopped()) fail("more than " + std::to_string(Voices) + " voices were handed out.");
+
+	//calls through stale handles (whose voices are now all playing loops) must be ignored:
+	for (auto const &handle : handles) {
+		uint64_t before = get_allocation_count();
+		handle.playing.set_volume(0.0f, 0.0f);
+		handle.playing.stop(0.0f);
+		game_allocations += get_allocation_count() - before;
+	}
+	render();
+	render();
+	uint32_t still_looping = 0;
+	for (auto const &playing : loops) {
+		if (!playing.stopped()) still_looping += 1;
+	}
+	if (still_looping != Voices) fail("stale handles stopped " + std::to_string(Voices - still_looping) + " of the voices that replaced them.");
+
+	Sound::stop_all_samples();
+	for (uint32_t tick = 0; tick < 60 && !all_stopped(loops); ++tick) {
+		render();
+	}
+	if (!all_stopped(loops)) fail("loops still playing a second after stop_all_samples().");
+
+	if (mix_allocations != 0) fail("mixing allocated memory " + std::to_string(mix_allocations) + " times.");
+	if (game_allocations != 0) fail("play/stop/set_* allocated memory " + std::to_string(game_allocations) + " times.");
+
+	std::cout << plays << " plays over " << ticks / 60.0f << "s into a pool of " << Voices << " voices: "
+		<< started << " started, " << dropped << " dropped (pool full); peak of " << peak_voices << " voices playing.\n"
+		<< pokes << " stop/set_* calls on recent handles.\n"
+		<< "Heap allocations: " << mix_allocations << " while mixing, " << game_allocations << " in play/stop/set_* calls." << std::endl;
+
+	Sound::shutdown();
+
+	if (failures) {
+		std::cout << "FAILED (" << failures << " problems)." << std::endl;
+		return 1;
+	}
+	std::cout << "PASSED." << std::endl;
+	return 0;
+}
+
+//------------------------ stream failure ------------------------
+
+static int stream_failure() {
+	constexpr uint32_t const Plays = 8; //(more than the mixer's limit on simultaneous streams, so leaked streams show up)
+	std::string const wav_file = "render-audio-stream-failure.wav";
+
+	Sound::init_offline(16, 0, 1024);
+	std::vector< float > output(2 * 1024);
+
+	uint32_t failures = 0;
+	//'seconds' is how much of the sample can still be read after break_file(), so how long each play should last:
+	auto check = [&](std::string const &what, float seconds, std::function< void() > const &break_file) {
+		//two seconds of noise, of which only the first half-second is resident:
+		save_wav(wav_file, 48000, 1, make_noise(2 * 48000));
+		Sound::Sample sample(wav_file, Sound::Sample::Streamed);
+		if (!sample.streamed()) throw std::runtime_error("'" + wav_file + "' didn't load as a streamed sample.");
+		break_file();
+
+		//each (looping) voice must end once the stream runs dry, freeing its voice and stream for the next:
+		for (uint32_t play = 0; play < Plays; ++play) {
+			Sound::PlayingSample playing = Sound::loop(sample);
+			if (playing.stopped()) {
+				std::cout << "FAIL: " << what << ": play " << play << " didn't start (no free voice or stream)." << std::endl;
+				failures += 1;
+				break;
+			}
+			uint64_t start = Sound::get_rendered_frames();
+			while (!playing.stopped() && Sound::get_rendered_frames() - start < 10 * 48000) {
+				Sound::render(output.data(), 1024);
+			}
+			if (!playing.stopped()) {
+				std::cout << "FAIL: " << what << ": play " << play << " was still playing after 10 seconds." << std::endl;
+				failures += 1;
+				break;
+			}
+			double played = (Sound::get_rendered_frames() - start) / 48000.0;
+			std::cout << what << ": play " << play << " ended after " << played << "s." << std::endl;
+			//(ends are noticed at block boundaries, so allow a couple of blocks of slack)
+			if (played < seconds || played > seconds + 2.0 * 1024.0 / 48000.0) {
+				std::cout << "FAIL: " << what << ": play " << play << " should have lasted " << seconds << "s." << std::endl;
+				failures += 1;
+				break;
+			}
+		}
+	};
+
+	check("file removed", 0.5f, [&]() {
+		std::remove(wav_file.c_str());
+	});
+	check("file truncated", 0.75f, [&]() {
+		//keep the header and 0.75 seconds of data:
+		std::ifstream in(wav_file, std::ios::binary);
+		std::vector< char > data((std::istreambuf_iterator< char >(in)), std::istreambuf_iterator< char >());
+		in.close();
+		data.resize(std::min< size_t >(data.size(), 44 + 36000 * sizeof(float)));
+		std::ofstream out(wav_file, std::ios::binary);
+		out.write(data.data(), std::streamsize(data.size()));
+	});
+	std::remove(wav_file.c_str());
+
+	Sound::shutdown();
+
+	if (failures) {
+		std::cout << "FAILED (" << failures << " problems)." << std::endl;
+		return 1;
+	}
+	std::cout << "PASSED." << std::endl;
+	return 0;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	if (argc >= 2 && std::string(argv[1]) == "--benchmark" && argc <= 5) {
+		std::string sample_file = (argc >= 3 ? argv[2] : "");
+		float seconds = (argc >= 4 ? std::stof(argv[3]) : 10.0f);
+		std::string hrtf_file = (argc >= 5 ? argv[4] : "");
+		return benchmark(sample_file, seconds, hrtf_file);
+	} else if (argc == 2 && std::string(argv[1]) == "--budget") {
+		return budget();
+	} else if (argc == 2 && std::string(argv[1]) == "--latency") {
+		return latency();
+	} else if (argc >= 2 && std::string(argv[1]) == "--stress" && argc <= 3) {
+		return stress(argc >= 3 ? std::stof(argv[2]) : 10.0f);
+	} else if (argc == 2 && std::string(argv[1]) == "--stream-failure") {
+		return stream_failure();
+	} else if (argc == 3) {
+		return render_script(argv[1], argv[2]);
+	} else {
+		usage(argv[0]);
+		return 1;
+	}
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -2,7 +2,12 @@
 #include "ShowMeshesMode.hpp"
 #include "Load.hpp"
 #include "GL.hpp"
+#include "gl_debug.hpp"
 #include "load_save_png.hpp"
+#include "DrawLines.hpp"
+#include "Profiler.hpp"
+#include "draw_profiler.hpp"
+#include "Headless.hpp"
 
 #include <SDL.h>
 
@@ -20,58 +25,69 @@ int main(int argc, char **argv) {
 
 	//------------  initialization ------------
 
-	//Initialize SDL library:
-	SDL_Init(SDL_INIT_VIDEO);
-
-	//Ask for an OpenGL context version 3.3, core profile, enable debug:
-	SDL_GL_ResetAttributes();
-	SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
-
-	//create window:
-	SDL_Window *window = SDL_CreateWindow(
-		"pnct viewer",
-		SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-		800, 800,
-		SDL_WINDOW_OPENGL
-		| SDL_WINDOW_RESIZABLE //uncomment to allow resizing
-		| SDL_WINDOW_ALLOW_HIGHDPI //uncomment for full resolution on high-DPI screens
-	);
-
-	//prevent exceedingly tiny windows when resizing:
-	SDL_SetWindowMinimumSize(window, 100, 100);
-
-	if (!window) {
-		std::cerr << "Error creating SDL window: " << SDL_GetError() << std::endl;
-		return 1;
-	}
+	//Headless mode renders offscreen instead of in a window, and prints timings (see Headless.hpp):
+	Headless headless(&argc, argv);
+	SDL_Window *window = nullptr;
+	SDL_GLContext context = 0;
+	if (headless.enabled) {
+		headless.create_context();
+	} else {
+		//Initialize SDL library:
+		SDL_Init(SDL_INIT_VIDEO);
+
+		//Ask for an OpenGL context version 3.3, core profile, enable debug:
+		SDL_GL_ResetAttributes();
+		SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_ALPHA_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+		SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+		SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+
+		//create window:
+		window = SDL_CreateWindow(
+			"pnct viewer",
+			SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+			800, 800,
+			SDL_WINDOW_OPENGL
+			| SDL_WINDOW_RESIZABLE //uncomment to allow resizing
+			| SDL_WINDOW_ALLOW_HIGHDPI //uncomment for full resolution on high-DPI screens
+		);
+
+		//prevent exceedingly tiny windows when resizing:
+		SDL_SetWindowMinimumSize(window, 100, 100);
+
+		if (!window) {
+			std::cerr << "Error creating SDL window: " << SDL_GetError() << std::endl;
+			return 1;
+		}
 
-	//Create OpenGL context:
-	SDL_GLContext context = SDL_GL_CreateContext(window);
+		//Create OpenGL context:
+		context = SDL_GL_CreateContext(window);
 
-	if (!context) {
-		SDL_DestroyWindow(window);
-		std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
-		return 1;
-	}
+		if (!context) {
+			SDL_DestroyWindow(window);
+			std::cerr << "Error creating OpenGL context: " << SDL_GetError() << std::endl;
+			return 1;
+		}
 
-	//On windows, load OpenGL entrypoints: (does nothing on other platforms)
-	init_GL();
+		//On windows, load OpenGL entrypoints: (does nothing on other platforms)
+		init_GL();
 
-	//Set VSYNC + Late Swap (prevents crazy FPS):
-	if (SDL_GL_SetSwapInterval(-1) != 0) {
-		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
-		if (SDL_GL_SetSwapInterval(1) != 0) {
-			std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
+		//Report OpenGL errors through GL_KHR_debug, if available (see gl_debug.hpp):
+		gl_debug_init();
+
+		//Set VSYNC + Late Swap (prevents crazy FPS):
+		if (SDL_GL_SetSwapInterval(-1) != 0) {
+			std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
+			if (SDL_GL_SetSwapInterval(1) != 0) {
+				std::cerr << "NOTE: couldn't set vsync (" << SDL_GetError() << ")." << std::endl;
+			}
 		}
 	}
 
@@ -97,10 +113,17 @@ int main(int argc, char **argv) {
 		usage = true;
 	}
 	if (usage) {
-		std::cerr << "Usage:\n\t" << argv[0] << " [path/to/meshes.pnct]" << std::endl;
+		std::cerr << "Usage:\n\t" << argv[0] << " [--headless <frames> [--size <w>x<h>] [--png <file.png>]] [path/to/meshes.pnct]" << std::endl;
 		return 1;
 	}
 
+	//------------ headless: run a fixed number of frames offscreen, then exit ------------
+	if (headless.enabled) {
+		headless.run();
+		Mode::set_current(nullptr); //(free the mode's resources while the context still exists)
+		return 0;
+	}
+
 	//------------ main loop ------------
 
 	//this inline function will be called whenever the window is resized,
@@ -123,7 +146,11 @@ int main(int argc, char **argv) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
 
+		//(each step is timed as a named scope; see Profiler.hpp)
+		Profiler::begin_frame();
+
 		{ //(1) process any events that are pending
+			Profiler::Scope scope("events");
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt) == 1) {
 				//handle resizing:
@@ -150,12 +177,15 @@ int main(int argc, char **argv) {
 						px.a = 0xff;
 					}
 					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+				} else if (profiler_handle_event(evt)) {
+					// F1/F2: frame profiler overlay toggle / dump (see draw_profiler.hpp)
 				}
 			}
 			if (!Mode::current) break;
 		}
 
 		{ //(2) call the current mode's "update" function to deal with elapsed time:
+			Profiler::Scope scope("update");
 			auto current_time = std::chrono::high_resolution_clock::now();
 			static auto previous_time = current_time;
 			float elapsed = std::chrono::duration< float >(current_time - previous_time).count();
@@ -170,12 +200,24 @@ int main(int argc, char **argv) {
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
-		
+			Profiler::Scope scope("draw");
 			Mode::current->draw(drawable_size);
 		}
 
-		//Wait until the recently-drawn frame is shown before doing it all again:
-		SDL_GL_SwapWindow(window);
+		//frame profiler overlay (F1 toggles, F2 saves to 'frame-profile.csv'):
+		draw_profiler_overlay(drawable_size);
+
+		{ //Draw any batched DrawLines (and update DrawLines text stats):
+			Profiler::Scope scope("DrawLines");
+			DrawLines::end_frame();
+		}
+
+		{ //Wait until the recently-drawn frame is shown before doing it all again:
+			Profiler::Scope scope("swap");
+			SDL_GL_SwapWindow(window);
+		}
+
+		Profiler::end_frame();
 	}
 
 